@@ -19,8 +19,8 @@
  */
 
 #include "xdcomms.h"
+#include <pthread.h>
 
-codec_map  cmap[DATA_TYP_MAX];    /* maps data type to its data encode + decode functions */
 
 /**********************************************************************/
 /* A) Set API Logging to a new level */
@@ -121,6 +121,28 @@ void my_len_decode (size_t *out, uint32_t in) {
 /**********************************************************************/
 /* C) Legacy CMAP table to store encoding and decoding function pointers */
 /**********************************************************************/
+/*
+ * The codec table is an open addressing hash table (keyed by the full 32-bit
+ * data type) of pointers to codec entries. Lookups take no lock: entries are
+ * immutable once published (re-registering publishes a new entry) and a full
+ * table is replaced by a larger copy. Replaced entries and tables are never
+ * freed, as a reader may still be using them (registration is rare).
+ */
+typedef struct _codec_table {
+  uint32_t     size;                    /* number of slots (power of 2) */
+  uint32_t     shift;                   /* 32 - log2(size) */
+  uint32_t     count;                   /* number of entries */
+  codec_map  **slot;                    /* NULL = empty */
+} codec_table;
+
+static codec_table     *cmap = NULL;    /* maps data type to its data encode + decode functions */
+static pthread_mutex_t  cmap_lock = PTHREAD_MUTEX_INITIALIZER;    /* serializes registrations */
+
+/* Fibonacci hash of data type into a slot index */
+static uint32_t cmap_hash(codec_table *t, uint32_t data_type) {
+  return ((data_type * 2654435769u) >> t->shift);
+}
+
 /*
  * Print Codec Table entry
  */
@@ -135,73 +157,124 @@ void cmap_print_one(codec_map *cm) {
  * Print entire Codec Table
  */
 void cmap_print(void) {
-  codec_map  *cm;
+  codec_table  *t = __atomic_load_n(&cmap, __ATOMIC_ACQUIRE);
+  codec_map    *cm;
   
   fprintf(stderr, "%s: ", __func__);
-  for(cm = cmap; cm->valid != 0; cm++) cmap_print_one(cm);
+  for (uint32_t i = 0; (t != NULL) && (i < t->size); i++) {
+    if ((cm = __atomic_load_n(&(t->slot[i]), __ATOMIC_ACQUIRE)) != NULL) cmap_print_one(cm);
+  }
   fprintf(stderr, "\n");
 }
 
 /*
- * Find Codec Table entry for a given data type
+ * Find Codec Table entry for a given data type (without locking)
  */
 codec_map *cmap_find(int data_type) {
-  codec_map  *cm;
+  codec_table  *t = __atomic_load_n(&cmap, __ATOMIC_ACQUIRE);
+  codec_map    *cm;
+  uint32_t      i;
   
-//  fprintf(stderr, "%s: typ=%d\n", __func__, data_type); cmap_print();
-  for(cm = cmap; cm->valid != 0; cm++) {
-    if (cm->data_type == data_type) return (cm);
+  if (t != NULL) {
+    for (i = cmap_hash(t, data_type); ; i = (i + 1) & (t->size - 1)) {
+      if ((cm = __atomic_load_n(&(t->slot[i]), __ATOMIC_ACQUIRE)) == NULL) break;
+      if (cm->data_type == (uint32_t) data_type) return (cm);
+    }
   }
   log_warn("Could not find registered data typ = %d\n", data_type);
   return (NULL);
 }
 
 /*
- * Initialize Codec Table
+ * Create empty Codec Table with 'size' slots (a power of 2)
  */
-void cmap_init(void) {
-  int         i;
-  static int  do_once = 1;
-  
-  if (do_once == 1) {
-    for (i=0; i < DATA_TYP_MAX; i++) cmap[i].valid=0;
-    do_once = 0;
+static codec_table *cmap_create(uint32_t size) {
+  codec_table  *t = malloc(sizeof(codec_table));
+  uint32_t      bits = 0;
+
+  if ((t == NULL) || ((t->slot = calloc(size, sizeof(codec_map *))) == NULL)) {
+    log_fatal("Cannot allocate codec table (size=%u)", size);
+    exit(EXIT_FAILURE);
   }
+  while ((1u << bits) < size) bits++;
+  t->size  = size;
+  t->shift = 32 - bits;
+  t->count = 0;
+  return (t);
+}
+
+/*
+ * Put entry in table's slot for its data type (replacing any old entry). Caller holds cmap_lock.
+ */
+static void cmap_put(codec_table *t, codec_map *cm) {
+  codec_map  *old;
+  uint32_t    i;
+
+  for (i = cmap_hash(t, cm->data_type); ; i = (i + 1) & (t->size - 1)) {
+    old = t->slot[i];
+    if ((old == NULL) || (old->data_type == cm->data_type)) break;
+  }
+  if (old == NULL) t->count++;
+  __atomic_store_n(&(t->slot[i]), cm, __ATOMIC_RELEASE);
 }
 
 /*
  * Load Codec Table with ADU encode and decode functions
  */
 void xdc_register(codec_func_ptr encode, codec_func_ptr decode, int typ) {
-  int i;
+  codec_table  *t, *t_new;
+  codec_map    *cm;
 
   xdc_log_level(-1);            /* set logging level to default (if not set) */
-  cmap_init();
-  for (i=0; i < DATA_TYP_MAX; i++) {
-    if (cmap[i].data_type == typ) break;
-    if (cmap[i].valid == 0) break;
+  if ((cm = malloc(sizeof(codec_map))) == NULL) {
+    log_fatal("Cannot allocate codec for data typ = %d", typ);
+    exit(EXIT_FAILURE);
   }
-  if (i >= DATA_TYP_MAX) log_fatal("CMAP table is full (DATA_TYP_MAX=%d)\n", i);
-  cmap[i].data_type = typ;
-  cmap[i].valid     = 1;
-  cmap[i].encode    = encode;
-  cmap[i].decode    = decode;
-  log_debug("API registered new data typ = %d (index=%d)", typ, i);
+  cm->data_type = typ;
+  cm->valid     = 1;
+  cm->encode    = encode;
+  cm->decode    = decode;
+
+  pthread_mutex_lock(&cmap_lock);
+  if ((t = cmap) == NULL) t = cmap_create(CMAP_SIZE_MIN);
+  if (((t->count + 1) * 4) > (t->size * 3)) {           /* keep load <= 3/4 */
+    t_new = cmap_create(t->size * 2);
+    for (uint32_t i = 0; i < t->size; i++) {
+      if (t->slot[i] != NULL) cmap_put(t_new, t->slot[i]);
+    }
+    t = t_new;
+  }
+  cmap_put(t, cm);
+  __atomic_store_n(&cmap, t, __ATOMIC_RELEASE);         /* publish (new) table */
+  pthread_mutex_unlock(&cmap_lock);
+  log_debug("API registered new data typ = %d (table has %u of %u)", typ, t->count, t->size);
 // cmap_print();
 }
 
 /**********************************************************************/
 /* Cm) Non-Legacy CMAP table to store encoding and decoding function pointers */
 /**********************************************************************/
-/* Non-legacy tag data_type used as direct index, so must be less than MY_DATA_TYP_MAX */
+/*
+ * Non-legacy tag data_type is a direct index into the caller's cmap, so only if it is
+ * less than MY_DATA_TYP_MAX; larger data types are in the (shared) legacy codec table
+ */
+codec_map *my_cmap_find(uint32_t typ, codec_map *cmap) {
+    if (typ < MY_DATA_TYP_MAX) return ((cmap[typ].valid != 0) ? &(cmap[typ]) : NULL);
+    return (cmap_find(typ));
+}
+
 void my_type_check(uint32_t typ, codec_map *cmap) {
-    if ( (typ >= MY_DATA_TYP_MAX) || (cmap[typ].valid==0) ) {
+    if (my_cmap_find(typ, cmap) == NULL) {
         exit (1);
     }
 }
 
 /* tag data_type used as direct index (Legacy uses first available as index and stored data type) */
 void my_xdc_register(codec_func_ptr encode, codec_func_ptr decode, int typ, codec_map *cmap) {
+    if ((uint32_t) typ >= MY_DATA_TYP_MAX) {
+        xdc_register(encode, decode, typ);
+        return;
+    }
     cmap[typ].valid=1;
     cmap[typ].encode=encode;
     cmap[typ].decode=decode;
@@ -215,6 +288,11 @@ void my_xdc_register(codec_func_ptr encode, codec_func_ptr decode, int typ, code
  */
 void gaps_data_encode(sdh_ha_v1 *p, size_t *p_len, uint8_t *buff_in, size_t *buff_len, gaps_tag *tag) {
   codec_map  *cm = cmap_find(tag->typ);
+
+  if (cm == NULL) {
+    log_fatal("Cannot send data typ = %d with no registered codec", tag->typ);
+    exit(EXIT_FAILURE);
+  }
   
   xdc_log_level(-1);            /* set logging level to default (if not set) */
 
@@ -236,21 +314,23 @@ void gaps_data_encode(sdh_ha_v1 *p, size_t *p_len, uint8_t *buff_in, size_t *buf
 }
 
 /*
- * Decode data from packet
+ * Decode data from packet. Returns 0, or -1 if the received data type has no codec
  */
-void gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len_out, gaps_tag *tag) {
-  codec_map  *cm = cmap_find(tag->typ);
+int gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len_out, gaps_tag *tag) {
+  codec_map  *cm;
   
   xdc_log_level(-1);            /* set logging level to default (if not set) */
 
   /* a) deserialize data from packet (TODO: remove NBO ha tag, len) */
   tag_decode(tag, &(p->tag));
   len_decode(len_out, p->data_len);
+  /* b) use codec of received data type (socket may subscribe to many types) */
+  if ((cm = cmap_find(tag->typ)) == NULL) return (-1);      /* (cmap_find warns) */
 //  fprintf(stderr, "%s\n", __func__); cmap_print();
   cm->decode (buff_out, p->data, &p_len);
   log_buf_trace("API -> raw app data:", p->data,  *len_out);
   log_buf_trace("    <- decoded data:", buff_out, *len_out);
-  // TODO - return value to indicate an error
+  return (0);
 }
 
 // XXX: Additional Functions TBD
@@ -263,7 +343,7 @@ void gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len
 void my_gaps_data_encode(sdh_ha_v1 *p, size_t *p_len, uint8_t *buff_in, size_t *len_out, gaps_tag *tag, codec_map *cmap) {
     uint32_t typ = tag->typ;
     my_type_check(typ, cmap);
-    cmap[typ].encode (p->data, buff_in, len_out);
+    my_cmap_find(typ, cmap)->encode (p->data, buff_in, len_out);
     log_buf_trace("my API <- raw app data:", buff_in, *len_out);
     log_buf_trace("       -> encoded data:", p->data, *len_out);
     my_tag_encode(&(p->tag), tag);
@@ -273,12 +353,17 @@ void my_gaps_data_encode(sdh_ha_v1 *p, size_t *p_len, uint8_t *buff_in, size_t *
     *p_len = (*len_out) + sizeof(p->tag) + sizeof(p->data_len);
     log_trace("my_gaps_data_encode: typ=%d p_len=%d", typ, p_len);
 }
-void my_gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len_out, gaps_tag *tag, codec_map *cmap) {
-    uint32_t typ = tag->typ;
-    my_type_check(typ, cmap);
-    my_tag_decode(tag, &(p->tag));
+/* Returns 0, or -1 if the received data type has no codec */
+int my_gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len_out, gaps_tag *tag, codec_map *cmap) {
+    codec_map *cm;
+    my_tag_decode(tag, &(p->tag));        /* received type (socket may subscribe to many types) */
     my_len_decode(len_out, p->data_len);
-    cmap[typ].decode (buff_out, p->data, &p_len);
+    if ((cm = my_cmap_find(tag->typ, cmap)) == NULL) {
+        log_warn("Could not find registered data typ = %d\n", tag->typ);
+        return (-1);
+    }
+    cm->decode (buff_out, p->data, &p_len);
+    return (0);
     }
 
 /**********************************************************************/
@@ -357,6 +442,22 @@ void *xdc_ctx(void) {
   return ctx;
 }
 
+/*
+ * Wait (up to timeout ms) for HAL's subscription to arrive on the XPUB socket.
+ * Returns 1 if HAL subscribed, else 0 (timeout)
+ */
+int pub_wait_for_subscriber(void *socket, int timeout) {
+    uint8_t  msg[RX_FILTER_LEN + 1];
+    int      size, forever = -1;
+
+    zmq_setsockopt(socket, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+    size = zmq_recv(socket, msg, sizeof(msg), 0);     /* subscribe message = 1 + filter */
+    zmq_setsockopt(socket, ZMQ_RCVTIMEO, &forever, sizeof(forever));
+    if ((size > 0) && (msg[0] == 1)) return (1);
+    log_debug("HAL has not subscribed to API socket (%p) after %d ms", socket, timeout);
+    return (0);
+}
+
 /*
  * Open ZMQ Publisher socket, connecting to HAL subscriber listening at addreess set by xdc_set_out:
  */
@@ -364,17 +465,18 @@ void *xdc_pub_socket(void) {
     int      err;
     void    *socket;
 
-    socket = zmq_socket(xdc_ctx(), ZMQ_PUB);
+    socket = zmq_socket(xdc_ctx(), ZMQ_XPUB);
     if (socket == NULL) exit_with_zmq_error("zmq_socket");
     err = zmq_connect(socket, xdc_set_out(NULL));
     if (err) exit_with_zmq_error("zmq_connect");
-    log_trace("API connects (spck=%p t=%d) to %s", socket, ZMQ_PUB, xdc_set_out(NULL));
+    log_trace("API connects (spck=%p t=%d) to %s", socket, ZMQ_XPUB, xdc_set_out(NULL));
     /*
      * HAL subscriber binds to address (usually publisher would bind).
-     * The APP-API cannot send immediately after a connect, as there
-     * is a few msec before ZMQ creates outgoing pipe (so sleep 1)
+     * The APP-API cannot send immediately after a connect, as messages are
+     * dropped until HAL's subscription arrives. An XPUB socket (otherwise the
+     * same as PUB) receives the subscription, so wait for it (up to 1 sec)
      */
-    sleep (1);
+    pub_wait_for_subscriber(socket, PUB_WAIT_MS);
     return socket;
 }
 
@@ -501,7 +603,7 @@ void xdc_asyn_send(void *socket, void *adu, gaps_tag *tag) {
 
 /*
  * Receive ADU from HAL (HAL is ZMQ publisher) from a sdh_ha_v1 packet
- * Returs size of packet received (timeout/error if < 0)
+ * Returs size of packet received (timeout/error, or data type with no codec, if < 0)
  */
 int xdc_recv(void *socket, void *adu, gaps_tag *tag) {
   sdh_ha_v1   packet;
@@ -517,7 +619,7 @@ int xdc_recv(void *socket, void *adu, gaps_tag *tag) {
   else {
     log_buf_trace("API recv packet", (uint8_t *) p, size);
 //fprintf(stderr, "%s: xxxxx %d\n", __func__, size);
-    gaps_data_decode(p, size, adu, &adu_len, tag);
+    if (gaps_data_decode(p, size, adu, &adu_len, tag) < 0) size = -1;
   }
   return (size);
 }
@@ -544,19 +646,433 @@ void my_xdc_asyn_send(void *socket, void *adu, gaps_tag *tag, codec_map *cmap) {
 }
 
 void my_xdc_blocking_recv(void *socket, void *adu, gaps_tag *tag, codec_map *cmap) {
-    sdh_ha_v1 packet;
-    void *p = &packet;
     log_trace("my API waiting to recv packet");
-    int size = zmq_recv(socket, p, sizeof(sdh_ha_v1), 0);
-    size_t adu_len;
-    my_gaps_data_decode(p, size, adu, &adu_len, tag, cmap);
+    while (my_xdc_recv(socket, adu, tag, cmap) < 0);
 }
 
+/* Returns size of packet received (timeout/error, or data type with no codec, if < 0) */
 int my_xdc_recv(void *socket, void *adu, gaps_tag *tag, codec_map *cmap) {
     sdh_ha_v1 packet;
     void *p = &packet;
     int size = zmq_recv(socket, p, sizeof(sdh_ha_v1), 0);
     size_t adu_len;
-    my_gaps_data_decode(p, size, adu, &adu_len, tag, cmap);
+    if (size <= 0) {
+        if (errno == EAGAIN) log_trace("Timeout on socket (%p): rv=%d error = %s", socket, size, zmq_strerror(errno));
+        else                 log_error("RCV ERROR on ZMQ socket (%p): rv=%d error = %s", socket, size, zmq_strerror(errno));
+        return size;
+    }
+    if (my_gaps_data_decode(p, size, adu, &adu_len, tag, cmap) < 0) return -1;
     return size;
 }
+
+/**********************************************************************/
+/* H) Send ADUs encoded directly into the ZMQ message buffer          */
+/**********************************************************************/
+/*
+ * Find codec for data type in the legacy cmap (if my_cmap is NULL) or in my_cmap
+ */
+static codec_map *codec_lookup(uint32_t typ, codec_map *my_cmap) {
+  codec_map  *cm;
+
+  if (my_cmap == NULL) return (cmap_find(typ));
+  if ((cm = my_cmap_find(typ, my_cmap)) == NULL) log_warn("Could not find registered data typ = %d\n", typ);
+  return (cm);
+}
+
+/*
+ * Encode ADU after the sdh_ha_v1 header in buf, returning packet length (-1 if no codec)
+ */
+static int buf_encode(uint8_t *buf, size_t buf_len, void *adu, gaps_tag *tag, codec_map *my_cmap) {
+  sdh_ha_v1  *p = (sdh_ha_v1 *) buf;      /* only header and encoded data are in buf */
+  codec_map  *cm = codec_lookup(tag->typ, my_cmap);
+  size_t      adu_len = 0;
+
+  xdc_log_level(-1);            /* set logging level to default (if not set) */
+  if (cm == NULL) return (-1);
+  cm->encode (p->data, adu, &adu_len);
+  if ((XDC_HDR_LEN + adu_len) > buf_len) {
+    log_fatal("Encoded ADU (typ=%d len=%ld) overflowed send buffer (len=%ld)", tag->typ, adu_len, buf_len);
+    exit(EXIT_FAILURE);
+  }
+  log_buf_trace("    -> encoded data:", p->data, adu_len);
+  tag_encode(&(p->tag), tag);
+  len_encode(&(p->data_len), adu_len);
+  return (XDC_HDR_LEN + adu_len);
+}
+
+/*
+ * Give ZMQ the packet in buf, without copying it. ZMQ calls ffn(buf, hint)
+ * (from its I/O thread) once sent, or on error before returning.
+ */
+static int buf_send(void *socket, uint8_t *buf, int packet_len, xdc_free_fn *ffn, void *hint) {
+  zmq_msg_t  msg;
+  int        bytes;
+
+  if (packet_len < 0) {
+    if (ffn != NULL) ffn(buf, hint);
+    return (-1);
+  }
+  if (zmq_msg_init_data(&msg, buf, packet_len, ffn, hint) != 0) exit_with_zmq_error("zmq_msg_init_data");
+  log_buf_trace("API sends Packet", buf, packet_len);
+  bytes = zmq_msg_send(&msg, socket, 0);
+  if (bytes <= 0) {
+    log_error("SEND ERROR on ZMQ socket %p: size=%d err=%s", socket, bytes, zmq_strerror(errno));
+    zmq_msg_close(&msg);
+  }
+  return (bytes);
+}
+
+static void buf_free(void *data, void *hint) {
+  free(data);
+}
+
+/*
+ * Send ADU in a heap buffer sized for its largest encoding (adu_len_max bytes),
+ * freed once sent. Returns bytes sent (-1 on error).
+ */
+static int send_len(void *socket, void *adu, size_t adu_len_max, gaps_tag *tag, codec_map *my_cmap) {
+  size_t    buf_len = XDC_HDR_LEN + adu_len_max;
+  uint8_t  *buf = malloc(buf_len);
+
+  if (buf == NULL) {
+    log_error("Cannot allocate send buffer (len=%ld)", buf_len);
+    return (-1);
+  }
+  return (buf_send(socket, buf, buf_encode(buf, buf_len, adu, tag, my_cmap), buf_free, NULL));
+}
+
+/*
+ * Send ADU, encoded by its registered codec, without a stack packet or payload copy
+ *   xdc_asyn_send_len: API allocates a buffer for up to adu_len_max encoded bytes
+ *   xdc_asyn_send_buf: Caller's buf (of buf_len >= XDC_HDR_LEN + largest encoded ADU)
+ *                      is owned by ZMQ until it calls ffn(buf, hint), which it also
+ *                      does if the send fails
+ */
+int xdc_asyn_send_len(void *socket, void *adu, size_t adu_len_max, gaps_tag *tag) {
+  return (send_len(socket, adu, adu_len_max, tag, NULL));
+}
+
+int xdc_asyn_send_buf(void *socket, void *adu, uint8_t *buf, size_t buf_len, gaps_tag *tag, xdc_free_fn *ffn, void *hint) {
+  return (buf_send(socket, buf, buf_encode(buf, buf_len, adu, tag, NULL), ffn, hint));
+}
+
+/*
+ * Encode ADU into a sdh_ha_v1 packet in caller's buf (e.g., to send with zmq_send),
+ * returning packet length (-1 if no codec)
+ */
+int xdc_encode(uint8_t *buf, size_t buf_len, void *adu, gaps_tag *tag) {
+  return (buf_encode(buf, buf_len, adu, tag, NULL));
+}
+
+/**********************************************************************/
+/* Hm) Non-Legacy Send ADUs encoded directly into the ZMQ message buffer */
+/**********************************************************************/
+int my_xdc_asyn_send_len(void *socket, void *adu, size_t adu_len_max, gaps_tag *tag, codec_map *cmap) {
+  return (send_len(socket, adu, adu_len_max, tag, cmap));
+}
+
+int my_xdc_asyn_send_buf(void *socket, void *adu, uint8_t *buf, size_t buf_len, gaps_tag *tag, xdc_free_fn *ffn, void *hint, codec_map *cmap) {
+  return (buf_send(socket, buf, buf_encode(buf, buf_len, adu, tag, cmap), ffn, hint));
+}
+
+int my_xdc_encode(uint8_t *buf, size_t buf_len, void *adu, gaps_tag *tag, codec_map *cmap) {
+  return (buf_encode(buf, buf_len, adu, tag, cmap));
+}
+
+/**********************************************************************/
+/* I) Receive packets without copying them out of the ZMQ message      */
+/**********************************************************************/
+/*
+ * Receive packet from HAL into m, which points into the ZMQ message (rather
+ * than copying it) until released by xdc_msg_release. Returns packet size
+ * (if < 0, then timeout or error and there is nothing to release).
+ */
+static int msg_recv(void *socket, xdc_msg *m, int flags) {
+  sdh_ha_v1  *p;
+  size_t      data_len;
+  int         size;
+
+  zmq_msg_init(&(m->msg));
+  size = zmq_msg_recv(&(m->msg), socket, flags);
+  if (size <= 0) {
+    if (errno == EAGAIN) log_trace("Timeout on socket (%p): rv=%d error = %s", socket, size, zmq_strerror(errno));
+    else                 log_error("RCV ERROR on ZMQ socket (%p): rv=%d error = %s", socket, size, zmq_strerror(errno));
+    zmq_msg_close(&(m->msg));
+    return (-1);
+  }
+  p = (sdh_ha_v1 *) zmq_msg_data(&(m->msg));
+  log_buf_trace("API recv packet", (uint8_t *) p, size);
+  if (size >= XDC_HDR_LEN) len_decode(&data_len, p->data_len);
+  if ((size < XDC_HDR_LEN) || (data_len > (size - XDC_HDR_LEN))) {
+    log_warn("Discarding malformed packet (len=%d) on ZMQ socket (%p)", size, socket);
+    zmq_msg_close(&(m->msg));
+    return (-1);
+  }
+  tag_decode(&(m->tag), &(p->tag));
+  m->data_len = data_len;
+  m->data     = p->data;
+  return (size);
+}
+
+int xdc_recv_msg(void *socket, xdc_msg *m) {
+  xdc_log_level(-1);            /* set logging level to default (if not set) */
+  return (msg_recv(socket, m, 0));
+}
+
+/*
+ * Decode received packet into adu, using the codec registered for its data type.
+ * Returns 0 (or -1 if no codec)
+ */
+static int msg_decode(xdc_msg *m, void *adu, codec_map *my_cmap) {
+  codec_map  *cm = codec_lookup(m->tag.typ, my_cmap);
+  size_t      len = m->data_len;
+
+  if (cm == NULL) return (-1);
+  cm->decode (adu, m->data, &len);
+  log_buf_trace("    <- decoded data:", adu, len);
+  return (0);
+}
+
+int xdc_msg_decode(xdc_msg *m, void *adu) {
+  return (msg_decode(m, adu, NULL));
+}
+
+int my_xdc_msg_decode(xdc_msg *m, void *adu, codec_map *cmap) {
+  return (msg_decode(m, adu, cmap));
+}
+
+/*
+ * Give the packet's ZMQ message back (m->data is then no longer valid)
+ */
+void xdc_msg_release(xdc_msg *m) {
+  zmq_msg_close(&(m->msg));
+  m->data     = NULL;
+  m->data_len = 0;
+}
+
+/**********************************************************************/
+/* J) Send and receive batches of ADUs                                 */
+/**********************************************************************/
+static pthread_key_t   pool_key;
+static pthread_once_t  pool_once = PTHREAD_ONCE_INIT;
+
+typedef struct _send_pool {
+  uint8_t  *buf;
+  size_t    len;
+} send_pool;
+
+static void pool_free(void *arg) {
+  send_pool *sp = (send_pool *) arg;
+  free(sp->buf);
+  free(sp);
+}
+
+static void pool_key_create(void) {
+  if (pthread_key_create(&pool_key, pool_free) != 0) {
+    log_fatal("Cannot create send pool key");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ * Get this thread's send buffer (reused by all its batches), with at least len bytes
+ */
+static uint8_t *pool_get(size_t len) {
+  send_pool *sp;
+
+  pthread_once(&pool_once, pool_key_create);
+  if ((sp = pthread_getspecific(pool_key)) == NULL) {
+    if ((sp = calloc(1, sizeof(send_pool))) == NULL) return (NULL);
+    pthread_setspecific(pool_key, sp);
+  }
+  if (sp->len < len) {
+    free(sp->buf);
+    if ((sp->buf = malloc(len)) == NULL) len = 0;
+    sp->len = len;
+  }
+  return (sp->buf);
+}
+
+/*
+ * Encode and send items (without blocking) until all are sent or ZMQ would block.
+ * Returns number of items sent.
+ */
+static int send_batch(void *socket, xdc_item *items, int count, codec_map *my_cmap) {
+  codec_map  *cm = NULL;
+  sdh_ha_v1  *p;
+  uint8_t    *buf;
+  size_t      adu_len, adu_len_max;
+  int         i, bytes;
+
+  xdc_log_level(-1);            /* set logging level to default (if not set) */
+  for (i = 0; i < count; i++) {
+    adu_len_max = (items[i].adu_len > 0) ? items[i].adu_len : ADU_SIZE_MAX_C;
+    if ((buf = pool_get(XDC_HDR_LEN + adu_len_max)) == NULL) {
+      log_error("Cannot allocate send buffer (len=%ld)", XDC_HDR_LEN + adu_len_max);
+      break;
+    }
+    if ((cm == NULL) || (cm->data_type != items[i].tag.typ) || (my_cmap != NULL)) {
+      if ((cm = codec_lookup(items[i].tag.typ, my_cmap)) == NULL) break;
+    }
+    p = (sdh_ha_v1 *) buf;
+    cm->encode (p->data, items[i].adu, &adu_len);
+    if (adu_len > adu_len_max) {
+      log_fatal("Encoded ADU (typ=%d len=%ld) overflowed send buffer (len=%ld)", items[i].tag.typ, adu_len, adu_len_max);
+      exit(EXIT_FAILURE);
+    }
+    tag_encode(&(p->tag), &(items[i].tag));
+    len_encode(&(p->data_len), adu_len);
+    bytes = zmq_send(socket, buf, XDC_HDR_LEN + adu_len, ZMQ_DONTWAIT);
+    if (bytes <= 0) {
+      if (errno != EAGAIN) log_error("SEND ERROR on ZMQ socket %p: size=%d err=%s", socket, bytes, zmq_strerror(errno));
+      break;
+    }
+  }
+  log_trace("API sent batch of %d (of %d) packets", i, count);
+  return (i);
+}
+
+/*
+ * Receive up to count items: waits for the first (like xdc_recv), then takes
+ * any others already queued. Returns number of items received (<= 0 if none).
+ */
+static int recv_batch(void *socket, xdc_item *items, int count, codec_map *my_cmap) {
+  xdc_msg  m;
+  int      n = 0;
+
+  xdc_log_level(-1);            /* set logging level to default (if not set) */
+  while (n < count) {
+    if (msg_recv(socket, &m, (n == 0) ? 0 : ZMQ_DONTWAIT) <= 0) break;
+    if (msg_decode(&m, items[n].adu, my_cmap) == 0) {
+      items[n].tag     = m.tag;
+      items[n].adu_len = m.data_len;
+      n++;
+    }
+    xdc_msg_release(&m);
+  }
+  log_trace("API received batch of %d packets", n);
+  return ((n > 0) ? n : -1);
+}
+
+/*
+ * Send or receive a batch of items (tag and ADU):
+ *   Send:    item adu_len is the largest encoded size of the ADU (0 = ADU_SIZE_MAX_C)
+ *   Receive: item adu (large enough for any received type) and tag are set,
+ *            with adu_len set to the encoded ADU size
+ */
+int xdc_send_batch(void *socket, xdc_item *items, int count) {
+  return (send_batch(socket, items, count, NULL));
+}
+
+int xdc_recv_batch(void *socket, xdc_item *items, int count) {
+  return (recv_batch(socket, items, count, NULL));
+}
+
+int my_xdc_send_batch(void *socket, xdc_item *items, int count, codec_map *cmap) {
+  return (send_batch(socket, items, count, cmap));
+}
+
+int my_xdc_recv_batch(void *socket, xdc_item *items, int count, codec_map *cmap) {
+  return (recv_batch(socket, items, count, cmap));
+}
+
+/**********************************************************************/
+/* K) Wait for input on many sockets                                   */
+/**********************************************************************/
+#define POLL_ITEMS_STACK 16
+
+/*
+ * Wait up to timeout ms (-1 = forever) until any of count sockets has a
+ * packet to receive, setting ready[i] to 1 if sockets[i] has (else 0).
+ * Returns number of sockets ready (0 on timeout, -1 on error).
+ */
+int xdc_poll(void **sockets, int *ready, int count, int timeout) {
+  zmq_pollitem_t  items_stack[POLL_ITEMS_STACK], *items = items_stack;
+  int             i, rc;
+
+  xdc_log_level(-1);            /* set logging level to default (if not set) */
+  if ((count > POLL_ITEMS_STACK) && ((items = malloc(count * sizeof(zmq_pollitem_t))) == NULL)) {
+    log_error("Cannot allocate %d poll items", count);
+    return (-1);
+  }
+  for (i = 0; i < count; i++) {
+    items[i].socket  = sockets[i];
+    items[i].fd      = 0;
+    items[i].events  = ZMQ_POLLIN;
+    items[i].revents = 0;
+  }
+  rc = zmq_poll(items, count, timeout);
+  if (rc < 0) log_error("Poll ERROR on %d ZMQ sockets: %s", count, zmq_strerror(errno));
+  for (i = 0; i < count; i++) ready[i] = (rc > 0) && (items[i].revents & ZMQ_POLLIN);
+  if (items != items_stack) free(items);
+  return (rc);
+}
+
+/*
+ * Get socket's file descriptor (ZMQ_FD), to add to an application's poll,
+ * select or epoll set. The fd is edge triggered: it signals that the socket's
+ * state may have changed, not that a packet is waiting. So, when it is
+ * readable, receive until xdc_sock_ready returns 0 (else may wait forever).
+ */
+int xdc_sock_fd(void *socket) {
+  int     fd;
+  size_t  len = sizeof(fd);
+
+  if (zmq_getsockopt(socket, ZMQ_FD, &fd, &len) != 0) {
+    log_error("Cannot get fd of ZMQ socket (%p): %s", socket, zmq_strerror(errno));
+    return (-1);
+  }
+  return (fd);
+}
+
+/*
+ * Returns 1 if socket has a packet that can be received without waiting, else 0
+ */
+int xdc_sock_ready(void *socket) {
+  int     events = 0;
+  size_t  len = sizeof(events);
+
+  if (zmq_getsockopt(socket, ZMQ_EVENTS, &events, &len) != 0) return (0);
+  return ((events & ZMQ_POLLIN) != 0);
+}
+
+/**********************************************************************/
+/* L) Add and remove socket subscriptions                              */
+/**********************************************************************/
+/*
+ * Change subscription (option = ZMQ_SUBSCRIBE or ZMQ_UNSUBSCRIBE) of a sub
+ * socket, matching the first 'fields' fields of tag (see XDC_MATCH_*)
+ */
+static int sub_change(void *socket, gaps_tag *tag, int fields, int option) {
+  gaps_tag  tag4filter;
+
+  if ((fields < XDC_MATCH_ALL) || (fields > XDC_MATCH_TAG)) {
+    log_error("Cannot match %d tag fields (must be %d to %d)", fields, XDC_MATCH_ALL, XDC_MATCH_TAG);
+    return (-1);
+  }
+  tag_encode(&tag4filter, tag);               /* fields are in order: mux, sec, typ */
+  if (zmq_setsockopt(socket, option, (void *) &tag4filter, fields * sizeof(uint32_t)) != 0) {
+    log_error("Cannot change subscription on ZMQ socket (%p): %s", socket, zmq_strerror(errno));
+    return (-1);
+  }
+  log_trace("API %ssubscribes socket (%p) to %d field(s) of tag <%u,%u,%u>", (option == ZMQ_SUBSCRIBE) ? "" : "un",
+            socket, fields, tag->mux, tag->sec, tag->typ);
+  return (0);
+}
+
+/*
+ * Add (or remove) a subscription to an existing sub socket (legacy or 'my_'), so
+ * one socket can receive many tags. Returns 0 (or -1 on error). Fields matched:
+ *   XDC_MATCH_TAG     = exact tag (as xdc_sub_socket)
+ *   XDC_MATCH_MUX_SEC = any data type for the tag's mux and sec
+ *   XDC_MATCH_MUX     = any sec and data type for the tag's mux
+ *   XDC_MATCH_ALL     = all packets
+ * Only remove subscriptions added with the same tag and fields.
+ */
+int xdc_sub_add(void *socket, gaps_tag *tag, int fields) {
+  return (sub_change(socket, tag, fields, ZMQ_SUBSCRIBE));
+}
+
+int xdc_sub_remove(void *socket, gaps_tag *tag, int fields) {
+  return (sub_change(socket, tag, fields, ZMQ_UNSUBSCRIBE));
+}
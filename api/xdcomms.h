@@ -13,7 +13,13 @@
 
 #define ADU_SIZE_MAX_C  1000000     /* 1 MB - Increased for ILIP payload mode*/
 #define RX_FILTER_LEN   12
-#define DATA_TYP_MAX    200
+#define PUB_WAIT_MS     1000        /* Longest wait for HAL to subscribe to a new pub socket */
+#define DATA_TYP_MAX    200         /* (legacy codec table now grows as needed) */
+#define CMAP_SIZE_MIN   256         /* Initial codec table size (power of 2) */
+#define XDC_MATCH_ALL      0        /* Number of leading tag fields a subscription matches */
+#define XDC_MATCH_MUX      1
+#define XDC_MATCH_MUX_SEC  2
+#define XDC_MATCH_TAG      3
 #define IPC_ADDR_DEFAULT_HALPUB "ipc:///tmp/halpub1"
 #define IPC_ADDR_DEFAULT_HALSUB "ipc:///tmp/halsub1"
 /* Non Legacy versions */
@@ -38,6 +44,27 @@ typedef struct _sdh_ha_v1 {
   uint8_t   data[ADU_SIZE_MAX_C];   /* Immediate data */
 } sdh_ha_v1;
 
+/* sdh_ha_v1 header (tag and data_len) before the immediate data */
+#define XDC_HDR_LEN     (sizeof(gaps_tag) + sizeof(uint32_t))
+
+/* Frees a caller's send buffer (called once ZMQ no longer needs it) */
+typedef zmq_free_fn xdc_free_fn;
+
+/* Received packet, still in its ZMQ message (release with xdc_msg_release) */
+typedef struct _xdc_msg {
+  zmq_msg_t   msg;
+  gaps_tag    tag;                  /* Tag (host byte order) */
+  size_t      data_len;             /* Length of encoded ADU */
+  uint8_t    *data;                 /* Encoded ADU (inside msg) */
+} xdc_msg;
+
+/* ADU and its tag, for batch send and receive */
+typedef struct _xdc_item {
+  gaps_tag    tag;
+  void       *adu;
+  size_t      adu_len;              /* Send: largest encoded size; Recv: encoded size */
+} xdc_item;
+
 /* Table of codec per data types (Max of DATA_TYP_MAX types) */
 typedef void (*codec_func_ptr)(void *, void *, size_t *);
 typedef struct _codec_map {
@@ -71,6 +98,24 @@ extern void *xdc_sub_socket(gaps_tag tag);
 extern void xdc_asyn_send(void *socket, void *adu, gaps_tag *tag);
 extern void xdc_blocking_recv(void *socket, void *adu, gaps_tag *tag);
 extern int  xdc_recv(void *socket, void *adu, gaps_tag *tag);
+// 4) Send ADUs encoded directly into the ZMQ message buffer (no stack packet or copy)
+extern int  xdc_asyn_send_len(void *socket, void *adu, size_t adu_len_max, gaps_tag *tag);
+extern int  xdc_asyn_send_buf(void *socket, void *adu, uint8_t *buf, size_t buf_len, gaps_tag *tag, xdc_free_fn *ffn, void *hint);
+extern int  xdc_encode(uint8_t *buf, size_t buf_len, void *adu, gaps_tag *tag);
+// 5) Receive packets without copying them out of the ZMQ message
+extern int  xdc_recv_msg(void *socket, xdc_msg *m);
+extern int  xdc_msg_decode(xdc_msg *m, void *adu);
+extern void xdc_msg_release(xdc_msg *m);
+// 6) Send and receive batches of ADUs
+extern int  xdc_send_batch(void *socket, xdc_item *items, int count);
+extern int  xdc_recv_batch(void *socket, xdc_item *items, int count);
+// 7) Wait for any of many sockets (or use their fds in an application event loop)
+extern int  xdc_poll(void **sockets, int *ready, int count, int timeout);
+extern int  xdc_sock_fd(void *socket);
+extern int  xdc_sock_ready(void *socket);
+// 8) Add or remove subscriptions on a sub socket (to receive many tags)
+extern int  xdc_sub_add(void *socket, gaps_tag *tag, int fields);
+extern int  xdc_sub_remove(void *socket, gaps_tag *tag, int fields);
 
 /* 0m) Non-legacy Minor exposed function prototypes */
 extern void my_tag_write (gaps_tag *tag, uint32_t mux, uint32_t sec, uint32_t typ);
@@ -80,9 +125,10 @@ extern void my_len_encode (uint32_t *out, size_t len);
 extern void my_len_decode (size_t *out, uint32_t in);
 // 1m) Configure the ADU coders and addresses
 extern void my_type_check(uint32_t typ, codec_map *cmap);
+extern codec_map *my_cmap_find(uint32_t typ, codec_map *cmap);
 extern void my_xdc_register(codec_func_ptr encode, codec_func_ptr decode, int typ, codec_map *cmap);
 //extern void my_gaps_data_encode(sdh_ha_v1 *p, size_t *p_len, uint8_t *buff_in, size_t *len_out, gaps_tag *tag, codec_map *cmap);
-//extern void my_gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len_out, gaps_tag *tag, codec_map *cmap);
+//extern int  my_gaps_data_decode(sdh_ha_v1 *p, size_t p_len, uint8_t *buff_out, size_t *len_out, gaps_tag *tag, codec_map *cmap);
 // 2m) Initialize XDC sockets
 extern void *my_xdc_pub_socket(void *ctx, const char *outuri);
 extern void *my_xdc_sub_socket_non_blocking(gaps_tag tag, void *ctx, int timeout, const char *inuri);
@@ -91,5 +137,14 @@ extern void *my_xdc_sub_socket(gaps_tag tag, void *ctx, const char *inuri);
 extern void my_xdc_asyn_send(void *socket, void *adu, gaps_tag *tag, codec_map *cmap);
 extern void my_xdc_blocking_recv(void *socket, void *adu, gaps_tag *tag, codec_map *cmap);
 extern int  my_xdc_recv(void *socket, void *adu, gaps_tag *tag, codec_map *cmap);
+// 4m) Send ADUs encoded directly into the ZMQ message buffer (no stack packet or copy)
+extern int  my_xdc_asyn_send_len(void *socket, void *adu, size_t adu_len_max, gaps_tag *tag, codec_map *cmap);
+extern int  my_xdc_asyn_send_buf(void *socket, void *adu, uint8_t *buf, size_t buf_len, gaps_tag *tag, xdc_free_fn *ffn, void *hint, codec_map *cmap);
+extern int  my_xdc_encode(uint8_t *buf, size_t buf_len, void *adu, gaps_tag *tag, codec_map *cmap);
+// 5m) Decode a packet received by xdc_recv_msg
+extern int  my_xdc_msg_decode(xdc_msg *m, void *adu, codec_map *cmap);
+// 6m) Send and receive batches of ADUs
+extern int  my_xdc_send_batch(void *socket, xdc_item *items, int count, codec_map *cmap);
+extern int  my_xdc_recv_batch(void *socket, xdc_item *items, int count, codec_map *cmap);
 
 #endif
@@ -0,0 +1,298 @@
+/*
+ * C++17 header-only binding of the HAL API (libxdcomms): RAII sockets,
+ * zero-copy received messages and typed send/recv using registered codecs
+ *   October 2026, Peraton Labs
+ *
+ * Link with libxdcomms.a (-lzmq -lpthread). Example: examples/C++/xdc_example.cpp
+ */
+
+#ifndef XDC_HPP_HEADER_FILE
+#define XDC_HPP_HEADER_FILE
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <zmq.h>
+#if __has_include(<span>)
+#include <span>
+#endif
+
+extern "C" {
+#include "xdcomms.h"
+}
+
+namespace xdc {
+
+/**********************************************************************/
+/* A) Tags and payload views */
+/*********t************************************************************/
+inline gaps_tag make_tag(uint32_t mux, uint32_t sec, uint32_t typ) {
+  gaps_tag tag;
+  tag_write(&tag, mux, sec, typ);
+  return (tag);
+}
+
+#if defined(__cpp_lib_span)
+using bytes = std::span<const uint8_t>;
+#else
+/* Read-only view of contiguous bytes (std::span<const uint8_t> before C++20) */
+class bytes {
+public:
+  constexpr bytes() noexcept = default;
+  constexpr bytes(const uint8_t *data, size_t size) noexcept : data_(data), size_(size) {}
+  template <typename C> constexpr bytes(const C &c) noexcept :
+    data_(reinterpret_cast<const uint8_t *>(std::data(c))), size_(std::size(c) * sizeof(*std::data(c))) {}
+  constexpr const uint8_t *data()  const noexcept { return (data_); }
+  constexpr size_t         size()  const noexcept { return (size_); }
+  constexpr bool           empty() const noexcept { return (size_ == 0); }
+  constexpr const uint8_t *begin() const noexcept { return (data_); }
+  constexpr const uint8_t *end()   const noexcept { return (data_ + size_); }
+  constexpr uint8_t operator[](size_t i) const noexcept { return (data_[i]); }
+private:
+  const uint8_t *data_ = nullptr;
+  size_t         size_ = 0;
+};
+#endif
+
+inline bytes as_bytes(std::string_view s) noexcept {
+  return (bytes(reinterpret_cast<const uint8_t *>(s.data()), s.size()));
+}
+
+/**********************************************************************/
+/* B) ADU types bound to their codecs */
+/*********t************************************************************/
+/*
+ * Specialize for each ADU type to send and receive it without naming its
+ * data type or codec, e.g. (with gma.h):
+ *   template <> struct xdc::adu_traits<position_datatype> {
+ *     static constexpr uint32_t       typ     = DATA_TYP_POSITION;
+ *     static constexpr size_t         enc_max = sizeof(position_datatype);
+ *     static constexpr codec_func_ptr encode  = position_data_encode;
+ *     static constexpr codec_func_ptr decode  = position_data_decode;
+ *   };
+ */
+template <typename T> struct adu_traits;
+
+/* Register T's codec in the legacy codec table (cmap = nullptr) or in a 'my_' codec map */
+template <typename T> void register_codec(codec_map *cmap = nullptr) {
+  using tr = adu_traits<T>;
+  if (cmap == nullptr) xdc_register(tr::encode, tr::decode, tr::typ);
+  else                 my_xdc_register(tr::encode, tr::decode, tr::typ, cmap);
+}
+
+/**********************************************************************/
+/* C) Received message (packet left in its ZMQ message) */
+/*********t************************************************************/
+/*
+ * Move-only owner of a received packet: payload() and view() point into
+ * the ZMQ message (no copy) and are valid while the message is alive
+ */
+class message {
+public:
+  message() noexcept { clear(); }
+  ~message() { zmq_msg_close(&(m_.msg)); }
+  message(const message &) = delete;
+  message &operator=(const message &) = delete;
+  message(message &&o) noexcept { clear(); take(o); }
+  message &operator=(message &&o) noexcept {
+    if (this != &o) { zmq_msg_close(&(m_.msg)); clear(); take(o); }
+    return (*this);
+  }
+
+  const gaps_tag  &tag()     const noexcept { return (m_.tag); }
+  size_t           size()    const noexcept { return (m_.data_len); }
+  bytes            payload() const noexcept { return (bytes(m_.data, m_.data_len)); }
+  std::string_view view()    const noexcept {
+    return (std::string_view(reinterpret_cast<const char *>(m_.data), m_.data_len));
+  }
+
+  /* Decode into adu using the codec registered for the packet's data type (0, or -1 if none) */
+  int decode(void *adu, codec_map *cmap = nullptr) {
+    return ((cmap == nullptr) ? xdc_msg_decode(&m_, adu) : my_xdc_msg_decode(&m_, adu, cmap));
+  }
+  template <typename T> std::optional<T> decode(codec_map *cmap = nullptr) {
+    T adu;
+    if ((m_.data == nullptr) || (decode(&adu, cmap) != 0)) return (std::nullopt);
+    return (adu);
+  }
+
+  xdc_msg *raw() noexcept { return (&m_); }
+
+private:
+  friend class subscriber;
+  xdc_msg  m_;
+
+  void clear() noexcept {
+    zmq_msg_init(&(m_.msg));
+    m_.tag      = gaps_tag{0, 0, 0};
+    m_.data_len = 0;
+    m_.data     = nullptr;
+  }
+  /* Small messages are stored inside zmq_msg_t, so re-point data after the move */
+  void take(message &o) noexcept {
+    zmq_msg_move(&(m_.msg), &(o.m_.msg));
+    m_.tag      = o.m_.tag;
+    m_.data_len = o.m_.data_len;
+    m_.data     = (o.m_.data == nullptr) ? nullptr : static_cast<uint8_t *>(zmq_msg_data(&(m_.msg))) + XDC_HDR_LEN;
+    o.m_.data_len = 0;
+    o.m_.data     = nullptr;
+  }
+};
+
+/**********************************************************************/
+/* D) Sockets */
+/*********t************************************************************/
+/* Move-only owner of a ZMQ socket to (or from) HAL, closed when destroyed */
+class socket {
+public:
+  socket(const socket &) = delete;
+  socket &operator=(const socket &) = delete;
+  socket(socket &&o) noexcept : s_(std::exchange(o.s_, nullptr)) {}
+  socket &operator=(socket &&o) noexcept {
+    if (this != &o) { close(); s_ = std::exchange(o.s_, nullptr); }
+    return (*this);
+  }
+  ~socket() { close(); }
+
+  void *handle() const noexcept { return (s_); }
+  int   fd()     const noexcept { return (xdc_sock_fd(s_)); }      /* edge triggered (see xdc_sock_fd) */
+  bool  ready()  const noexcept { return (xdc_sock_ready(s_) != 0); }
+  void  close()  noexcept { if (s_ != nullptr) zmq_close(s_); s_ = nullptr; }
+
+protected:
+  explicit socket(void *s) noexcept : s_(s) {}
+  void *s_;
+};
+
+/*
+ * Publisher to HAL: typed sends encode into a buffer reused by every send
+ * (so only zmq_send copies the packet); nothing else is allocated per send
+ */
+class publisher : public socket {
+public:
+  publisher() : socket(xdc_pub_socket()) {}
+  publisher(void *ctx, const char *uri, codec_map *cmap) : socket(my_xdc_pub_socket(ctx, uri)), cmap_(cmap) {}
+  publisher(publisher &&o) noexcept :
+    socket(std::move(o)), cmap_(o.cmap_), buf_(std::exchange(o.buf_, nullptr)), buf_len_(std::exchange(o.buf_len_, 0)) {}
+  publisher &operator=(publisher &&o) noexcept {
+    if (this != &o) {
+      socket::operator=(std::move(o));
+      std::free(buf_);
+      cmap_    = o.cmap_;
+      buf_     = std::exchange(o.buf_, nullptr);
+      buf_len_ = std::exchange(o.buf_len_, 0);
+    }
+    return (*this);
+  }
+  ~publisher() { std::free(buf_); }
+
+  /* Send adu, encoded by the codec registered for tag.typ (enc_max = largest encoded size). Returns bytes sent (-1 on error) */
+  template <typename T> int send(const gaps_tag &tag, const T &adu, size_t enc_max = sizeof(T)) {
+    static_assert(!std::is_pointer_v<T>, "send the ADU, not a pointer to it");
+    return (send_adu(tag, &adu, enc_max));
+  }
+  template <typename T> int send(uint32_t mux, uint32_t sec, const T &adu) {
+    return (send_adu(make_tag(mux, sec, adu_traits<T>::typ), &adu, adu_traits<T>::enc_max));
+  }
+
+  /* Send payload bytes as-is (no codec), copied once into the ZMQ message */
+  int send_raw(const gaps_tag &tag, bytes payload) {
+    zmq_msg_t   msg;
+    sdh_ha_v1  *p;
+    gaps_tag    t = tag;
+    int         bytes_sent;
+
+    if (zmq_msg_init_size(&msg, XDC_HDR_LEN + payload.size()) != 0) return (-1);
+    p = static_cast<sdh_ha_v1 *>(zmq_msg_data(&msg));
+    tag_encode(&(p->tag), &t);
+    len_encode(&(p->data_len), payload.size());
+    if (payload.size() > 0) std::memcpy(p->data, payload.data(), payload.size());
+    if ((bytes_sent = zmq_msg_send(&msg, s_, 0)) < 0) zmq_msg_close(&msg);
+    return (bytes_sent);
+  }
+
+private:
+  codec_map  *cmap_    = nullptr;
+  uint8_t    *buf_     = nullptr;
+  size_t      buf_len_ = 0;
+
+  int send_adu(const gaps_tag &tag, const void *adu, size_t enc_max) {
+    gaps_tag  t = tag;
+    int       len;
+
+    if (reserve(XDC_HDR_LEN + enc_max) == nullptr) return (-1);
+    len = my_xdc_encode(buf_, buf_len_, const_cast<void *>(adu), &t, cmap_);
+    return ((len < 0) ? -1 : zmq_send(s_, buf_, len, 0));
+  }
+
+  uint8_t *reserve(size_t len) {
+    if (len > buf_len_) {
+      std::free(buf_);
+      buf_len_ = ((buf_ = static_cast<uint8_t *>(std::malloc(len))) == nullptr) ? 0 : len;
+    }
+    return (buf_);
+  }
+};
+
+/*
+ * Subscriber to HAL for a tag (add more with add()): recv() returns the
+ * packet in its ZMQ message (no copy), or nothing after the timeout
+ */
+class subscriber : public socket {
+public:
+  explicit subscriber(const gaps_tag &tag, int timeout = -1) : socket(xdc_sub_socket_non_blocking(tag, timeout)) {}
+  subscriber(const gaps_tag &tag, void *ctx, int timeout, const char *uri, codec_map *cmap) :
+    socket(my_xdc_sub_socket_non_blocking(tag, ctx, timeout, uri)), cmap_(cmap) {}
+  subscriber(subscriber &&o) noexcept = default;
+  subscriber &operator=(subscriber &&o) noexcept = default;
+
+  /* Subscribe to (or unsubscribe from) the first 'fields' tag fields (XDC_MATCH_*) */
+  bool add(const gaps_tag &tag, int fields = XDC_MATCH_TAG) {
+    gaps_tag t = tag;
+    return (xdc_sub_add(s_, &t, fields) == 0);
+  }
+  bool remove(const gaps_tag &tag, int fields = XDC_MATCH_TAG) {
+    gaps_tag t = tag;
+    return (xdc_sub_remove(s_, &t, fields) == 0);
+  }
+
+  std::optional<message> recv() {
+    message m;
+    if (xdc_recv_msg(s_, &(m.m_)) < 0) {
+      m.clear();                  /* xdc_recv_msg closed the ZMQ message */
+      return (std::nullopt);
+    }
+    return (std::optional<message>(std::move(m)));
+  }
+
+  /* Receive and decode into adu (tag set if not null). Returns true if an ADU was decoded */
+  template <typename T> bool recv(T &adu, gaps_tag *tag = nullptr) {
+    xdc_msg  m;
+    int      rv;
+
+    static_assert(!std::is_pointer_v<T>, "receive into the ADU, not a pointer to it");
+    if (xdc_recv_msg(s_, &m) < 0) return (false);
+    rv = (cmap_ == nullptr) ? xdc_msg_decode(&m, &adu) : my_xdc_msg_decode(&m, &adu, cmap_);
+    if (tag != nullptr) *tag = m.tag;
+    xdc_msg_release(&m);
+    return (rv == 0);
+  }
+  template <typename T> std::optional<T> recv_as(gaps_tag *tag = nullptr) {
+    T adu;
+    if (!recv(adu, tag)) return (std::nullopt);
+    return (adu);
+  }
+
+private:
+  codec_map  *cmap_ = nullptr;
+};
+
+}  /* namespace xdc */
+
+#endif
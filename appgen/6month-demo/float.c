@@ -17,6 +17,8 @@
 #include <arpa/inet.h>
 #include <limits.h>
 #include <float.h>
+#include <math.h>
+#include <string.h>
  
 #include "float754.h"
 
@@ -32,25 +34,36 @@ uint64_t pack754(long double f, unsigned bits, unsigned expbits)
   int shift;
   long long sign, exp, significand;
   unsigned significandbits = bits - expbits - 1; // -1 for sign bit
+  long long expmax = (1LL<<expbits) - 1;         // all ones exponent (infinity and NaN)
 
-  if (f == 0.0) return 0; // get this special case out of the way
+  sign = signbit(f) ? 1 : 0;
+  if (f == 0.0) return (sign<<(bits-1));         // +0 and -0
+  if (isnan(f)) return (sign<<(bits-1)) | (expmax<<significandbits) | (1LL<<(significandbits-1));  // quiet NaN
+  if (isinf(f)) return (sign<<(bits-1)) | (expmax<<significandbits);
 
-  // check sign and begin normalization
-  if (f < 0) { sign = 1; fnorm = -f; }
-  else { sign = 0; fnorm = f; }
+  // begin normalization
+  fnorm = (sign) ? -f : f;
 
   // get the normalized form of f and track the exponent
   shift = 0;
   while(fnorm >= 2.0) { fnorm /= 2.0; shift++; }
   while(fnorm < 1.0) { fnorm *= 2.0; shift--; }
+
+  // get the biased exponent
+  exp = shift + ((1<<(expbits-1)) - 1); // shift + bias
+  if (exp >= expmax) return (sign<<(bits-1)) | (expmax<<significandbits);   // too big: infinity
+
+  if (exp <= 0) {
+    // subnormal: significand = f / 2^(1 - bias - significandbits), with exponent 0
+    for (shift = exp - 1 + significandbits; shift > 0; shift--) fnorm *= 2.0;
+    for (; shift < 0; shift++) fnorm /= 2.0;
+    return (sign<<(bits-1)) | (long long) fnorm;
+  }
   fnorm = fnorm - 1.0;
 
   // calculate the binary form (non-float) of the significand data
   significand = fnorm * ((1LL<<significandbits) + 0.5f);
 
-  // get the biased exponent
-  exp = shift + ((1<<(expbits-1)) - 1); // shift + bias
-
   // return the final answer
   return (sign<<(bits-1)) | (exp<<(bits-expbits-1)) | significand;
 }
@@ -62,29 +75,49 @@ long double unpack754(uint64_t i, unsigned bits, unsigned expbits)
   long long shift;
   unsigned bias;
   unsigned significandbits = bits - expbits - 1; // -1 for sign bit
+  long long expmax = (1LL<<expbits) - 1;
+  long long expraw = (i>>significandbits) & expmax;
+  int       sign = (i>>(bits-1)) & 1;
 
-  if (i == 0) return 0.0;
+  if ((i & ~(1ULL<<(bits-1))) == 0) return (sign) ? -0.0 : 0.0;
 
   // pull the significand
   result = (i&((1LL<<significandbits)-1)); // mask
+  if (expraw == expmax) {                   // infinity or NaN
+    if (result != 0) return (sign) ? -NAN : NAN;
+    return (sign) ? -INFINITY : INFINITY;
+  }
   result /= (1LL<<significandbits); // convert back to float
-  result += 1.0f; // add the one back on
 
-  // deal with the exponent
+  // deal with the exponent (subnormals have no implicit one)
   bias = (1<<(expbits-1)) - 1;
-  shift = ((i>>significandbits)&((1LL<<expbits)-1)) - bias;
+  if (expraw == 0) shift = 1 - (long long) bias;
+  else {
+    result += 1.0f; // add the one back on
+    shift = expraw - bias;
+  }
   while(shift > 0) { result *= 2.0; shift--; }
   while(shift < 0) { result /= 2.0; shift++; }
 
   // sign it
-  result *= (i>>(bits-1))&1? -1.0: 1.0;
-
-  return result;
+  return (sign) ? -result : result;
 }
 
+#ifdef FLOAT_IEEE754_HOST
+static inline uint32_t float_bits(float f)      { uint32_t h; memcpy(&h, &f, sizeof(h)); return (h); }
+static inline float    bits_float(uint32_t h)   { float    f; memcpy(&f, &h, sizeof(f)); return (f); }
+static inline uint64_t double_bits(double d)    { uint64_t h; memcpy(&h, &d, sizeof(h)); return (h); }
+static inline double   bits_double(uint64_t h)  { double   d; memcpy(&d, &h, sizeof(d)); return (d); }
+#else
+#define float_bits(f)   (pack754_32(f))
+#define bits_float(h)   (unpack754_32(h))
+#define double_bits(d)  (pack754_64(d))
+#define bits_double(h)  (unpack754_64(h))
+#endif
+
 /* Converts host float by encoding into IEEE-754 uint32_t and putting into Network byte order */
 uint32_t htonf(float f) {
-  uint32_t h = pack754_32(f);
+  uint32_t h = float_bits(f);
   if (FLOAT_BIG_ENDIAN != 0)  return ((my_htonl(h)));  /* to Network Big-Endian */
   else                        return ((my_htoxl(h)));  /* to Network Little-Endian */
 }
@@ -95,12 +128,12 @@ float ntohf(uint32_t i) {
   
   if (FLOAT_BIG_ENDIAN != 0)  h = (my_htonl(i));      /* from Network Big-Endian */
   else                        h = (my_htoxl(i));      /* from Network Little-Endian */
-  return (unpack754_32(h));
+  return (bits_float(h));
 }
 
 /* Converts host double by encoding into IEEE-754 uint64_t and putting into Network byte order */
 uint64_t htond(long double f) {
-  uint64_t h = pack754_64(f);
+  uint64_t h = double_bits(f);
   if (FLOAT_BIG_ENDIAN != 0)  return ((my_htonll(h)));  /* to Network Big-Endian */
   else                        return ((my_htoxll(h)));  /* to Network Little-Endian */
 }
@@ -110,11 +143,14 @@ long double ntohd(uint64_t i) {
   uint64_t    h;
   if (FLOAT_BIG_ENDIAN != 0)  h = (my_htonll(i));      /* from Network Big-Endian */
   else                        h = (my_htoxll(i));      /* from Network Little-Endian */
-  return (unpack754_64(h));
+  return (bits_double(h));
 }
 
 /* #define FLOAT_TEST */
 #ifdef FLOAT_TEST
+#include <stdlib.h>
+#include <time.h>
+
 
 void test_float(float f) {
   uint32_t p = pack754_32(f);
@@ -158,18 +194,104 @@ void test_int64(int64_t a) {
   printf("  d=ntohll(b)=my_htoxll(c) 0x%016" PRIx64 " [0x%016" PRIx64 "]\n\n", ntohll(b), my_htoxll(c));
 }
 
-int main(void)
+/* Bits of a float or double (as the wire should carry them on any host) */
+static uint32_t test_fbits(float f)  { uint32_t h; memcpy(&h, &f, sizeof(h)); return (h); }
+static uint64_t test_dbits(double d) { uint64_t h; memcpy(&h, &d, sizeof(h)); return (h); }
+static float    test_bitsf(uint32_t h) { float  f; memcpy(&f, &h, sizeof(f)); return (f); }
+static double   test_bitsd(uint64_t h) { double d; memcpy(&d, &h, sizeof(d)); return (d); }
+
+/* Check float encodes to its IEEE-754 bits and decodes back (NaNs only need stay NaN) */
+static int check_float(uint32_t bits) {
+  float     f = test_bitsf(bits), y;
+  uint32_t  n = htonf(f);
+
+  y = ntohf(n);
+  if (isnan(f)) return (isnan(y) && isnan(test_bitsf(my_htoxl(n))) && (signbit(y) == signbit(f)));
+  return ((my_htoxl(n) == bits) && (test_fbits(y) == bits));
+}
+
+static int check_double(uint64_t bits) {
+  double    d = test_bitsd(bits), z;
+  uint64_t  m = htond(d);
+
+  z = ntohd(m);
+  if (isnan(d)) return (isnan(z) && isnan(test_bitsd(my_htoxll(m))) && (signbit(z) == signbit(d)));
+  return ((my_htoxll(m) == bits) && (test_dbits(z) == bits));
+}
+
+/* Round trip special values, every float32 (every stride-th) and random doubles */
+static int test_round_trip(uint64_t stride) {
+  float    fs[] = {0.0f, -0.0f, INFINITY, -INFINITY, NAN, -NAN, FLT_MIN, -FLT_MIN, FLT_MAX, -FLT_MAX,
+                   FLT_TRUE_MIN, -FLT_TRUE_MIN, FLT_MIN - FLT_TRUE_MIN, FLT_EPSILON, 1.0f, -1.0f, 3.1415927f};
+  double   ds[] = {0.0, -0.0, INFINITY, -INFINITY, NAN, -NAN, DBL_MIN, -DBL_MIN, DBL_MAX, -DBL_MAX,
+                   DBL_TRUE_MIN, -DBL_TRUE_MIN, DBL_MIN - DBL_TRUE_MIN, DBL_EPSILON, 1.0, -1.0, 3.141592653589793};
+  uint64_t fails = 0, tested = 0, x = 0x9e3779b97f4a7c15ULL;
+
+  for (int i = 0; i < sizeof(fs)/sizeof(*fs); i++) {
+    if (!check_float(test_fbits(fs[i]))) { printf("  FAIL float  %g (0x%08" PRIx32 ")\n", fs[i], test_fbits(fs[i])); fails++; }
+  }
+  for (int i = 0; i < sizeof(ds)/sizeof(*ds); i++) {
+    if (!check_double(test_dbits(ds[i]))) { printf("  FAIL double %g (0x%016" PRIx64 ")\n", ds[i], test_dbits(ds[i])); fails++; }
+  }
+  for (uint64_t b = 0; b <= UINT32_MAX; b += stride, tested++) {
+    if (!check_float((uint32_t) b) && (fails++ < 10)) printf("  FAIL float  0x%08" PRIx32 "\n", (uint32_t) b);
+  }
+  for (int i = 0; i < 10000000 / stride + 1000; i++) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;              /* xorshift64 */
+    if (!check_double(x) && (fails++ < 10)) printf("  FAIL double 0x%016" PRIx64 "\n", x);
+  }
+  printf("Round trip: special values, %" PRIu64 " float32 patterns (stride %" PRIu64 ") and random doubles: %" PRIu64 " failures\n",
+         tested, stride, fails);
+  return (fails == 0);
+}
+
+static double test_now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1e9 + t.tv_nsec);
+}
+
+/* Time htond/ntohd and htonf/ntohf (as built) against the portable pack754/unpack754 */
+static void test_benchmark(int n) {
+  volatile uint64_t sink64 = 0;
+  volatile uint32_t sink32 = 0;
+  volatile double   sinkd = 0;
+  double            t0, t[4];
+
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sink64 += htond(i * 1.000001);            t[0] = (test_now_ns() - t0) / n;
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sinkd  += ntohd(0x3ff0000000000000ULL + i); t[1] = (test_now_ns() - t0) / n;
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sink64 += pack754_64(i * 1.000001);       t[2] = (test_now_ns() - t0) / n;
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sinkd  += unpack754_64(0x3ff0000000000000ULL + i); t[3] = (test_now_ns() - t0) / n;
+  printf("double: htond %6.2f ns, ntohd %6.2f ns, pack754_64 %6.2f ns, unpack754_64 %6.2f ns\n", t[0], t[1], t[2], t[3]);
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sink32 += htonf(i * 1.0001f);             t[0] = (test_now_ns() - t0) / n;
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sinkd  += ntohf(0x3f800000 + i);          t[1] = (test_now_ns() - t0) / n;
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sink32 += pack754_32(i * 1.0001f);        t[2] = (test_now_ns() - t0) / n;
+  t0 = test_now_ns(); for (int i = 0; i < n; i++) sinkd  += unpack754_32(0x3f800000 + i);   t[3] = (test_now_ns() - t0) / n;
+  printf("float:  htonf %6.2f ns, ntohf %6.2f ns, pack754_32 %6.2f ns, unpack754_32 %6.2f ns\n", t[0], t[1], t[2], t[3]);
+}
+
+/* Usage: float_test [STRIDE] (test every STRIDE-th float32 pattern; default = 1 = all) */
+int main(int argc, char **argv)
 {
   uint64_t ul[] = {18446744073709551615UL, 18364758544493064720UL, 81985529216486895, 4275878552, ULLONG_MAX, ULONG_MAX, UINT_MAX, USHRT_MAX, 1, 0};
   int64_t  sl[] = {LLONG_MIN, LONG_MIN, INT_MIN, -1, LLONG_MAX, LONG_MAX, INT_MAX, 1, 0 };
   float    fl[] = {FLT_MAX, 3.1415926535897932384, 1.0, FLT_EPSILON, 0.0, -1.0, -1.0 * FLT_MAX};
   double   dl[] = {DBL_MAX, 3.141592653589793238462643383279502884197169399375105820974944592307816406286, 1.0, DBL_EPSILON, 0.0, -1.0, -1.0 * DBL_MAX};
+  uint64_t stride = (argc > 1) ? strtoull(argv[1], NULL, 0) : 1;
+  int      ok;
 
   for (int i=sizeof(ul)/sizeof(*ul)-1; i>=0; i--) { test_uint64(ul[i]); }
   for (int i=sizeof(sl)/sizeof(*sl)-1; i>=0; i--) { test_int64(sl[i]); }
   for (int i=sizeof(fl)/sizeof(*fl)-1; i>=0; i--) { test_float(fl[i]); }
   for (int i=sizeof(dl)/sizeof(*dl)-1; i>=0; i--) { test_double(dl[i]); }
 
-  return 0;
+#ifdef FLOAT_IEEE754_HOST
+  printf("IEEE-754 host: htonf/ntohf/htond/ntohd copy float bits\n");
+#else
+  printf("Portable build: htonf/ntohf/htond/ntohd use pack754/unpack754\n");
+#endif
+  ok = test_round_trip((stride > 0) ? stride : 1);
+  test_benchmark(10000000);
+  return (ok ? 0 : 1);
 }
 #endif /* FLOAT_TEST */
@@ -1,6 +1,8 @@
 #ifndef _FLOAT_H_
 #define _FLOAT_H_
 
+#include <float.h>
+
 /* Network order for double/float: 0 = Little endian, 1 = Big endian          */
 /* Currently our DFDL uses littleEndian network order for float and double    */
 /* This choice was based on the convention used by the shapeFile format       */
@@ -9,6 +11,14 @@
 
 #define big_end_test (1==htonl(1))
 
+/* Hosts whose float and double are IEEE-754 binary32 and binary64 (checked at
+ * compile time) hold the wire encoding already. Define FLOAT_PORTABLE to
+ * always use the portable pack754/unpack754 encoding (e.g., to test it). */
+#if !defined(FLOAT_PORTABLE) && (defined(__STDC_IEC_559__) || \
+    ((FLT_RADIX == 2) && (FLT_MANT_DIG == 24) && (FLT_MAX_EXP == 128) && (DBL_MANT_DIG == 53) && (DBL_MAX_EXP == 1024)))
+#define FLOAT_IEEE754_HOST
+#endif
+
 #define swap_uint16(x) (((uint16_t)           ((x) & 0xFF)       <<  8) | (((x) & 0xFF00) >>  8))
 #define swap_uint32(x) (((uint32_t)swap_uint16((x) & 0xFFFF)     << 16) | swap_uint16((x) >> 16))
 #define swap_uint64(x) (((uint64_t)swap_uint32((x) & 0xFFFFFFFF) << 32) | swap_uint32((x) >> 32))
@@ -34,8 +34,8 @@ void trailer_from_packet(trailer_datatype *tlr_out, trailer_datatype *tlr_in) {
   tlr_out->seq = ntohl(tlr_in->seq);
   tlr_out->rqr = ntohl(tlr_in->rqr);
   tlr_out->oid = ntohl(tlr_in->oid);
-  tlr_out->mid = ntohl(tlr_in->mid);
-  tlr_out->crc = ntohl(tlr_in->crc);
+  tlr_out->mid = ntohs(tlr_in->mid);
+  tlr_out->crc = ntohs(tlr_in->crc);
 }
 
 /* 1) Position Functions */
@@ -0,0 +1,290 @@
+/*
+ * VSWAP.C
+ *   Bulk byte-order conversion of uint16/32/64 and float/double arrays
+ *
+ *  1) Kernels reverse the bytes of each element: AVX2 (32 bytes per shuffle), SSSE3
+ *     (16 bytes per pshufb) or scalar. The fastest the CPU supports is selected
+ *     when the library loads (or set VSWAP_ENGINE=scalar, ssse3 or avx2).
+ *
+ *  2) Host <-> network array converters swap only if the host order differs from
+ *     the network order (big-endian integers; float/double as set by FLOAT_BIG_ENDIAN)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "float754.h"
+#include "vswap.h"
+
+#if (defined(__x86_64__) || defined(__i386)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VSWAP_HAVE_X86
+#endif
+
+#define VSWAP_SIMD_MIN  8           /* shorter arrays are swapped by the scalar kernel */
+
+typedef void (*vswap_fn)(void *, const void *, size_t);
+
+/**********************************************************************/
+/* A) Scalar kernels */
+/**********************************************************************/
+#define VSWAP_SCALAR(name, type, swap)                                \
+static void name(void *dst, const void *src, size_t n) {              \
+  uint8_t       *d = (uint8_t *) dst;                                 \
+  const uint8_t *s = (const uint8_t *) src;                           \
+  type           v;                                                   \
+  for (size_t i = 0; i < n; i++) {                                    \
+    memcpy(&v, s + i * sizeof(type), sizeof(type));                  \
+    v = swap(v);                                                      \
+    memcpy(d + i * sizeof(type), &v, sizeof(type));                   \
+  }                                                                   \
+}
+
+VSWAP_SCALAR(vswap16_scalar, uint16_t, swap_uint16)
+VSWAP_SCALAR(vswap32_scalar, uint32_t, swap_uint32)
+VSWAP_SCALAR(vswap64_scalar, uint64_t, swap_uint64)
+
+/**********************************************************************/
+/* B) SIMD kernels (byte shuffle within each 16 byte lane) */
+/**********************************************************************/
+#ifdef VSWAP_HAVE_X86
+#define VSWAP_MASK16 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14
+#define VSWAP_MASK32 3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
+#define VSWAP_MASK64 7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8
+
+#define VSWAP_SSSE3(name, width, mask, tail)                                         \
+__attribute__((target("ssse3")))                                                     \
+static void name(void *dst, const void *src, size_t n) {                             \
+  uint8_t       *d = (uint8_t *) dst;                                                \
+  const uint8_t *s = (const uint8_t *) src;                                          \
+  const __m128i  m = _mm_setr_epi8(mask);                                            \
+  size_t         i = 0, per = 16 / (width);                                          \
+  for (; i + per <= n; i += per) {                                                   \
+    __m128i x = _mm_loadu_si128((const __m128i *) (s + i * (width)));                \
+    _mm_storeu_si128((__m128i *) (d + i * (width)), _mm_shuffle_epi8(x, m));         \
+  }                                                                                  \
+  tail(d + i * (width), s + i * (width), n - i);                                     \
+}
+
+#define VSWAP_AVX2(name, width, mask, tail)                                          \
+__attribute__((target("avx2")))                                                      \
+static void name(void *dst, const void *src, size_t n) {                             \
+  uint8_t       *d = (uint8_t *) dst;                                                \
+  const uint8_t *s = (const uint8_t *) src;                                          \
+  const __m256i  m = _mm256_setr_epi8(mask, mask);                                   \
+  size_t         i = 0, per = 32 / (width);                                          \
+  for (; i + 2 * per <= n; i += 2 * per) {                                           \
+    __m256i x0 = _mm256_loadu_si256((const __m256i *) (s + i * (width)));            \
+    __m256i x1 = _mm256_loadu_si256((const __m256i *) (s + i * (width) + 32));       \
+    _mm256_storeu_si256((__m256i *) (d + i * (width)),      _mm256_shuffle_epi8(x0, m)); \
+    _mm256_storeu_si256((__m256i *) (d + i * (width) + 32), _mm256_shuffle_epi8(x1, m)); \
+  }                                                                                  \
+  for (; i + per <= n; i += per) {                                                   \
+    __m256i x = _mm256_loadu_si256((const __m256i *) (s + i * (width)));             \
+    _mm256_storeu_si256((__m256i *) (d + i * (width)), _mm256_shuffle_epi8(x, m));   \
+  }                                                                                  \
+  if (i + per / 2 <= n) {       /* (not the SSSE3 kernel: mixing in SSE code is slow) */ \
+    __m128i x = _mm_loadu_si128((const __m128i *) (s + i * (width)));                \
+    _mm_storeu_si128((__m128i *) (d + i * (width)), _mm_shuffle_epi8(x, _mm256_castsi256_si128(m))); \
+    i += per / 2;                                                                    \
+  }                                                                                  \
+  _mm256_zeroupper();           /* (gcc omits it before the tail call) */           \
+  tail(d + i * (width), s + i * (width), n - i);                                     \
+}
+
+VSWAP_SSSE3(vswap16_ssse3, 2, VSWAP_MASK16, vswap16_scalar)
+VSWAP_SSSE3(vswap32_ssse3, 4, VSWAP_MASK32, vswap32_scalar)
+VSWAP_SSSE3(vswap64_ssse3, 8, VSWAP_MASK64, vswap64_scalar)
+VSWAP_AVX2(vswap16_avx2,   2, VSWAP_MASK16, vswap16_scalar)
+VSWAP_AVX2(vswap32_avx2,   4, VSWAP_MASK32, vswap32_scalar)
+VSWAP_AVX2(vswap64_avx2,   8, VSWAP_MASK64, vswap64_scalar)
+#endif
+
+/**********************************************************************/
+/* C) Select kernels for this CPU */
+/**********************************************************************/
+typedef struct _vswap_kernels {
+  const char *name;
+  vswap_fn    fn16;
+  vswap_fn    fn32;
+  vswap_fn    fn64;
+} vswap_kernels;
+
+static const vswap_kernels vswap_all[] = {
+  {"scalar", vswap16_scalar, vswap32_scalar, vswap64_scalar},
+#ifdef VSWAP_HAVE_X86
+  {"ssse3",  vswap16_ssse3,  vswap32_ssse3,  vswap64_ssse3},
+  {"avx2",   vswap16_avx2,   vswap32_avx2,   vswap64_avx2},
+#endif
+};
+#define VSWAP_ENGINES  ((int) (sizeof(vswap_all) / sizeof(vswap_all[0])))
+
+static const vswap_kernels *vswap_sel = &vswap_all[0];
+
+/* Returns 1 if this CPU can run engine e */
+static int vswap_supported(int e) {
+#ifdef VSWAP_HAVE_X86
+  __builtin_cpu_init();
+  if (strcmp(vswap_all[e].name, "ssse3") == 0) return (__builtin_cpu_supports("ssse3"));
+  if (strcmp(vswap_all[e].name, "avx2")  == 0) return (__builtin_cpu_supports("avx2"));
+#endif
+  return (1);
+}
+
+/* Select the last (fastest) supported engine, unless VSWAP_ENGINE names another */
+__attribute__((constructor))
+static void vswap_init(void) {
+  const char *want = getenv("VSWAP_ENGINE");
+
+  for (int e = 0; e < VSWAP_ENGINES; e++) {
+    if (!vswap_supported(e)) continue;
+    if ((want == NULL) || (strcmp(want, vswap_all[e].name) == 0)) vswap_sel = &vswap_all[e];
+  }
+}
+
+const char *vswap_engine(void) {
+  return (vswap_sel->name);
+}
+
+void vswap16(void *dst, const void *src, size_t n) {
+  if (n < VSWAP_SIMD_MIN) vswap16_scalar(dst, src, n);
+  else                    vswap_sel->fn16(dst, src, n);
+}
+
+void vswap32(void *dst, const void *src, size_t n) {
+  if (n < VSWAP_SIMD_MIN) vswap32_scalar(dst, src, n);
+  else                    vswap_sel->fn32(dst, src, n);
+}
+
+void vswap64(void *dst, const void *src, size_t n) {
+  if (n < VSWAP_SIMD_MIN) vswap64_scalar(dst, src, n);
+  else                    vswap_sel->fn64(dst, src, n);
+}
+
+/**********************************************************************/
+/* D) Host <-> network order arrays */
+/**********************************************************************/
+static void vswap_copy(void *dst, const void *src, size_t len) {
+  if (dst != src) memmove(dst, src, len);
+}
+
+void htons_array(void *dst, const void *src, size_t n) {
+  if (big_end_test) vswap_copy(dst, src, n * sizeof(uint16_t));
+  else              vswap16(dst, src, n);
+}
+
+void htonl_array(void *dst, const void *src, size_t n) {
+  if (big_end_test) vswap_copy(dst, src, n * sizeof(uint32_t));
+  else              vswap32(dst, src, n);
+}
+
+void htonll_array(void *dst, const void *src, size_t n) {
+  if (big_end_test) vswap_copy(dst, src, n * sizeof(uint64_t));
+  else              vswap64(dst, src, n);
+}
+
+#ifdef FLOAT_IEEE754_HOST
+/* IEEE-754 host floats are already encoded, so only swap if network order differs */
+void htonf_array(void *dst, const float *src, size_t n) {
+  if ((FLOAT_BIG_ENDIAN != 0) == big_end_test) vswap_copy(dst, src, n * sizeof(float));
+  else                                         vswap32(dst, src, n);
+}
+
+void htond_array(void *dst, const double *src, size_t n) {
+  if ((FLOAT_BIG_ENDIAN != 0) == big_end_test) vswap_copy(dst, src, n * sizeof(double));
+  else                                         vswap64(dst, src, n);
+}
+
+void ntohf_array(float *dst, const void *src, size_t n) {
+  htonf_array(dst, src, n);
+}
+
+void ntohd_array(double *dst, const void *src, size_t n) {
+  htond_array(dst, src, n);
+}
+#else
+void htonf_array(void *dst, const float *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t w = htonf(src[i]);
+    memcpy((uint8_t *) dst + i * sizeof(w), &w, sizeof(w));
+  }
+}
+
+void htond_array(void *dst, const double *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint64_t w = htond(src[i]);
+    memcpy((uint8_t *) dst + i * sizeof(w), &w, sizeof(w));
+  }
+}
+
+void ntohf_array(float *dst, const void *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t w;
+    memcpy(&w, (const uint8_t *) src + i * sizeof(w), sizeof(w));
+    dst[i] = ntohf(w);
+  }
+}
+
+void ntohd_array(double *dst, const void *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint64_t w;
+    memcpy(&w, (const uint8_t *) src + i * sizeof(w), sizeof(w));
+    dst[i] = ntohd(w);
+  }
+}
+#endif
+
+/* #define VSWAP_TEST */
+#ifdef VSWAP_TEST
+#include <time.h>
+
+static double test_now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1e9 + t.tv_nsec);
+}
+
+/* Check each supported engine matches the scalar kernels for every length up to
+ * 300 elements and alignment, in and out of place, then time each on 64 KB arrays */
+int main(int argc, char **argv)
+{
+  size_t    max_n = 300, bench_n = 65536, reps = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+  uint8_t  *src = malloc(bench_n + 64), *dst = malloc(bench_n + 64), *ref = malloc(bench_n + 64);
+  int       fails = 0;
+
+  for (size_t i = 0; i < bench_n + 64; i++) src[i] = (uint8_t) (i * 7 + 3);
+  printf("Selected engine: %s\n", vswap_engine());
+  for (int e = 0; e < VSWAP_ENGINES; e++) {
+    const vswap_kernels *k = &vswap_all[e];
+    vswap_fn             fns[3] = {k->fn16, k->fn32, k->fn64}, refs[3] = {vswap16_scalar, vswap32_scalar, vswap64_scalar};
+    double               t0, ns[3];
+
+    if (!vswap_supported(e)) { printf("%-6s not supported by this CPU\n", k->name); continue; }
+    for (int w = 0; w < 3; w++) {
+      size_t width = 2 << w;
+      for (size_t n = 0; n <= max_n; n++) {
+        for (size_t off = 0; off < 8; off++) {
+          refs[w](ref, src + off, n);
+          memset(dst, 0xee, max_n * width + 16);
+          fns[w](dst + off, src + off, n);
+          if ((memcmp(dst + off, ref, n * width) != 0) || (dst[off + n * width] != 0xee)) fails++;
+          memcpy(dst, src, max_n * width + 16);
+          fns[w](dst + off, dst + off, n);                 /* in place */
+          if (memcmp(dst + off, ref, n * width) != 0) fails++;
+        }
+      }
+      t0 = test_now_ns();
+      for (size_t r = 0; r < reps; r++) fns[w](dst, src, bench_n / width);
+      ns[w] = (test_now_ns() - t0) / reps;
+    }
+    printf("%-6s 64 KB: vswap16 %6.2f GB/s, vswap32 %6.2f GB/s, vswap64 %6.2f GB/s\n", k->name,
+           bench_n / ns[0], bench_n / ns[1], bench_n / ns[2]);
+  }
+  printf("%d failures\n", fails);
+  free(src); free(dst); free(ref);
+  return ((fails == 0) ? 0 : 1);
+}
+#endif /* VSWAP_TEST */
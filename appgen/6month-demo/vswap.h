@@ -0,0 +1,34 @@
+#ifndef _VSWAP_H_
+#define _VSWAP_H_
+
+/*
+ * VSWAP.H
+ *   Bulk byte-order conversion of numeric arrays (e.g., codec array fields),
+ *   using SSSE3 or AVX2 byte shuffles (selected at runtime) or scalar swaps.
+ *   Arrays need not be aligned, and dst may equal src (in-place conversion).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Reverse the bytes of each of n 2, 4 or 8 byte elements */
+extern void vswap16(void *dst, const void *src, size_t n);
+extern void vswap32(void *dst, const void *src, size_t n);
+extern void vswap64(void *dst, const void *src, size_t n);
+extern const char *vswap_engine(void);     /* "avx2", "ssse3" or "scalar" */
+
+/* Convert n elements from host to network order (as htons/htonl/htonll/htonf/htond on each) */
+extern void htons_array (void *dst, const void *src, size_t n);
+extern void htonl_array (void *dst, const void *src, size_t n);
+extern void htonll_array(void *dst, const void *src, size_t n);
+extern void htonf_array (void *dst, const float *src, size_t n);
+extern void htond_array (void *dst, const double *src, size_t n);
+
+/* Convert n elements from network to host order (as ntohs/ntohl/ntohll/ntohf/ntohd on each) */
+#define ntohs_array(dst, src, n)   htons_array((dst), (src), (n))
+#define ntohl_array(dst, src, n)   htonl_array((dst), (src), (n))
+#define ntohll_array(dst, src, n)  htonll_array((dst), (src), (n))
+extern void ntohf_array (float *dst, const void *src, size_t n);
+extern void ntohd_array (double *dst, const void *src, size_t n);
+
+#endif /* _VSWAP_H_ */
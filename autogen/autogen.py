@@ -158,9 +158,10 @@ def main():
   print('Writing DFDL file ' + args.dfdl_outfile + ' for ' + args.gaps_devtyp)
   DFDLWriter(args.typ_base).write(args.dfdl_outfile, ttree, args.gaps_devtyp)
 
-  print('Writing codec files and extras: ' + args.encoder_outfile + '.c/.h, float754.c/.h')
+  print('Writing codec files and extras: ' + args.encoder_outfile + '.c/.h/.hpp, float754.c/.h, vswap.c/.h, gaps_codec.hpp')
   CodecWriter(args.typ_base).writeheader(args.encoder_outfile, ttree)
   CodecWriter(args.typ_base).writecodecc(args.encoder_outfile, ttree)
+  CodecWriter(args.typ_base).writecodechpp(args.encoder_outfile, ttree)
   CodecWriter(args.typ_base).writextras()
 
 if __name__ == '__main__':
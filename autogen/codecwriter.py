@@ -1,5 +1,7 @@
 #!/usr/bin/python3
 
+import os
+
 #---------------------- Begin Serializer Boilerplate for GAPS ------------------------
 
 CPPHEAD='''#ifdef _cplusplus
@@ -19,6 +21,7 @@ HHEAD='''#ifndef GMA_HEADER_FILE
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -27,8 +30,10 @@ HHEAD='''#ifndef GMA_HEADER_FILE
 #include <float.h>
 
 #include "float754.h"
+#include "vswap.h"
 
 #define codec_id(X) (X)
+#define codec_at(P, T, F) ((void *) ((uint8_t *) (P) + offsetof(T, F)))  /* start of a run of fields */
 
 #pragma pack(push,1)
 typedef struct _trailer_datatype {
@@ -48,6 +53,8 @@ HTAIL='''#endif /* GMA_HEADER_FILE */
 FLOATH='''#ifndef _FLOAT_H_
 #define _FLOAT_H_
 
+#include <float.h>
+
 /* Network order for double/float: 0 = Little endian, 1 = Big endian          */
 /* Currently our DFDL uses littleEndian network order for float and double    */
 /* This choice was based on the convention used by the shapeFile format       */
@@ -56,6 +63,14 @@ FLOATH='''#ifndef _FLOAT_H_
 
 #define big_end_test (1==htonl(1))
 
+/* Hosts whose float and double are IEEE-754 binary32 and binary64 (checked at
+ * compile time) hold the wire encoding already. Define FLOAT_PORTABLE to
+ * always use the portable pack754/unpack754 encoding (e.g., to test it). */
+#if !defined(FLOAT_PORTABLE) && (defined(__STDC_IEC_559__) || \\
+    ((FLT_RADIX == 2) && (FLT_MANT_DIG == 24) && (FLT_MAX_EXP == 128) && (DBL_MANT_DIG == 53) && (DBL_MAX_EXP == 1024)))
+#define FLOAT_IEEE754_HOST
+#endif
+
 #define swap_uint16(x) (((uint16_t)           ((x) & 0xFF)       <<  8) | (((x) & 0xFF00) >>  8))
 #define swap_uint32(x) (((uint32_t)swap_uint16((x) & 0xFFFF)     << 16) | swap_uint16((x) >> 16))
 #define swap_uint64(x) (((uint64_t)swap_uint32((x) & 0xFFFFFFFF) << 32) | swap_uint32((x) >> 32))
@@ -94,6 +109,9 @@ FLOATC='''/*
 #include <stdint.h>
 #include <inttypes.h>
 #include <arpa/inet.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
  
 #include "float754.h"
 
@@ -102,6 +120,17 @@ FLOATC='''/*
 #define unpack754_32(i) (unpack754((i), 32, 8))
 #define unpack754_64(i) (unpack754((i), 64, 11))
 
+/*
+ * Hosts whose float and double are IEEE-754 binary32 and binary64 (checked at
+ * compile time) already hold the encoding, so just copy the bits (a register
+ * move) rather than calling pack754/unpack754. Define FLOAT_PORTABLE to force
+ * the portable encoding (e.g., to test it).
+ */
+#if !defined(FLOAT_PORTABLE) && (defined(__STDC_IEC_559__) || \\
+    ((FLT_RADIX == 2) && (FLT_MANT_DIG == 24) && (FLT_MAX_EXP == 128) && (DBL_MANT_DIG == 53) && (DBL_MAX_EXP == 1024)))
+#define FLOAT_IEEE754_HOST
+#endif
+
 /* Encoding into IEEE-754 encoded double */
 uint64_t pack754(long double f, unsigned bits, unsigned expbits)
 {
@@ -109,25 +138,36 @@ uint64_t pack754(long double f, unsigned bits, unsigned expbits)
   int shift;
   long long sign, exp, significand;
   unsigned significandbits = bits - expbits - 1; // -1 for sign bit
+  long long expmax = (1LL<<expbits) - 1;         // all ones exponent (infinity and NaN)
 
-  if (f == 0.0) return 0; // get this special case out of the way
+  sign = signbit(f) ? 1 : 0;
+  if (f == 0.0) return (sign<<(bits-1));         // +0 and -0
+  if (isnan(f)) return (sign<<(bits-1)) | (expmax<<significandbits) | (1LL<<(significandbits-1));  // quiet NaN
+  if (isinf(f)) return (sign<<(bits-1)) | (expmax<<significandbits);
 
-  // check sign and begin normalization
-  if (f < 0) { sign = 1; fnorm = -f; }
-  else { sign = 0; fnorm = f; }
+  // begin normalization
+  fnorm = (sign) ? -f : f;
 
   // get the normalized form of f and track the exponent
   shift = 0;
   while(fnorm >= 2.0) { fnorm /= 2.0; shift++; }
   while(fnorm < 1.0) { fnorm *= 2.0; shift--; }
+
+  // get the biased exponent
+  exp = shift + ((1<<(expbits-1)) - 1); // shift + bias
+  if (exp >= expmax) return (sign<<(bits-1)) | (expmax<<significandbits);   // too big: infinity
+
+  if (exp <= 0) {
+    // subnormal: significand = f / 2^(1 - bias - significandbits), with exponent 0
+    for (shift = exp - 1 + significandbits; shift > 0; shift--) fnorm *= 2.0;
+    for (; shift < 0; shift++) fnorm /= 2.0;
+    return (sign<<(bits-1)) | (long long) fnorm;
+  }
   fnorm = fnorm - 1.0;
 
   // calculate the binary form (non-float) of the significand data
   significand = fnorm * ((1LL<<significandbits) + 0.5f);
 
-  // get the biased exponent
-  exp = shift + ((1<<(expbits-1)) - 1); // shift + bias
-
   // return the final answer
   return (sign<<(bits-1)) | (exp<<(bits-expbits-1)) | significand;
 }
@@ -139,29 +179,49 @@ long double unpack754(uint64_t i, unsigned bits, unsigned expbits)
   long long shift;
   unsigned bias;
   unsigned significandbits = bits - expbits - 1; // -1 for sign bit
+  long long expmax = (1LL<<expbits) - 1;
+  long long expraw = (i>>significandbits) & expmax;
+  int       sign = (i>>(bits-1)) & 1;
 
-  if (i == 0) return 0.0;
+  if ((i & ~(1ULL<<(bits-1))) == 0) return (sign) ? -0.0 : 0.0;
 
   // pull the significand
   result = (i&((1LL<<significandbits)-1)); // mask
+  if (expraw == expmax) {                   // infinity or NaN
+    if (result != 0) return (sign) ? -NAN : NAN;
+    return (sign) ? -INFINITY : INFINITY;
+  }
   result /= (1LL<<significandbits); // convert back to float
-  result += 1.0f; // add the one back on
 
-  // deal with the exponent
+  // deal with the exponent (subnormals have no implicit one)
   bias = (1<<(expbits-1)) - 1;
-  shift = ((i>>significandbits)&((1LL<<expbits)-1)) - bias;
+  if (expraw == 0) shift = 1 - (long long) bias;
+  else {
+    result += 1.0f; // add the one back on
+    shift = expraw - bias;
+  }
   while(shift > 0) { result *= 2.0; shift--; }
   while(shift < 0) { result /= 2.0; shift++; }
 
   // sign it
-  result *= (i>>(bits-1))&1? -1.0: 1.0;
-
-  return result;
+  return (sign) ? -result : result;
 }
 
+#ifdef FLOAT_IEEE754_HOST
+static inline uint32_t float_bits(float f)      { uint32_t h; memcpy(&h, &f, sizeof(h)); return (h); }
+static inline float    bits_float(uint32_t h)   { float    f; memcpy(&f, &h, sizeof(f)); return (f); }
+static inline uint64_t double_bits(double d)    { uint64_t h; memcpy(&h, &d, sizeof(h)); return (h); }
+static inline double   bits_double(uint64_t h)  { double   d; memcpy(&d, &h, sizeof(d)); return (d); }
+#else
+#define float_bits(f)   (pack754_32(f))
+#define bits_float(h)   (unpack754_32(h))
+#define double_bits(d)  (pack754_64(d))
+#define bits_double(h)  (unpack754_64(h))
+#endif
+
 /* Converts host float by encoding into IEEE-754 uint32_t and putting into Network byte order */
 uint32_t htonf(float f) {
-  uint32_t h = pack754_32(f);
+  uint32_t h = float_bits(f);
   if (FLOAT_BIG_ENDIAN != 0)  return ((my_htonl(h)));  /* to Network Big-Endian */
   else                        return ((my_htoxl(h)));  /* to Network Little-Endian */
 }
@@ -172,12 +232,12 @@ float ntohf(uint32_t i) {
   
   if (FLOAT_BIG_ENDIAN != 0)  h = (my_htonl(i));      /* from Network Big-Endian */
   else                        h = (my_htoxl(i));      /* from Network Little-Endian */
-  return (unpack754_32(h));
+  return (bits_float(h));
 }
 
 /* Converts host double by encoding into IEEE-754 uint64_t and putting into Network byte order */
 uint64_t htond(long double f) {
-  uint64_t h = pack754_64(f);
+  uint64_t h = double_bits(f);
   if (FLOAT_BIG_ENDIAN != 0)  return ((my_htonll(h)));  /* to Network Big-Endian */
   else                        return ((my_htoxll(h)));  /* to Network Little-Endian */
 }
@@ -187,8 +247,417 @@ long double ntohd(uint64_t i) {
   uint64_t    h;
   if (FLOAT_BIG_ENDIAN != 0)  h = (my_htonll(i));      /* from Network Big-Endian */
   else                        h = (my_htoxll(i));      /* from Network Little-Endian */
-  return (unpack754_64(h));
+  return (bits_double(h));
+}
+'''
+
+VSWAPH='''#ifndef _VSWAP_H_
+#define _VSWAP_H_
+
+/*
+ * VSWAP.H
+ *   Bulk byte-order conversion of numeric arrays (e.g., codec array fields),
+ *   using SSSE3 or AVX2 byte shuffles (selected at runtime) or scalar swaps.
+ *   Arrays need not be aligned, and dst may equal src (in-place conversion).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Reverse the bytes of each of n 2, 4 or 8 byte elements */
+extern void vswap16(void *dst, const void *src, size_t n);
+extern void vswap32(void *dst, const void *src, size_t n);
+extern void vswap64(void *dst, const void *src, size_t n);
+extern const char *vswap_engine(void);     /* "avx2", "ssse3" or "scalar" */
+
+/* Convert n elements from host to network order (as htons/htonl/htonll/htonf/htond on each) */
+extern void htons_array (void *dst, const void *src, size_t n);
+extern void htonl_array (void *dst, const void *src, size_t n);
+extern void htonll_array(void *dst, const void *src, size_t n);
+extern void htonf_array (void *dst, const float *src, size_t n);
+extern void htond_array (void *dst, const double *src, size_t n);
+
+/* Convert n elements from network to host order (as ntohs/ntohl/ntohll/ntohf/ntohd on each) */
+#define ntohs_array(dst, src, n)   htons_array((dst), (src), (n))
+#define ntohl_array(dst, src, n)   htonl_array((dst), (src), (n))
+#define ntohll_array(dst, src, n)  htonll_array((dst), (src), (n))
+extern void ntohf_array (float *dst, const void *src, size_t n);
+extern void ntohd_array (double *dst, const void *src, size_t n);
+
+#endif /* _VSWAP_H_ */
+'''
+
+VSWAPC='''/*
+ * VSWAP.C
+ *   Bulk byte-order conversion of uint16/32/64 and float/double arrays
+ *
+ *  1) Kernels reverse the bytes of each element: AVX2 (32 bytes per shuffle), SSSE3
+ *     (16 bytes per pshufb) or scalar. The fastest the CPU supports is selected
+ *     when the library loads (or set VSWAP_ENGINE=scalar, ssse3 or avx2).
+ *
+ *  2) Host <-> network array converters swap only if the host order differs from
+ *     the network order (big-endian integers; float/double as set by FLOAT_BIG_ENDIAN)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "float754.h"
+#include "vswap.h"
+
+#if (defined(__x86_64__) || defined(__i386)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define VSWAP_HAVE_X86
+#endif
+
+#define VSWAP_SIMD_MIN  8           /* shorter arrays are swapped by the scalar kernel */
+
+typedef void (*vswap_fn)(void *, const void *, size_t);
+
+/**********************************************************************/
+/* A) Scalar kernels */
+/**********************************************************************/
+#define VSWAP_SCALAR(name, type, swap)                                \\
+static void name(void *dst, const void *src, size_t n) {              \\
+  uint8_t       *d = (uint8_t *) dst;                                 \\
+  const uint8_t *s = (const uint8_t *) src;                           \\
+  type           v;                                                   \\
+  for (size_t i = 0; i < n; i++) {                                    \\
+    memcpy(&v, s + i * sizeof(type), sizeof(type));                  \\
+    v = swap(v);                                                      \\
+    memcpy(d + i * sizeof(type), &v, sizeof(type));                   \\
+  }                                                                   \\
+}
+
+VSWAP_SCALAR(vswap16_scalar, uint16_t, swap_uint16)
+VSWAP_SCALAR(vswap32_scalar, uint32_t, swap_uint32)
+VSWAP_SCALAR(vswap64_scalar, uint64_t, swap_uint64)
+
+/**********************************************************************/
+/* B) SIMD kernels (byte shuffle within each 16 byte lane) */
+/**********************************************************************/
+#ifdef VSWAP_HAVE_X86
+#define VSWAP_MASK16 1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14
+#define VSWAP_MASK32 3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12
+#define VSWAP_MASK64 7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8
+
+#define VSWAP_SSSE3(name, width, mask, tail)                                         \\
+__attribute__((target("ssse3")))                                                     \\
+static void name(void *dst, const void *src, size_t n) {                             \\
+  uint8_t       *d = (uint8_t *) dst;                                                \\
+  const uint8_t *s = (const uint8_t *) src;                                          \\
+  const __m128i  m = _mm_setr_epi8(mask);                                            \\
+  size_t         i = 0, per = 16 / (width);                                          \\
+  for (; i + per <= n; i += per) {                                                   \\
+    __m128i x = _mm_loadu_si128((const __m128i *) (s + i * (width)));                \\
+    _mm_storeu_si128((__m128i *) (d + i * (width)), _mm_shuffle_epi8(x, m));         \\
+  }                                                                                  \\
+  tail(d + i * (width), s + i * (width), n - i);                                     \\
+}
+
+#define VSWAP_AVX2(name, width, mask, tail)                                          \\
+__attribute__((target("avx2")))                                                      \\
+static void name(void *dst, const void *src, size_t n) {                             \\
+  uint8_t       *d = (uint8_t *) dst;                                                \\
+  const uint8_t *s = (const uint8_t *) src;                                          \\
+  const __m256i  m = _mm256_setr_epi8(mask, mask);                                   \\
+  size_t         i = 0, per = 32 / (width);                                          \\
+  for (; i + 2 * per <= n; i += 2 * per) {                                           \\
+    __m256i x0 = _mm256_loadu_si256((const __m256i *) (s + i * (width)));            \\
+    __m256i x1 = _mm256_loadu_si256((const __m256i *) (s + i * (width) + 32));       \\
+    _mm256_storeu_si256((__m256i *) (d + i * (width)),      _mm256_shuffle_epi8(x0, m)); \\
+    _mm256_storeu_si256((__m256i *) (d + i * (width) + 32), _mm256_shuffle_epi8(x1, m)); \\
+  }                                                                                  \\
+  for (; i + per <= n; i += per) {                                                   \\
+    __m256i x = _mm256_loadu_si256((const __m256i *) (s + i * (width)));             \\
+    _mm256_storeu_si256((__m256i *) (d + i * (width)), _mm256_shuffle_epi8(x, m));   \\
+  }                                                                                  \\
+  if (i + per / 2 <= n) {       /* (not the SSSE3 kernel: mixing in SSE code is slow) */ \\
+    __m128i x = _mm_loadu_si128((const __m128i *) (s + i * (width)));                \\
+    _mm_storeu_si128((__m128i *) (d + i * (width)), _mm_shuffle_epi8(x, _mm256_castsi256_si128(m))); \\
+    i += per / 2;                                                                    \\
+  }                                                                                  \\
+  _mm256_zeroupper();           /* (gcc omits it before the tail call) */           \\
+  tail(d + i * (width), s + i * (width), n - i);                                     \\
+}
+
+VSWAP_SSSE3(vswap16_ssse3, 2, VSWAP_MASK16, vswap16_scalar)
+VSWAP_SSSE3(vswap32_ssse3, 4, VSWAP_MASK32, vswap32_scalar)
+VSWAP_SSSE3(vswap64_ssse3, 8, VSWAP_MASK64, vswap64_scalar)
+VSWAP_AVX2(vswap16_avx2,   2, VSWAP_MASK16, vswap16_scalar)
+VSWAP_AVX2(vswap32_avx2,   4, VSWAP_MASK32, vswap32_scalar)
+VSWAP_AVX2(vswap64_avx2,   8, VSWAP_MASK64, vswap64_scalar)
+#endif
+
+/**********************************************************************/
+/* C) Select kernels for this CPU */
+/**********************************************************************/
+typedef struct _vswap_kernels {
+  const char *name;
+  vswap_fn    fn16;
+  vswap_fn    fn32;
+  vswap_fn    fn64;
+} vswap_kernels;
+
+static const vswap_kernels vswap_all[] = {
+  {"scalar", vswap16_scalar, vswap32_scalar, vswap64_scalar},
+#ifdef VSWAP_HAVE_X86
+  {"ssse3",  vswap16_ssse3,  vswap32_ssse3,  vswap64_ssse3},
+  {"avx2",   vswap16_avx2,   vswap32_avx2,   vswap64_avx2},
+#endif
+};
+#define VSWAP_ENGINES  ((int) (sizeof(vswap_all) / sizeof(vswap_all[0])))
+
+static const vswap_kernels *vswap_sel = &vswap_all[0];
+
+/* Returns 1 if this CPU can run engine e */
+static int vswap_supported(int e) {
+#ifdef VSWAP_HAVE_X86
+  __builtin_cpu_init();
+  if (strcmp(vswap_all[e].name, "ssse3") == 0) return (__builtin_cpu_supports("ssse3"));
+  if (strcmp(vswap_all[e].name, "avx2")  == 0) return (__builtin_cpu_supports("avx2"));
+#endif
+  return (1);
+}
+
+/* Select the last (fastest) supported engine, unless VSWAP_ENGINE names another */
+__attribute__((constructor))
+static void vswap_init(void) {
+  const char *want = getenv("VSWAP_ENGINE");
+
+  for (int e = 0; e < VSWAP_ENGINES; e++) {
+    if (!vswap_supported(e)) continue;
+    if ((want == NULL) || (strcmp(want, vswap_all[e].name) == 0)) vswap_sel = &vswap_all[e];
+  }
+}
+
+const char *vswap_engine(void) {
+  return (vswap_sel->name);
+}
+
+void vswap16(void *dst, const void *src, size_t n) {
+  if (n < VSWAP_SIMD_MIN) vswap16_scalar(dst, src, n);
+  else                    vswap_sel->fn16(dst, src, n);
+}
+
+void vswap32(void *dst, const void *src, size_t n) {
+  if (n < VSWAP_SIMD_MIN) vswap32_scalar(dst, src, n);
+  else                    vswap_sel->fn32(dst, src, n);
+}
+
+void vswap64(void *dst, const void *src, size_t n) {
+  if (n < VSWAP_SIMD_MIN) vswap64_scalar(dst, src, n);
+  else                    vswap_sel->fn64(dst, src, n);
+}
+
+/**********************************************************************/
+/* D) Host <-> network order arrays */
+/**********************************************************************/
+static void vswap_copy(void *dst, const void *src, size_t len) {
+  if (dst != src) memmove(dst, src, len);
+}
+
+void htons_array(void *dst, const void *src, size_t n) {
+  if (big_end_test) vswap_copy(dst, src, n * sizeof(uint16_t));
+  else              vswap16(dst, src, n);
+}
+
+void htonl_array(void *dst, const void *src, size_t n) {
+  if (big_end_test) vswap_copy(dst, src, n * sizeof(uint32_t));
+  else              vswap32(dst, src, n);
+}
+
+void htonll_array(void *dst, const void *src, size_t n) {
+  if (big_end_test) vswap_copy(dst, src, n * sizeof(uint64_t));
+  else              vswap64(dst, src, n);
+}
+
+#ifdef FLOAT_IEEE754_HOST
+/* IEEE-754 host floats are already encoded, so only swap if network order differs */
+void htonf_array(void *dst, const float *src, size_t n) {
+  if ((FLOAT_BIG_ENDIAN != 0) == big_end_test) vswap_copy(dst, src, n * sizeof(float));
+  else                                         vswap32(dst, src, n);
+}
+
+void htond_array(void *dst, const double *src, size_t n) {
+  if ((FLOAT_BIG_ENDIAN != 0) == big_end_test) vswap_copy(dst, src, n * sizeof(double));
+  else                                         vswap64(dst, src, n);
+}
+
+void ntohf_array(float *dst, const void *src, size_t n) {
+  htonf_array(dst, src, n);
+}
+
+void ntohd_array(double *dst, const void *src, size_t n) {
+  htond_array(dst, src, n);
+}
+#else
+void htonf_array(void *dst, const float *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t w = htonf(src[i]);
+    memcpy((uint8_t *) dst + i * sizeof(w), &w, sizeof(w));
+  }
+}
+
+void htond_array(void *dst, const double *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint64_t w = htond(src[i]);
+    memcpy((uint8_t *) dst + i * sizeof(w), &w, sizeof(w));
+  }
+}
+
+void ntohf_array(float *dst, const void *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint32_t w;
+    memcpy(&w, (const uint8_t *) src + i * sizeof(w), sizeof(w));
+    dst[i] = ntohf(w);
+  }
 }
+
+void ntohd_array(double *dst, const void *src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint64_t w;
+    memcpy(&w, (const uint8_t *) src + i * sizeof(w), sizeof(w));
+    dst[i] = ntohd(w);
+  }
+}
+#endif
+'''
+
+CODECHPP='''#ifndef _GAPS_CODEC_HPP_
+#define _GAPS_CODEC_HPP_
+
+/*
+ * Templated C++ serializers driven by a constexpr layout of each datatype.
+ *   Wire format matches the C codecs: integers are big-endian and float/double
+ *   are little-endian IEEE-754 (FLOAT_BIG_ENDIAN=0), packed in field order.
+ *   Each field is copied, byte-swapping only if its wire order differs from the
+ *   host; a struct with nothing to swap (e.g., only integers on a big-endian host)
+ *   is one memcpy. Arrays of bulk_min or more elements are swapped with the
+ *   vswap.h kernels (SSSE3/AVX2, as the C codecs' *_array calls), shorter
+ *   fields one element at a time.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <utility>
+
+extern "C" {
+#include "vswap.h"
+}
+
+namespace gaps_codec {
+
+static_assert(std::numeric_limits<float>::is_iec559 && std::numeric_limits<double>::is_iec559,
+              "C++ codecs copy float/double bits, so need IEEE-754 floating point");
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+constexpr bool host_big_endian = true;
+#else
+constexpr bool host_big_endian = false;
+#endif
+
+enum class wire_order { big, little };
+
+struct field_desc {
+  size_t      offset;           /* bytes from start of (packed) struct */
+  size_t      width;            /* bytes per element */
+  size_t      count;            /* number of elements (1 for scalars) */
+  wire_order  order;
+};
+
+/* Specialized for each datatype with its 'typ' and 'fields' (including trailer) */
+template <typename T> struct layout;
+
+constexpr bool needs_swap(const field_desc &f) {
+  return ((f.width > 1) && ((f.order == wire_order::big) != host_big_endian));
+}
+
+template <typename T> constexpr bool any_swap() {
+  for (const field_desc &f : layout<T>::fields) if (needs_swap(f)) return (true);
+  return (false);
+}
+
+/* Fields must exactly cover the packed struct (checked at compile time) */
+template <typename T> constexpr bool fields_cover() {
+  size_t next = 0;
+  for (const field_desc &f : layout<T>::fields) {
+    if (f.offset != next) return (false);
+    next += f.width * f.count;
+  }
+  return (next == sizeof(T));
+}
+
+template <typename U> inline U bswap(U v) {
+  if constexpr (sizeof(U) == 2) return (__builtin_bswap16(v));
+  else if constexpr (sizeof(U) == 4) return (__builtin_bswap32(v));
+  else return (__builtin_bswap64(v));
+}
+
+constexpr size_t bulk_min = 8;  /* fewest elements swapped with one vswap call (BULK_MIN in the C codecs) */
+
+template <typename U> inline void swap_copy(uint8_t *dst, const uint8_t *src, size_t n) {
+  if (n >= bulk_min) {
+    if constexpr (sizeof(U) == 2)      vswap16(dst, src, n);
+    else if constexpr (sizeof(U) == 4) vswap32(dst, src, n);
+    else                               vswap64(dst, src, n);
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    U v;
+    std::memcpy(&v, src + i * sizeof(U), sizeof(U));
+    v = bswap(v);
+    std::memcpy(dst + i * sizeof(U), &v, sizeof(U));
+  }
+}
+
+template <typename T, size_t I> inline void copy_field(uint8_t *dst, const uint8_t *src) {
+  constexpr field_desc f = layout<T>::fields[I];
+  if constexpr (!needs_swap(f))  std::memcpy(dst + f.offset, src + f.offset, f.width * f.count);
+  else if constexpr (f.width == 2) swap_copy<uint16_t>(dst + f.offset, src + f.offset, f.count);
+  else if constexpr (f.width == 4) swap_copy<uint32_t>(dst + f.offset, src + f.offset, f.count);
+  else                             swap_copy<uint64_t>(dst + f.offset, src + f.offset, f.count);
+}
+
+template <typename T, size_t... I> inline void copy_fields(uint8_t *dst, const uint8_t *src, std::index_sequence<I...>) {
+  (copy_field<T, I>(dst, src), ...);
+}
+
+/* Swapping byte order is its own inverse, so encode and decode share one copy */
+template <typename T> inline void copy_swap(void *dst, const void *src) {
+  static_assert(fields_cover<T>(), "layout fields do not match the packed struct");
+  if constexpr (!any_swap<T>()) std::memcpy(dst, src, sizeof(T));
+  else copy_fields<T>((uint8_t *) dst, (const uint8_t *) src, std::make_index_sequence<std::size(layout<T>::fields)>{});
+}
+
+template <typename T> inline void encode(void *buff_out, const T *in, size_t *len_out) {
+  copy_swap<T>(buff_out, in);
+  *len_out = sizeof(T);
+}
+
+template <typename T> inline void decode(T *out, const void *buff_in, size_t *len_in) {
+  (void) len_in;                /* fixed size, as in the C decoders */
+  copy_swap<T>(out, buff_in);
+}
+
+/* Same signature as the C codecs (codec_func_ptr), e.g., for xdc_register */
+template <typename T> void data_encode(void *buff_out, void *buff_in, size_t *len_out) {
+  encode<T>(buff_out, (const T *) buff_in, len_out);
+}
+
+template <typename T> void data_decode(void *buff_out, void *buff_in, size_t *len_in) {
+  decode<T>((T *) buff_out, buff_in, len_in);
+}
+
+}  /* namespace gaps_codec */
+
+#endif /* _GAPS_CODEC_HPP_ */
 '''
 #---------------------- End Serializer Boilerplate for GAPS   ------------------------
 
@@ -256,7 +725,48 @@ decfn = {
   'int64':  'ntohll',
   'uint64': 'ntohll'
 }
-  
+
+BULK_MIN = 8     # fewest elements in a run converted by one vswap.h array call
+
+arrenc = {
+  'double': 'htond_array',
+  'ffloat': 'htonf_array',
+  'int8':   'memcpy',
+  'uint8':  'memcpy',
+  'int16':  'htons_array',
+  'uint16': 'htons_array',
+  'int32':  'htonl_array',
+  'uint32': 'htonl_array',
+  'int64':  'htonll_array',
+  'uint64': 'htonll_array'
+}
+
+arrdec = {
+  'double': 'ntohd_array',
+  'ffloat': 'ntohf_array',
+  'int8':   'memcpy',
+  'uint8':  'memcpy',
+  'int16':  'ntohs_array',
+  'uint16': 'ntohs_array',
+  'int32':  'ntohl_array',
+  'uint32': 'ntohl_array',
+  'int64':  'ntohll_array',
+  'uint64': 'ntohll_array'
+}
+
+wireord = {
+  'double': 'little',
+  'ffloat': 'little',
+  'int8':   'big',
+  'uint8':  'big',
+  'int16':  'big',
+  'uint16': 'big',
+  'int32':  'big',
+  'uint32': 'big',
+  'int64':  'big',
+  'uint64': 'big'
+}
+
 class CodecWriter:
   def __init__(self,typbase=0):
     self.typbase=typbase
@@ -273,6 +783,8 @@ class CodecWriter:
       appstr += '  ' + 'p2->' + f[1] + ' = ' + decfn[f[0]] + '(p1->' + f[1] + ');' + '\n'
     elif ser == 'sizeof':
       appstr += 'sizeof(' + cintyp[f[0]] + ') + '
+    elif ser == 'layout':
+      appstr += '    {offsetof(' + d + '_datatype, ' + f[1] + '), sizeof(' + cintyp[f[0]] + '), 1, wire_order::' + wireord[f[0]] + '},' + '\n'
     else:
       raise Exception('Unknown serializarion: ' + ser)
     return appstr
@@ -296,10 +808,42 @@ class CodecWriter:
       appstr += '  }' + '\n'
     elif ser == 'sizeof':
       appstr += 'sizeof(' + cintyp[f[0]] + ') * ' + str(f[2]) + ' + '
+    elif ser == 'layout':
+      appstr += '    {offsetof(' + d + '_datatype, ' + f[1] + '), sizeof(' + cintyp[f[0]] + '), ' + str(f[2]) + ', wire_order::' + wireord[f[0]] + '},' + '\n'
     else:
       raise Exception('Unknown serialization: ' + ser)
     return appstr
 
+  # Group consecutive fields converted the same way (contiguous, as structs are packed)
+  # into runs of [fields, number of elements]
+  def make_runs(self,flds):
+    runs = []
+    for f in flds:
+      n = int(f[2]) if len(f) == 3 else 1
+      if len(runs) > 0 and arrenc[runs[-1][0][0][0]] == arrenc[f[0]]:
+        runs[-1][0].append(f)
+        runs[-1][1] += n
+      else:
+        runs.append([[f], n])
+    return runs
+
+  # Convert a run with one bulk (vectorized) array call, unless too short to gain
+  # from it (then convert each element as before). The run spans several members,
+  # so its address is taken from the struct base (offsetof), not the first member
+  def make_run(self,d,run,ser):
+    flds, n = run
+    if n < BULK_MIN:
+      appstr = ''
+      for f in flds:
+        if len(f) == 2: appstr += self.make_scalar(d,f,ser,True)
+        else:           appstr += self.make_array(d,f,ser,True)
+      return appstr
+    f = flds[0]
+    t1, t2 = (d + '_datatype', d + '_output') if ser == 'encoder' else (d + '_output', d + '_datatype')
+    fn = arrenc[f[0]] if ser == 'encoder' else arrdec[f[0]]
+    size = ', sizeof(' + cintyp[f[0]] + ') * ' + str(n) if fn == 'memcpy' else ', ' + str(n)
+    return '  ' + fn + '(codec_at(p2, ' + t2 + ', ' + f[1] + '), codec_at(p1, ' + t1 + ', ' + f[1] + ')' + size + ');' + '\n'
+
   def make_dtyp_enum(self,tree):
     dtypid = 0
     appstr = ''
@@ -371,9 +915,9 @@ class CodecWriter:
     appstr += '  ' + d + '_datatype *p1 = (' + d + '_datatype *) buff_in;' + '\n'
     appstr += '  ' + d + '_output   *p2 = (' + d + '_output *)   buff_out;' + '\n'
     for f in l[1:]:
-      if   len(f) == 2: appstr += self.make_scalar(d,f,'encoder',True)
-      elif len(f) == 3: appstr += self.make_array(d,f,'encoder',True)
-      else:             raise Exception('Unhandled field: ' + f)
+      if len(f) not in (2, 3): raise Exception('Unhandled field: ' + f)
+    for r in self.make_runs(l[1:]):
+      appstr += self.make_run(d,r,'encoder')
     appstr += '  p2->trailer.seq = htonl(p1->trailer.seq);' + '\n'
     appstr += '  p2->trailer.rqr = htonl(p1->trailer.rqr);' + '\n'
     appstr += '  p2->trailer.oid = htonl(p1->trailer.oid);' + '\n'
@@ -394,9 +938,9 @@ class CodecWriter:
     appstr += '  ' + d + '_output   *p1 = (' + d + '_output *)   buff_in;' + '\n'
     appstr += '  ' + d + '_datatype *p2 = (' + d + '_datatype *) buff_out;' + '\n'
     for f in l[1:]:
-      if   len(f) == 2: appstr += self.make_scalar(d,f,'decoder',True)
-      elif len(f) == 3: appstr += self.make_array(d,f,'decoder',True)
-      else:             raise Exception('Unhandled field: ' + f)
+      if len(f) not in (2, 3): raise Exception('Unhandled field: ' + f)
+    for r in self.make_runs(l[1:]):
+      appstr += self.make_run(d,r,'decoder')
     appstr += '  p2->trailer.seq = ntohl(p1->trailer.seq);' + '\n'
     appstr += '  p2->trailer.rqr = ntohl(p1->trailer.rqr);' + '\n'
     appstr += '  p2->trailer.oid = ntohl(p1->trailer.oid);' + '\n'
@@ -405,6 +949,35 @@ class CodecWriter:
     appstr += '}' + '\n\n'
     return appstr 
 
+  def make_layout(self,l):
+    appstr = ''
+    d = l[0].lower()
+    t = d + '_datatype'
+    appstr += 'template <> struct layout<' + t + '> {' + '\n'
+    appstr += '  static constexpr uint32_t   typ = DATA_TYP_' + l[0].upper() + ';' + '\n'
+    appstr += '  static constexpr field_desc fields[] = {' + '\n'
+    for f in l[1:]:
+      if   len(f) == 2: appstr += self.make_scalar(d,f,'layout',True)
+      elif len(f) == 3: appstr += self.make_array(d,f,'layout',True)
+      else:             raise Exception('Unhandled field: ' + f)
+    for n, w in [('seq', 4), ('rqr', 4), ('oid', 4), ('mid', 2), ('crc', 2)]:
+      appstr += '    {offsetof(' + t + ', trailer) + offsetof(trailer_datatype, ' + n + '), ' + str(w) + ', 1, wire_order::big},' + '\n'
+    appstr += '  };' + '\n'
+    appstr += '};' + '\n\n'
+    return appstr
+
+  def make_adu_traits(self,l):
+    appstr = ''
+    d = l[0].lower()
+    t = d + '_datatype'
+    appstr += 'template <> struct xdc::adu_traits<' + t + '> {' + '\n'
+    appstr += '  static constexpr uint32_t       typ     = DATA_TYP_' + l[0].upper() + ';' + '\n'
+    appstr += '  static constexpr size_t         enc_max = sizeof(' + t + ');' + '\n'
+    appstr += '  static constexpr codec_func_ptr encode  = gaps_codec::data_encode<' + t + '>;' + '\n'
+    appstr += '  static constexpr codec_func_ptr decode  = gaps_codec::data_decode<' + t + '>;' + '\n'
+    appstr += '};' + '\n'
+    return appstr
+
   def writeheader(self, outfname, tree):
     try:
       hstr = CPPHEAD
@@ -433,6 +1006,30 @@ class CodecWriter:
     except Exception as e:
       print("Error in codecc export: ", e)
 
+  def writecodechpp(self, outfname, tree):
+    try:
+      guard = '_' + ''.join(c if c.isalnum() else '_' for c in os.path.basename(outfname)).upper() + '_HPP_'
+      hstr  = '#ifndef ' + guard + '\n'
+      hstr += '#define ' + guard + '\n\n'
+      hstr += '/* Include xdcomms.hpp first to also bind each datatype to its codec for xdc:: send/recv */' + '\n'
+      hstr += 'extern "C" {' + '\n'
+      hstr += '#include "' + os.path.basename(outfname) + '.h"' + '\n'
+      hstr += '}' + '\n'
+      hstr += '#include "gaps_codec.hpp"' + '\n\n'
+      hstr += 'namespace gaps_codec {' + '\n\n'
+      for l in tree:
+        hstr += self.make_layout(l)
+      hstr += '}  /* namespace gaps_codec */' + '\n\n'
+      hstr += '#ifdef XDC_HPP_HEADER_FILE' + '\n'
+      for l in tree:
+        hstr += self.make_adu_traits(l)
+      hstr += '#endif /* XDC_HPP_HEADER_FILE */' + '\n\n'
+      hstr += '#endif /* ' + guard + ' */' + '\n'
+      with open(outfname + '.hpp', 'w') as f:
+        f.write(hstr)
+    except Exception as e:
+      print("Error in codec hpp export: ", e)
+
   def writextras(self):
     try:
       with open('float754.c', 'w') as f:
@@ -443,17 +1040,34 @@ class CodecWriter:
         f.write(CPPHEAD)
         f.write(FLOATH)
         f.write(CPPTAIL)
+      with open('vswap.c', 'w') as f:
+        f.write(CPPHEAD)
+        f.write(VSWAPC)
+        f.write(CPPTAIL)
+      with open('vswap.h', 'w') as f:
+        f.write(CPPHEAD)
+        f.write(VSWAPH)
+        f.write(CPPTAIL)
+      with open('gaps_codec.hpp', 'w') as f:
+        f.write(CODECHPP)
     except Exception as e:
       print("Error writing extras: ", e)
 
 if __name__ == '__main__':
   pt = [['Position', ['double', 'x'], ['double', 'y'], ['double', 'z']], 
         ['Distance', ['double', 'dx'], ['double', 'dy'], ['double', 'dz']],
-        ['ArrayTest', ['double', 'doubloons', '3']]]
+        ['ArrayTest', ['double', 'doubloons', '3']],
+        ['FancyArrayTest', ['int8', 'a'], ['uint8', 'b'], ['int16', 'c'], ['uint16', 'd'], ['int32', 'e'],
+         ['uint32', 'f'], ['int64', 'g'], ['uint64', 'h'], ['ffloat', 'i'], ['double', 'j'],
+         ['int8', 'k', '4'], ['uint8', 'l', '4'], ['int16', 'm', '4'], ['uint16', 'n', '4'], ['int32', 'o', '4'],
+         ['uint32', 'p', '4'], ['int64', 'q', '4'], ['uint64', 'r', '4'], ['ffloat', 's', '4'], ['double', 't', '4']],
+        ['SensorTest', ['uint32', 'id'], ['uint32', 'count'], ['double', 'time'], ['ffloat', 'samples', '256'],
+         ['int16', 'raw', '512']]]
 
-  print('Writing test codec to codec.c/.h')
+  print('Writing test codec to codec.c/.h/.hpp')
   CodecWriter().writeheader('codec', pt)
   CodecWriter().writecodecc('codec', pt)
-  print('Creating float754.c/.h')
+  CodecWriter().writecodechpp('codec', pt)
+  print('Creating float754.c/.h, vswap.c/.h, gaps_codec.hpp')
   CodecWriter().writextras()
 
@@ -0,0 +1,110 @@
+/*
+ * Round-trip test of the generated C++ serializers (codec.hpp) against the
+ * generated C codecs (codec.c), plus the time each takes per ADU.
+ *   October 2026, Peraton Labs
+ *
+ * python3 codecwriter.py
+ * gcc -O2 -c codec.c float754.c vswap.c && g++ -std=c++17 -O2 test.cpp codec.o float754.o vswap.o -o test_cpp && ./test_cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include "codec.hpp"
+
+static int fails = 0;
+
+/* Compare C and C++ encodings of 'in', then decode each with the other's decoder */
+template <typename T> static void round_trip(const char *name, T &in,
+                                             void (*c_enc)(void *, void *, size_t *),
+                                             void (*c_dec)(void *, void *, size_t *)) {
+  uint8_t  wire_c[sizeof(T)], wire_cpp[sizeof(T)];
+  T        out_c, out_cpp;
+  size_t   len_c = 0, len_cpp = 0;
+
+  c_enc(wire_c, &in, &len_c);
+  gaps_codec::encode<T>(wire_cpp, &in, &len_cpp);
+  int ok_enc = (len_c == len_cpp) && (memcmp(wire_c, wire_cpp, len_c) == 0);
+
+  gaps_codec::decode<T>(&out_cpp, wire_c, &len_c);
+  c_dec(&out_c, wire_cpp, &len_cpp);
+  int ok_dec = (memcmp(&out_cpp, &in, sizeof(T)) == 0) && (memcmp(&out_c, &in, sizeof(T)) == 0);
+
+  printf("%-16s len=%3zu encode %s, decode %s\n", name, len_c, ok_enc ? "same" : "DIFFERENT", ok_dec ? "ok" : "FAILED");
+  if (!(ok_enc && ok_dec)) fails++;
+}
+
+/* ns per ADU to encode then decode n times with the C++ and C codecs, and their ratio */
+template <typename T> static void timing(const char *name, T &in, int n,
+                                         void (*c_enc)(void *, void *, size_t *),
+                                         void (*c_dec)(void *, void *, size_t *)) {
+  uint8_t  wire[sizeof(T)];
+  T        out;
+  size_t   len;
+  unsigned sink = 0;
+  double   ns[2];
+
+  for (int k = 0; k < 2; k++) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+      ((uint8_t *) &in)[sizeof(T) - 1] = (uint8_t) i;         /* vary the input (crc) */
+      if (k == 0) { gaps_codec::encode<T>(wire, &in, &len); gaps_codec::decode<T>(&out, wire, &len); }
+      else        { c_enc(wire, &in, &len); c_dec(&out, wire, &len); }
+      sink += ((uint8_t *) &out)[0];
+    }
+    ns[k] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+  }
+  printf("%-16s encode+decode C++ %7.1f ns, C %7.1f ns, C++/C %.2f (%u)\n", name, ns[0], ns[1], ns[0] / ns[1], sink & 1);
+}
+
+int main(int argc, char **argv) {
+  fancyarraytest_datatype f;
+  position_datatype       p;
+  arraytest_datatype      a;
+  sensortest_datatype     s;
+  int                     n = (argc > 1) ? atoi(argv[1]) : 1000000;
+
+  memset(&f, 0, sizeof(f));
+  f.a = -5;
+  f.b = 254;
+  f.c = -12000;
+  f.d = 63000;
+  f.e = -70000;
+  f.f = 70000;
+  f.g = -9876543210;
+  f.h = 9876543210;
+  f.i = -5.9345;
+  f.j = 9876543210.012345;
+  for (int i = 0; i < 4; i++) {
+    f.k[i] = -5 - i;
+    f.l[i] = 254 - i;
+    f.m[i] = -12000 - i;
+    f.n[i] = 63000 + i;
+    f.o[i] = -70000 - i;
+    f.p[i] = 70000 + i;
+    f.q[i] = -9876543210 - i;
+    f.r[i] = 9876543210 + i;
+    f.s[i] = -5.9345 * (i + 1);
+    f.t[i] = 9876543210.012345 / (i + 1);
+  }
+  f.trailer = {1, 2, 3, 4, 5};
+  p = {1.5, -2.25, 3.125e10, {0x01020304, 0x05060708, 0x090a0b0c, 0x0d0e, 0x0f10}};
+  a = {{1.0 / 3, -2.0 / 7, 1e-300}, {7, 8, 9, 10, 11}};
+  memset(&s, 0, sizeof(s));
+  s.id    = 42;
+  s.count = 256;
+  s.time  = 1.7e9;
+  for (int i = 0; i < 256; i++) s.samples[i] = 0.5f * i - 64;
+  for (int i = 0; i < 512; i++) s.raw[i] = (int16_t) (i * 97 - 20000);
+  s.trailer = {6, 7, 8, 9, 10};
+
+  round_trip("fancyarraytest", f, fancyarraytest_data_encode, fancyarraytest_data_decode);
+  round_trip("position",       p, position_data_encode,       position_data_decode);
+  round_trip("arraytest",      a, arraytest_data_encode,      arraytest_data_decode);
+  round_trip("sensortest",     s, sensortest_data_encode,     sensortest_data_decode);
+
+  printf("byte swaps: %s\n", vswap_engine());
+  timing("fancyarraytest", f, n, fancyarraytest_data_encode, fancyarraytest_data_decode);
+  timing("position",       p, n, position_data_encode,       position_data_decode);
+  timing("sensortest",     s, n / 10, sensortest_data_encode, sensortest_data_decode);
+  return ((fails == 0) ? 0 : 1);
+}
@@ -0,0 +1,141 @@
+/*
+ * HAL output coalescing
+ *   October 2026, Peraton Labs
+ *
+ * With coalesce_us > 0, packets HAL writes to a device are appended to
+ * the device's coalescing buffer, then written together (one write, and,
+ * on a tty with tty_hdlc, one frame) when coalesce_bytes are waiting or
+ * coalesce_us after the first of them, whichever comes first. Packets of
+ * coalesce_bytes or more are written alone (after those waiting, to keep
+ * their order). A receiving HAL routes each packet of a read, so
+ * high-rate flows of small ADUs (e.g., position or heartbeat messages)
+ * need far fewer system calls and link frames.
+ *
+ * Each packet's in-HAL latency sample is taken when its buffer is written,
+ * so the statistics include the wait.
+ *
+ * Only devices whose reader parses packets from a byte stream or
+ * datagram can coalesce (tcp, udp and tty): the reader of an ipc, ilp,
+ * zmq or inproc device needs one packet per message.
+ */
+
+#include "hal.h"
+#include "coalesce.h"
+#include "device_read_write.h"
+#include "udp.h"
+#include "time.h"
+#include "copy.h"
+#include "stats.h"
+#include "cycles.h"
+
+/**********************************************************************/
+/* A) Settings */
+/*********t************************************************************/
+/* Check an opened device's coalescing settings and allocate its buffer */
+void coalesce_open(device *d) {
+  int max = PACKET_MAX;
+
+  d->co_len         = 0;
+  d->co_pkts        = 0;
+  d->co_deadline_ns = 0;
+  if (d->coalesce_us <= 0) {
+    d->coalesce_us = 0;
+    return;
+  }
+  if ((strcmp(d->comms, "tcp") != 0) && (strcmp(d->comms, "udp") != 0) && (strcmp(d->comms, "tty") != 0)) {
+    log_fatal("Device %s cannot set coalesce_us: its %s reader needs one packet per message", d->id, d->comms);
+    exit(EXIT_FAILURE);
+  }
+  if (strcmp(d->comms, "udp") == 0) max = (d->udp_gso_size > 0) ? d->udp_gso_size : UDP_GSO_BYTES_MAX;  /* (one datagram) */
+  if (d->coalesce_bytes <= 0)  d->coalesce_bytes = COALESCE_BYTES_DEFAULT;
+  if (d->coalesce_bytes > max) {
+    log_warn("Device %s coalesce_bytes=%d too big: using %d", d->id, d->coalesce_bytes, max);
+    d->coalesce_bytes = max;
+  }
+  if ((d->co_buf == NULL) && ((d->co_buf = malloc(d->coalesce_bytes)) == NULL)) {
+    log_fatal("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  log_trace("Device %s coalesces writes: up to %d bytes or %d us", d->id, d->coalesce_bytes, d->coalesce_us);
+}
+
+/**********************************************************************/
+/* B) Coalesce and write */
+/*********t************************************************************/
+/* Write the packets waiting in device d's coalescing buffer (and add their in-HAL latency samples) */
+void coalesce_flush(hal_ctx *ctx, device *d) {
+  uint64_t now;
+
+  if (d->co_len <= 0) return;
+  log_trace("HAL writes %d coalesced packets (len=%d) to %s", d->co_pkts, d->co_len, d->id);
+  write_buf(ctx, d, d->co_buf, d->co_len);
+  now = cycles_now();
+  for (int i = 0; i < d->co_pkts; i++) stats_add(d->co_hist[i], (int64_t) cycles_to_ns(now - d->co_rx[i]));
+  d->co_len         = 0;
+  d->co_pkts        = 0;
+  d->co_deadline_ns = 0;
+}
+
+/* Grow device d's per-packet latency entries to hold one more packet */
+static void coalesce_grow(device *d) {
+  int n = (d->co_max > 0) ? 2 * d->co_max : 64;
+
+  if (d->co_pkts < d->co_max) return;
+  if (((d->co_hist = realloc(d->co_hist, n * sizeof(stats_hist *))) == NULL)
+   || ((d->co_rx   = realloc(d->co_rx,   n * sizeof(uint64_t)))     == NULL)) {
+    log_fatal("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  d->co_max = n;
+}
+
+/*
+ * Append a packet (header hdr, then p's payload if p->payload_off >= 0, else
+ * all in hdr) to device d's coalescing buffer, writing the buffer when full.
+ * The packet's in-HAL latency (from rx_cycles) is added to lat when written.
+ * Returns 1, or 0 if the packet is too long to coalesce (after writing those
+ * waiting, so the caller writes it alone and in order).
+ */
+int coalesce_add(hal_ctx *ctx, device *d, uint8_t *hdr, pdu *p, int pkt_len, stats_hist *lat, uint64_t rx_cycles) {
+  uint8_t *dst;
+  int      off = p->payload_off;
+
+  if (pkt_len >= d->coalesce_bytes) {
+    coalesce_flush(ctx, d);
+    return (0);
+  }
+  if (d->co_len + pkt_len > d->coalesce_bytes) coalesce_flush(ctx, d);
+  dst = d->co_buf + d->co_len;
+  if (off < 0) memcpy(dst, hdr, pkt_len);
+  else {
+    memcpy(dst, hdr, off);
+    copy_payload(dst + off, p->data, p->data_len);
+  }
+  if (d->co_len == 0) d->co_deadline_ns = time_mono_ns() + d->coalesce_us * 1000ULL;
+  coalesce_grow(d);
+  d->co_hist[d->co_pkts] = lat;
+  d->co_rx[d->co_pkts]   = rx_cycles;
+  d->co_len += pkt_len;
+  (d->co_pkts)++;
+  if (d->co_len >= d->coalesce_bytes) coalesce_flush(ctx, d);
+  return (1);
+}
+
+/* Write the packets waiting on every device (e.g., before closing them) */
+void coalesce_flush_all(hal_ctx *ctx) {
+  for (device *d = ctx->devs; d != NULL; d = d->next) {
+    if ((d->enabled != 0) && (d->coalesce_us > 0)) coalesce_flush(ctx, d);
+  }
+}
+
+/* Write coalesced packets that are due. Returns the time the next ones are due (0 = none) */
+uint64_t coalesce_timers(hal_ctx *ctx, uint64_t now_ns) {
+  uint64_t next = 0;
+
+  for (device *d = ctx->devs; d != NULL; d = d->next) {
+    if ((d->enabled == 0) || (d->co_deadline_ns == 0)) continue;
+    if (d->co_deadline_ns <= now_ns) coalesce_flush(ctx, d);
+    else if ((next == 0) || (d->co_deadline_ns < next)) next = d->co_deadline_ns;
+  }
+  return (next);
+}
@@ -0,0 +1,9 @@
+/* HAL output coalescing: small packets for one device share a write (see coalesce.c) */
+
+#define COALESCE_BYTES_DEFAULT 8192     /* coalesced bytes that trigger a write (if coalesce_bytes unset) */
+
+extern void     coalesce_open(device *d);
+extern int      coalesce_add(hal_ctx *ctx, device *d, uint8_t *hdr, pdu *p, int pkt_len, struct _stats_hist *lat, uint64_t rx_cycles);
+extern void     coalesce_flush(hal_ctx *ctx, device *d);
+extern void     coalesce_flush_all(hal_ctx *ctx);
+extern uint64_t coalesce_timers(hal_ctx *ctx, uint64_t now_ns);
@@ -5,9 +5,8 @@
 
 #include "hal.h"
 #include "map.h"
+#include "time.h"
 
-char ipc_addr_in[]   = "ipc:///tmp/halpub1";
-char ipc_addr_out[]  = "ipc:///tmp/halsub1";
 /**********************************************************************/
 /* HAL Configuration file (read and parse) */
 /*********t************************************************************/
@@ -89,6 +88,19 @@ device *get_devices(config_t *cfg) {
       ret[i].path_r      = get_param_str(dev, "path_r",      1, i);
       ret[i].path_w      = get_param_str(dev, "path_w",      1, i);
       ret[i].from_mux    = get_param_int(dev, "from_mux",    1, i);
+      ret[i].tcp_nodelay    = get_param_int(dev, "tcp_nodelay",    1, i);
+      ret[i].tcp_cork_us    = get_param_int(dev, "tcp_cork_us",    1, i);
+      ret[i].tcp_cork_bytes = get_param_int(dev, "tcp_cork_bytes", 1, i);
+      ret[i].udp_gso_size   = get_param_int(dev, "udp_gso_size",   1, i);
+      ret[i].udp_gro        = get_param_int(dev, "udp_gro",        1, i);
+      ret[i].read_max       = get_param_int(dev, "read_max",       1, i);
+      ret[i].tty_baud       = get_param_int(dev, "tty_baud",       1, i);
+      ret[i].tty_vmin       = get_param_int(dev, "tty_vmin",       1, i);
+      ret[i].tty_vtime      = get_param_int(dev, "tty_vtime",      1, i);
+      ret[i].tty_hdlc       = get_param_int(dev, "tty_hdlc",       1, i);
+      ret[i].tstamp         = get_param_str(dev, "tstamp",         1, i);
+      ret[i].coalesce_us    = get_param_int(dev, "coalesce_us",    1, i);
+      ret[i].coalesce_bytes = get_param_int(dev, "coalesce_bytes", 1, i);
 
       ret[i].listen_fd = -1; /* to be set when opened (if tcp) */
       ret[i].read_fd   = -1; /* to be set when opened */
@@ -100,6 +112,36 @@ device *get_devices(config_t *cfg) {
       ret[i].count_r   =  0;
       ret[i].count_w   =  0;
       ret[i].tcp_conn  = -1; /* to be set when opened */
+      ret[i].inproc_fn  = NULL; /* set by hal_inproc_set */
+      ret[i].inproc_arg = NULL;
+      ret[i].map_tree   = NULL; /* set by map_tree_build */
+      ret[i].tcp_state        = 0; /* TCP state set when opened (if tcp) */
+      ret[i].tcp_backoff_ms   = 0;
+      ret[i].tcp_retry_ns     = 0;
+      ret[i].cork_deadline_ns = 0;
+      ret[i].cork_len         = 0;
+      ret[i].txq              = NULL;
+      ret[i].txq_off          = 0;
+      ret[i].txq_len          = 0;
+      ret[i].udp_gso_off      = 0;
+      ret[i].udp_seg_in       = 0;
+      ret[i].udp_seg_carry    = 0;
+      ret[i].udp_carry_len    = 0;
+      ret[i].hdlc_esc         = 0;
+      ret[i].tty_tx           = NULL;
+      ret[i].co_buf           = NULL; /* allocated when opened (if coalesce_us) */
+      ret[i].co_len           = 0;
+      ret[i].co_pkts          = 0;
+      ret[i].co_max           = 0;
+      ret[i].co_hist          = NULL;
+      ret[i].co_rx            = NULL;
+      ret[i].co_deadline_ns   = 0;
+      ret[i].rx_stream        = 0; /* set when opened (if tcp, tty without tty_hdlc, or udp with udp_gro) */
+      ret[i].rx_carry_ttl_ms  = 0;
+      ret[i].rx_carry         = NULL; /* allocated on first partial read */
+      ret[i].rx_carry_len     = 0;
+      ret[i].rx_carry_ns      = 0;
+      ret[i].tstamp_clock     = time_clock_by_name(ret[i].tstamp, ret[i].id);
 
 //      fprintf(stderr, "LISTEN FD = %d\n", ret[i].listen_fd);
       /*
@@ -114,6 +156,52 @@ device *get_devices(config_t *cfg) {
   return ret;
 }
 
+/* Get HAL map entry field (e.g., from_typ) matching a number, "*" (any) or "lo-hi". Returns specificity: 2 = one value, 1 = range, 0 = any */
+static int get_map_from_field(config_setting_t *map, const char *name, int field_num, uint32_t *lo, uint32_t *hi) {
+  const char    *val;
+  char          *end;
+  unsigned long  a, b;
+
+  if (!config_setting_lookup_string(map, name, &val)) {
+    *lo = *hi = (uint32_t) get_param_int(map, name, 1, field_num);     /* (unset = -1, as before) */
+    return (2);
+  }
+  if (strcmp(val, "*") == 0) {
+    *lo = 0;
+    *hi = UINT32_MAX;
+    return (0);
+  }
+  a = b = strtoul(val, &end, 0);
+  if ((end != val) && (*end == '-')) b = strtoul(val = end + 1, &end, 0);
+  if ((end == val) || (*end != '\0') || (a > b) || (b > UINT32_MAX)) {
+    log_fatal("HAL map entry %d has bad %s '%s' (use a number, \"*\" or \"lo-hi\")", field_num, name, val);
+    exit(EXIT_FAILURE);
+  }
+  *lo = a;
+  *hi = b;
+  return ((a == b) ? 2 : 1);
+}
+
+/* Get HAL map entry field (e.g., to_typ) set to a number, or rewritten from the input's: "$" (same) or "$+N" / "$-N" */
+static void get_map_to_field(config_setting_t *map, const char *name, int field_num, uint32_t *val, int *rel, int *off) {
+  const char *str;
+  char       *end;
+
+  *rel = 0;
+  *off = 0;
+  if (!config_setting_lookup_string(map, name, &str)) {
+    *val = (uint32_t) get_param_int(map, name, 1, field_num);
+    return;
+  }
+  *val = 0;
+  *rel = 1;
+  if ((str[0] == '$') && (str[1] != '\0')) *off = (int) strtol(str + 1, &end, 10);
+  if ((str[0] != '$') || ((str[1] != '\0') && ((*end != '\0') || ((str[1] != '+') && (str[1] != '-'))))) {
+    log_fatal("HAL map entry %d has bad %s '%s' (use a number, \"$\", \"$+N\" or \"$-N\")", field_num, name, str);
+    exit(EXIT_FAILURE);
+  }
+}
+
 /* Construct linked list of HAL map entries from config */
 halmap *get_mappings(config_t *cfg) {
   halmap *ret = NULL;
@@ -128,17 +216,22 @@ halmap *get_mappings(config_t *cfg) {
     }
     for(int i = 0; i < count; i++) {
       config_setting_t *map = config_setting_get_elem(hmaps, i);
+      int               spec;
       ret[i].from.dev     = get_param_str(map, "from_dev",  0, i);
       ret[i].from.ctag    = get_param_int(map, "from_ctag", 1, i);
-      ret[i].from.tag.mux = get_param_int(map, "from_mux",  1, i);
-      ret[i].from.tag.sec = get_param_int(map, "from_sec",  1, i);
-      ret[i].from.tag.typ = get_param_int(map, "from_typ",  1, i);
+      spec                = get_map_from_field(map, "from_mux", i, &ret[i].from_lo[0], &ret[i].from_hi[0])
+                          + get_map_from_field(map, "from_sec", i, &ret[i].from_lo[1], &ret[i].from_hi[1])
+                          + get_map_from_field(map, "from_typ", i, &ret[i].from_lo[2], &ret[i].from_hi[2]);
+      ret[i].from_ranges  = 1;
+      tag_write(&(ret[i].from.tag), ret[i].from_lo[0], ret[i].from_lo[1], ret[i].from_lo[2]);
       ret[i].to.dev       = get_param_str(map, "to_dev",    0, i);
       ret[i].to.ctag      = get_param_int(map, "to_ctag",   1, i);
-      ret[i].to.tag.mux   = get_param_int(map, "to_mux",    1, i);
-      ret[i].to.tag.sec   = get_param_int(map, "to_sec",    1, i);
-      ret[i].to.tag.typ   = get_param_int(map, "to_typ",    1, i);
+      get_map_to_field(map, "to_mux", i, &ret[i].to.tag.mux, &ret[i].to_rel[0], &ret[i].to_off[0]);
+      get_map_to_field(map, "to_sec", i, &ret[i].to.tag.sec, &ret[i].to_rel[1], &ret[i].to_off[1]);
+      get_map_to_field(map, "to_typ", i, &ret[i].to.tag.typ, &ret[i].to_rel[2], &ret[i].to_off[2]);
       ret[i].codec        = get_param_str(map, "codec",     1, i);
+      if (!config_setting_lookup_int(map, "priority", &ret[i].priority)) ret[i].priority = spec;   /* default: most specific */
+      ret[i].stats        = NULL;
       ret[i].next         = i < count - 1 ? &ret[i+1] : (halmap *) NULL;
 //      fprintf(stderr, "i=%d of %d: f=%s t=%s ctags = %d %d\n", i, count, ret[i].from.dev, ret[i].to.dev,  ret[i].from.ctag, ret[i].to.ctag);
     }
@@ -146,3 +239,26 @@ halmap *get_mappings(config_t *cfg) {
   }
   return ret;
 }
+
+/**********************************************************************/
+/* Free configuration (from get_devices and get_mappings) */
+/*********t************************************************************/
+void free_devices(device *devs) {
+  for(device *d = devs; d != NULL; d = d->next) {
+    free((char *) d->id);    free((char *) d->model);    free((char *) d->comms);
+    free((char *) d->path);  free((char *) d->addr_in);  free((char *) d->addr_out);
+    free((char *) d->mode_in);  free((char *) d->mode_out);
+    free((char *) d->path_r);   free((char *) d->path_w);
+    free((char *) d->tstamp);
+  }
+  free(devs);                /* one array (see get_devices) */
+}
+
+void free_mappings(halmap *map) {
+  for(halmap *hm = map; hm != NULL; hm = hm->next) {
+    free((char *) hm->from.dev);
+    free((char *) hm->to.dev);
+    free((char *) hm->codec);
+  }
+  free(map);                 /* one array (see get_mappings) */
+}
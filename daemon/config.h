@@ -3,3 +3,5 @@
 extern void cfg_read(config_t *, char  *);
 extern device *get_devices(config_t *);
 extern halmap *get_mappings(config_t *);
+extern void free_devices(device *);
+extern void free_mappings(halmap *);
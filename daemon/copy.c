@@ -0,0 +1,147 @@
+/*
+ * Payload copy engine: at startup, time each available copy kernel
+ * (glibc, apex_memmove SSE kernels and a non-temporal streaming copy)
+ * for every payload size class, then route payload copies to the fastest.
+ *   October 2026, Peraton Labs
+ */
+
+#include "hal.h"
+#include "copy.h"
+#include "../escape/perftests/apex_memmove.h"
+#include <time.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386)
+#include <emmintrin.h>
+#define COPY_HAVE_SSE2
+extern void* APEXCALL apex_tiberium(void *dst, const void *src, size_t size);
+extern void* APEXCALL apex_kryptonite(void *dst, const void *src, size_t size);
+#endif
+
+typedef void *(*copy_fn)(void *, const void *, size_t);
+
+typedef struct _copy_kernel {
+  const char *name;
+  copy_fn     fn;
+} copy_kernel;
+
+/**********************************************************************/
+/* A) Copy kernels */
+/*********t************************************************************/
+#ifdef COPY_HAVE_SSE2
+/* Copy using non-temporal (cache bypassing) stores into 16B aligned dst */
+static void *copy_nt_stream(void *dst, const void *src, size_t len) {
+  uint8_t       *d = (uint8_t *) dst;
+  const uint8_t *s = (const uint8_t *) src;
+  size_t         head;
+
+  if (len < 128) return (memcpy(dst, src, len));
+  head = (16 - ((uintptr_t) d & 15)) & 15;
+  memcpy(d, s, head);
+  d += head; s += head; len -= head;
+  for (; len >= 64; len -= 64, d += 64, s += 64) {
+    __m128i x0 = _mm_loadu_si128((const __m128i *) (s));
+    __m128i x1 = _mm_loadu_si128((const __m128i *) (s + 16));
+    __m128i x2 = _mm_loadu_si128((const __m128i *) (s + 32));
+    __m128i x3 = _mm_loadu_si128((const __m128i *) (s + 48));
+    _mm_stream_si128((__m128i *) (d),      x0);
+    _mm_stream_si128((__m128i *) (d + 16), x1);
+    _mm_stream_si128((__m128i *) (d + 32), x2);
+    _mm_stream_si128((__m128i *) (d + 48), x3);
+  }
+  _mm_sfence();
+  memcpy(d, s, len);
+  return (dst);
+}
+#endif
+
+static copy_kernel copy_kernels[] = {
+  {"glibc_memcpy",    memcpy},
+#ifdef COPY_HAVE_SSE2
+  {"apex_tiberium",   apex_tiberium},
+  {"apex_kryptonite", apex_kryptonite},
+  {"nt_stream",       copy_nt_stream},
+#endif
+};
+#define COPY_KERNELS  ((int) (sizeof(copy_kernels) / sizeof(copy_kernels[0])))
+
+/* Largest payload in each size class (last class also takes anything larger) */
+static const size_t copy_class_max[COPY_CLASSES] = {64, 256, 1024, 4096, 16384, 65536, 262144, ADU_SIZE_MAX_C};
+static copy_fn      copy_class_fn[COPY_CLASSES]  = {memcpy, memcpy, memcpy, memcpy, memcpy, memcpy, memcpy, memcpy};
+static pthread_mutex_t copy_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static int             copy_initialized = 0;   /* (under copy_init_lock) */
+
+/**********************************************************************/
+/* B) Calibrate kernels and copy payloads */
+/*********t************************************************************/
+/* Return nanoseconds taken by best of COPY_CAL_TRIALS runs of kernel k */
+static double copy_time_kernel(int k, uint8_t *dst, uint8_t *src, size_t len) {
+  struct timespec ts, te;
+  double          t, t_best = -1;
+  int             reps = (len > 0) ? (COPY_CAL_BYTES / len) : COPY_CAL_BYTES;
+
+  if (reps < 8) reps = 8;
+  copy_kernels[k].fn(dst, src, len);                  /* warm up */
+  for (int trial = 0; trial < COPY_CAL_TRIALS; trial++) {
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    for (int j = 0; j < reps; j++) copy_kernels[k].fn(dst, src, len);
+    clock_gettime(CLOCK_MONOTONIC, &te);
+    t = ((te.tv_sec - ts.tv_sec) * 1e9 + (te.tv_nsec - ts.tv_nsec)) / reps;
+    if ((t_best < 0) || (t < t_best)) t_best = t;
+  }
+  return (t_best);
+}
+
+/* Select the fastest kernel for each size class (else keep glibc memcpy) */
+static void copy_calibrate(void) {
+  uint8_t *src, *dst;
+  size_t   buf_len = copy_class_max[COPY_CLASSES - 1] + 64;
+  double   t, t_best;
+  int      k_best;
+
+  if (COPY_KERNELS < 2) return;
+  src = aligned_alloc(64, buf_len);
+  dst = aligned_alloc(64, buf_len);
+  if ((src == NULL) || (dst == NULL)) {
+    log_warn("%s: no calibration buffers, using glibc memcpy", __func__);
+    free(src); free(dst);
+    return;
+  }
+  memset(src, 0x5a, buf_len);
+  memset(dst, 0xa5, buf_len);
+  for (int c = 0; c < COPY_CLASSES; c++) {
+    k_best = 0;
+    t_best = -1;
+    for (int k = 0; k < COPY_KERNELS; k++) {
+      /* payloads follow a 16 byte header in both input and output buffers */
+      t = copy_time_kernel(k, dst + 16, src + 16, copy_class_max[c]);
+      if ((t_best < 0) || (t < t_best)) { t_best = t; k_best = k; }
+    }
+    copy_class_fn[c] = copy_kernels[k_best].fn;
+    log_debug("copy class <= %7lu B: %-15s %.1f ns (%.2f GB/s)", copy_class_max[c],
+      copy_kernels[k_best].name, t_best, (t_best > 0) ? copy_class_max[c] / t_best : 0);
+  }
+  free(src);
+  free(dst);
+}
+
+/*
+ * Calibrate the kernels (calibrate = 0 keeps glibc memcpy) once per process:
+ * the first call decides, later calls (e.g., from hal_ctx_new) wait for it.
+ */
+void copy_init(int calibrate) {
+  pthread_mutex_lock(&copy_init_lock);
+  if (copy_initialized == 0) {
+    if (calibrate) copy_calibrate();
+    copy_initialized = 1;
+  }
+  pthread_mutex_unlock(&copy_init_lock);
+}
+
+/* Copy payload using the kernel selected for its size class */
+void *copy_payload(void *dst, const void *src, size_t len) {
+  int c = 0;
+
+  while ((c < (COPY_CLASSES - 1)) && (len > copy_class_max[c])) c++;
+  return (copy_class_fn[c](dst, src, len));
+}
@@ -0,0 +1,8 @@
+/* Payload copy engine: fastest calibrated copy kernel per payload size class */
+
+#define COPY_CLASSES     8          /* number of payload size classes */
+#define COPY_CAL_BYTES   0x400000   /* bytes copied per kernel calibration run (4 MB) */
+#define COPY_CAL_TRIALS  3          /* calibration runs per kernel (keep the best) */
+
+extern void  copy_init(int calibrate);
+extern void *copy_payload(void *dst, const void *src, size_t len);
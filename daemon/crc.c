@@ -16,8 +16,10 @@
  */
 
 #include "crc.h"
+#include <pthread.h>
 
-static uint16_t   fcstab[256];      /* lookup table */
+static uint16_t        fcstab[256];      /* lookup table */
+static pthread_once_t  fcstab_once = PTHREAD_ONCE_INIT;
 
 /*
  * Create lookup table (see RFC-1662) in fcstab.
@@ -74,16 +76,17 @@ void tryfcs16(uint16_t *fcstab) {
 //  else printf("Bad FCS %04x\n", trialfcs);
 }
 
+/* Create the lookup table once per process (even if several HAL threads call crc16) */
+static void table_init(void) {
+  table_create(fcstab);
+  tryfcs16(fcstab);
+}
+
 /* Caluculated CRC for a given bufer (starting from scratch) */
 uint16_t crc16(uint8_t *buf, size_t len) {
-  static int  do_once=1;
   uint16_t    crc=0;
   
-  if (do_once==1) {
-    table_create(fcstab);
-    tryfcs16(fcstab);
-    do_once=0;
-  }
+  pthread_once(&fcstab_once, table_init);
   // Step 1) Initialize crc to starting value to all 1's
   crc = pppfcs16(fcstab, PPPINITFCS16, buf, len);
   return (crc);
@@ -0,0 +1,79 @@
+/*
+ * HAL cycle counter
+ *   October 2026, Peraton Labs
+ *
+ * cycles_now reads the TSC (a few ns) if the CPU has an invariant TSC (one
+ * that ticks at a constant rate in all power states), else it calls
+ * clock_gettime(CLOCK_MONOTONIC). cycles_init calibrates TSC ticks to ns
+ * against CLOCK_MONOTONIC once per process, and cycles_ns gives
+ * CLOCK_MONOTONIC time (ns) from the TSC, so HAL timers and latency
+ * statistics share one cheap clock.
+ */
+
+#include "hal.h"
+#include "cycles.h"
+#include <pthread.h>
+#if CYCLES_HAVE_TSC
+#include <cpuid.h>
+#endif
+
+int             cycles_tsc  = 0;
+uint64_t        cycles_mult = 1ULL << 32;
+static uint64_t cycles_base_tsc, cycles_base_ns;   /* TSC and CLOCK_MONOTONIC at calibration */
+static pthread_once_t cycles_once = PTHREAD_ONCE_INIT;
+
+static uint64_t cycles_mono_ns(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+/* Does the CPU have an invariant TSC (CPUID.80000007H:EDX[8])? */
+static int cycles_tsc_invariant(void) {
+#if CYCLES_HAVE_TSC
+  unsigned int a, b, c, d;
+
+  if ((__get_cpuid(0x80000000, &a, &b, &c, &d) == 0) || (a < 0x80000007)) return (0);
+  __get_cpuid(0x80000007, &a, &b, &c, &d);
+  return ((d >> 8) & 1);
+#else
+  return (0);
+#endif
+}
+
+/* Calibrate the TSC against CLOCK_MONOTONIC */
+static void cycles_calibrate(void) {
+  uint64_t        ns0, ns1, tsc0, tsc1;
+  struct timespec w = {0, CYCLES_CALIBRATE_MS * 1000000L};
+
+  if (cycles_tsc_invariant() == 0) {
+    log_debug("No invariant TSC: cycles use CLOCK_MONOTONIC");
+    return;
+  }
+#if CYCLES_HAVE_TSC
+  ns0 = cycles_mono_ns(); tsc0 = __rdtsc();
+  nanosleep(&w, NULL);
+  ns1 = cycles_mono_ns(); tsc1 = __rdtsc();
+  if ((tsc1 <= tsc0) || (ns1 <= ns0)) {
+    log_warn("TSC calibration failed: cycles use CLOCK_MONOTONIC");
+    return;
+  }
+  cycles_mult     = ((ns1 - ns0) << 32) / (tsc1 - tsc0);
+  cycles_base_tsc = tsc1;
+  cycles_base_ns  = ns1;
+  __atomic_store_n(&cycles_tsc, 1, __ATOMIC_RELEASE);
+  log_debug("TSC: %.3f MHz", 1000.0 * (tsc1 - tsc0) / (ns1 - ns0));
+#endif
+}
+
+/* Calibrate the TSC once per process (called by hal_ctx_new; other callers wait until it is done) */
+void cycles_init(void) {
+  pthread_once(&cycles_once, cycles_calibrate);
+}
+
+/* CLOCK_MONOTONIC time in ns (from the TSC if calibrated) */
+uint64_t cycles_ns(void) {
+  if (cycles_tsc) return (cycles_base_ns + cycles_to_ns(cycles_now() - cycles_base_tsc));
+  return (cycles_mono_ns());
+}
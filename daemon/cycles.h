@@ -0,0 +1,33 @@
+/* HAL cycle counter: cheap timestamps for instrumentation (see cycles.c) */
+
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLES_HAVE_TSC 1
+#else
+#define CYCLES_HAVE_TSC 0
+#endif
+
+#define CYCLES_CALIBRATE_MS 10     /* calibrate TSC against CLOCK_MONOTONIC over this time */
+
+extern int      cycles_tsc;        /* 1 = cycles are (invariant) TSC ticks, 0 = CLOCK_MONOTONIC ns */
+extern uint64_t cycles_mult;       /* ns per TSC tick (32.32 fixed point) */
+
+extern void     cycles_init(void);
+extern uint64_t cycles_ns(void);
+
+/* Current cycle count (only differences, converted with cycles_to_ns, are meaningful) */
+static inline uint64_t cycles_now(void) {
+#if CYCLES_HAVE_TSC
+  if (cycles_tsc) return (__rdtsc());
+#endif
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+/* Convert cycles (e.g., a difference of cycles_now values) to ns */
+static inline uint64_t cycles_to_ns(uint64_t c) {
+  return ((cycles_tsc) ? (uint64_t) (((unsigned __int128) c * cycles_mult) >> 32) : c);
+}
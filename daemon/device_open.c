@@ -7,14 +7,15 @@
  *     n) INET device (tcp or udp)
  *     t) Bidirectional Serial Device (tty)
  *     i) Unidirectional Serial Device (ilp)
+ *     p) In-process Device (inproc)
  */
 
 #include "hal.h"
+#include "tcp.h"
+#include "udp.h"
+#include "tty.h"
+#include "coalesce.h"
 #include "../api/xdcomms.h"
-#include <pthread.h>
-typedef struct _thread_args {
-  device *dev;
-} thread_args;
 
 /* Define IPC parent-child process file descriptors */
 #define PARENT_IN  pipe_a2h[0]
@@ -26,6 +27,7 @@ typedef struct _thread_args {
 /* Store information on ILP devices associated with serial root device */
 #define ILP_MAX_DEVICES_PER_ROOT 16
 #define ILP_MAX_ROOT_DEVICES  8
+#define ILP_READ_MAX          2304    /* default read_max for ILIP devices (larger reads failed on some drivers) */
 typedef struct _root_device {
   const char   *root_path;
   int           data_dev_count;
@@ -148,6 +150,18 @@ void interface_open_zmq(device *d) {
 /**********************************************************************/
 /* u) Open Unix IPC Device */
 /*********t************************************************************/
+/* Stop a HAL-ZMQ-API child process */
+void child_kill(int pid) {
+  int rv=-1;
+  char cmd[64];
+  
+  if (pid > 0)  {
+    sprintf(cmd, "kill -9 %d", pid);
+    rv = system(cmd);
+    log_debug("killed child HAL-ZMQ-API process: pid=%d rv=%d", pid, rv);
+  }
+}
+
 /* Start child process (currently zcat) to communicate between APP and HAL */
 void ipc_child_run(int *pipe_a2h, int *pipe_h2a, const char *path, const char *mode, const char *addr) {
   
@@ -260,41 +274,6 @@ void interface_open_ipc(device *d) {
 /**********************************************************************/
 /* Open Device; b) INET (TCP or UDP)  */
 /*********t************************************************************/
-/* Listen for TCP connection on device */
-void *tcp_listen_thread(void *vargp) {
-  thread_args                *p = vargp;
-  device                     *d = (p->dev);
-  struct sockaddr_in  *cli_addr = &(d->socaddr_in);
-  socklen_t                 len = sizeof(cli_addr);
-  int                    connfd;
-  
-  if ((listen(d->listen_fd, 5)) < 0) {
-    fprintf(stderr, "Thread listen failed on %s...\n", d->id);
-    exit(0);
-  }
-  log_trace("Server Thread listening on %s (fd=%d) for connection request on TCP port %d", d->id, d->listen_fd, ntohs(d->socaddr_in.sin_port));
-  if ((connfd = accept(d->listen_fd, (struct sockaddr *) cli_addr, &len)) < 0) {
-    fprintf(stderr, "Thread accept failed on %s...\n", d->id);
-    exit(0);
-  }
-  log_trace("Server Thread accepted TCP client on %s (new fd=%d) and exiting thread", d->id, connfd);
-  d->read_fd = connfd;
-  if (d->write_fd == -1) d->write_fd = connfd;
-//  fprintf(stderr, "fd=(l=%d, r=%d, w=%d)\n", d->listen_fd, d->read_fd, d->write_fd);
-  close (d->listen_fd);
-  pthread_exit(NULL);
-}
-
-/* Create thread to listen for TCP connect packets on device (d) */
-void create_tcp_listen_thread(device *d) {
-  thread_args  args;
-  pthread_t    thread_id;             /* structure with thread ID */
-
-  args.dev = d;
-  pthread_create(&thread_id, NULL, tcp_listen_thread, (void *) &args);
-  sleep (1);
-}
-
 /* Open network socket and return its fd: optionally bind (bind_flag=1) and connect (bind_flag=0 & tcp) */
 int inet_open_socket(device *d, const char *addr, int port, struct sockaddr_in *serv_addr, int bind_flag) {
   int fd, comm_type, opt = 1;
@@ -333,8 +312,7 @@ int inet_open_socket(device *d, const char *addr, int port, struct sockaddr_in *
     log_trace("Device %s has a INET %s server listening on %s port %d", d->id, d->comms, addr, port);
     if ( strcmp(d->comms, "tcp") == 0) {
       d->listen_fd = fd;
-//      log_trace("Device %s creating a listen thresd", d->id);
-      create_tcp_listen_thread(d);
+      tcp_listen_start(d);
     }
   }
   /* c2) Connect the socket (if not UDP) */
@@ -352,6 +330,7 @@ int inet_open_socket(device *d, const char *addr, int port, struct sockaddr_in *
 void interface_open_inet(device *d) {
   int fd_out = -1, fd_in = -1;
   d->listen_fd = -1;    /* Should not need this ?? (already set in config.c) */
+  if ( strcmp(d->comms, "tcp") ==  0 ) tcp_config_defaults(d);
 //  log_trace("xDevice %s has a INET FD-out %d FD-in %d (l=%d, r=%d w=%d)", d->id, fd_out, fd_in, d->listen_fd, d->read_fd, d->write_fd);
 
   /* Create socket and connect if required */
@@ -361,15 +340,15 @@ void interface_open_inet(device *d) {
   
   /* Save file descriptors */
   if ( (fd_out == -1) && (fd_in == -1) ) {log_fatal("\nNo address specified for interface %s\n", d->id); exit(EXIT_FAILURE);}
-  if ( (fd_out != -1) && (fd_in == -1) ) {d->read_fd   = fd_out; d->write_fd = fd_out;}
-  if ( (fd_out == -1) && (fd_in != -1) ) {
-    if ( strcmp(d->comms, "tcp") ==  0 ) {d->listen_fd = fd_in;}
-    else                                 {d->read_fd   = fd_in;  d->write_fd = fd_in;}
-  }
-  if ( (fd_out != -1) && (fd_in != -1) ) {
-    if ( strcmp(d->comms, "tcp") ==  0 ) {d->listen_fd = fd_in;  d->write_fd = fd_out;}
-    else                                 {d->read_fd   = fd_in;  d->write_fd = fd_out;}
+  if ( strcmp(d->comms, "tcp") ==  0 ) {   /* connections made in the poll loop (see tcp.c) */
+    d->listen_fd = fd_in;
+    d->write_fd  = fd_out;
+    return;
   }
+  if ( (fd_out != -1) && (fd_in == -1) ) {d->read_fd   = fd_out; d->write_fd = fd_out;}
+  if ( (fd_out == -1) && (fd_in != -1) ) {d->read_fd   = fd_in;  d->write_fd = fd_in;}
+  if ( (fd_out != -1) && (fd_in != -1) ) {d->read_fd   = fd_in;  d->write_fd = fd_out;}
+  udp_open(d);
 //  log_trace("yDevice %s has a INET FD-out %d FD-in %d (l=%d, r=%d w=%d)", d->id, fd_out, fd_in, d->listen_fd, d->read_fd, d->write_fd);
 }
 
@@ -385,6 +364,7 @@ void interface_open_tty(device *d) {
   }
   d->read_fd = fd;
   d->write_fd = fd;
+  tty_open(d);
 }
 
 /**********************************************************************/
@@ -502,17 +482,17 @@ void ilp_root_device_save_conig(device *d, int *root_count, root_device *root_li
   (rdp->data_dev_count)++;
 }
 
-/* Open ILIP interface */
-void interface_open_ilp(device *d) {
-  static int          root_count=0;
-  static root_device  root_list[ILP_MAX_ROOT_DEVICES], *rd;
-  int                 i, j;
+/* Open ILIP interface (d = NULL opens the root devices saved from earlier calls) */
+void interface_open_ilp(device *d, int *root_count_ptr, root_device *root_list) {
+  root_device        *rd;
+  int                 i, j, root_count;
   
   if (d != NULL) {        /* adding new devces */
 //    fprintf(stderr, "%s: dev=%s %s\n", __func__, d->id, d->comms);
-    ilp_root_device_save_conig(d, &root_count, root_list);
+    ilp_root_device_save_conig(d, root_count_ptr, root_list);
     return;
   }
+  root_count = *root_count_ptr;
 //  fprintf(stderr, "%s: Open %d root device(s)\n", __func__, root_count);
   for (j=0; j<root_count; j++) {
     rd = &(root_list[j]);
@@ -525,21 +505,68 @@ void interface_open_ilp(device *d) {
   }
 }
 
+/**********************************************************************/
+/* Open Device; p) In-process (packets injected and received by function calls) */
+/*********t************************************************************/
+/* Nothing to open: hal_inject routes packets read from the device and
+   its hal_inproc_set receiver gets the packets written to it */
+void interface_open_inproc(device *d) {
+  log_trace("Device %s is in-process (%s receiver)", d->id, (d->inproc_fn == NULL) ? "no" : "has a");
+}
+
 /**********************************************************************/
 /* Open Devices */
 /*********t************************************************************/
 /* Open enabled devices (from linked-list of devices) and get their in/out handles */
-void devices_open(device *dev_linked_list_root) {
-  for(device *d = dev_linked_list_root; d != NULL; d = d->next) {
+void devices_open(hal_ctx *ctx) {
+  int          root_count=0;
+  root_device  root_list[ILP_MAX_ROOT_DEVICES];
+
+  for(device *d = ctx->devs; d != NULL; d = d->next) {
     if (d->enabled == 0) continue;
     if        (!strncmp(d->comms, "tty", 3))                                      interface_open_tty(d);
     else if ( (!strncmp(d->comms, "udp", 3)) || (!strncmp(d->comms, "tcp", 3)) )  interface_open_inet(d);
     else if   (!strncmp(d->comms, "ipc", 3))                                      interface_open_ipc(d);
-    else if   (!strncmp(d->comms, "ilp", 3))                                      interface_open_ilp(d);
+    else if   (!strncmp(d->comms, "ilp", 3))                                      interface_open_ilp(d, &root_count, root_list);
     else if   (!strncmp(d->comms, "zmq", 3))                                      interface_open_zmq(d);
+    else if   (!strcmp(d->comms,  "inproc"))                                      interface_open_inproc(d);
     else { log_fatal("Device %s [%s] unknown", d->id, d->comms); exit(EXIT_FAILURE);}
+    if ((d->read_max <= 0) || (d->read_max > PACKET_MAX)) d->read_max = (strcmp(d->comms, "ilp") == 0) ? ILP_READ_MAX : PACKET_MAX;
+    coalesce_open(d);
 //    log_trace("Open succeeded for %s (with fdr=%d fdw=%d, Next_ptr=%p)", d->id, d->read_fd, d->write_fd, d->next);
 
   }
-  interface_open_ilp(NULL);
+  interface_open_ilp(NULL, &root_count, root_list);
+}
+
+/* Close enabled devices' handles, after writing any coalesced packets (and stop their HAL-ZMQ-API processes) */
+void devices_close(hal_ctx *ctx) {
+  coalesce_flush_all(ctx);
+  for(device *d = ctx->devs; d != NULL; d = d->next) {
+    if (d->enabled == 0) continue;
+    child_kill(d->pid_out);
+    child_kill(d->pid_in);
+    if (d->write_fd != -1) close(d->write_fd);
+    if ((d->read_fd != -1) && (d->read_fd != d->write_fd)) close(d->read_fd);
+    if (d->listen_fd != -1) close(d->listen_fd);
+    if (d->write_soc != NULL) zmq_close(d->write_soc);
+    if (d->read_soc  != NULL) zmq_close(d->read_soc);
+    d->pid_in = d->pid_out = d->read_fd = d->write_fd = d->listen_fd = -1;
+    d->read_soc = d->write_soc = NULL;
+    free(d->rx_carry);
+    d->rx_carry = NULL;
+    d->rx_carry_len = 0;
+    free(d->tty_tx);
+    d->tty_tx = NULL;
+    free(d->txq);
+    d->txq     = NULL;
+    d->txq_off = d->txq_len = 0;
+    free(d->co_buf);
+    d->co_buf = NULL;
+    free(d->co_hist);
+    free(d->co_rx);
+    d->co_hist = NULL;
+    d->co_rx = NULL;
+    d->co_max = 0;
+  }
 }
@@ -8,5 +8,7 @@ extern void devices_print_one(device *, FILE *);
 extern device *find_device_by_read_fd(device *, int);
 extern device *find_device_by_read_soc(device *, void *socket);
 extern device *find_device_by_id(device *, const char *);
-extern void devices_open(device *);
+extern void devices_open(hal_ctx *);
+extern void devices_close(hal_ctx *);
+extern void child_kill(int pid);
 void log_log_devs(int level, device *root, const char *fn);
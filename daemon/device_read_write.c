@@ -8,14 +8,21 @@
 /**********************************************************************/
 #include "hal.h"
 #include "map.h"
+#include "map_tree.h"
 #include "device_open.h"
 #include "packetize.h"
-
-#define MAX_POLL_ITEMS 16
-#define DATA_ALIGNMENT 32       /* Must be power of 2 */
-// PACKET MAX covers max data (ADU_SIZE_MAX_C) + max header (256), and it is multiple of DATA_ALIGNMENT
-#define PACKET_MAX ((ADU_SIZE_MAX_C + 255 + DATA_ALIGNMENT) - ((ADU_SIZE_MAX_C + 255) % DATA_ALIGNMENT))
-#define PACKET_BUFFERS_MAX 2    /* increasing gives (payload mode) driver more time to read data */
+#include "device_read_write.h"
+#include "tcp.h"
+#include "udp.h"
+#include "tty.h"
+#include "coalesce.h"
+#include "time.h"
+#include "stats.h"
+#include "cycles.h"
+#include "pool.h"
+#include "copy.h"
+
+#define TCP_ACCEPT_WAIT_MS 1000 /* Longest wait for TCP connections (both ways) before routing */
 
 /**********************************************************************/
 /* Alternative HAL Modes */
@@ -28,13 +35,10 @@ typedef struct _thread_args {
   int      buf_len;
   uint8_t *buf;
   device  *idev;
-  halmap  *map;
-  device  *devs;
+  hal_ctx *ctx;
 } thread_args;
 #endif
 
-int sel_verbose=0;      /* help debug of device saying it is ready when it is not */
-
 /**********************************************************************/
 /* HAL Applicaiton Data Unit (ADU) Transformation */
 /**********************************************************************/
@@ -75,16 +79,44 @@ void devs_stat_print(device *devs) {
   log_debug("%s", s);
 }
 
+/* Keep the start of a packet split across stream reads (copied before the next read) */
+/* (same = it starts with the bytes kept before, so its time is that of their first read) */
+static void rx_carry_save(device *idev, uint8_t *buf, int len, int same) {
+  if (len >= PACKET_MAX) {              /* a full buffer without a packet: cannot resync, so drop it */
+    log_warn("Dropping %d bytes from %s: no complete packet", len, idev->id);
+    len = 0;
+  }
+  if ((len > 0) && (idev->rx_carry == NULL) && ((idev->rx_carry = malloc(PACKET_MAX)) == NULL)) {
+    log_fatal("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  if (len > 0) memcpy(idev->rx_carry, buf, len);
+  if ((len > 0) && (idev->rx_carry_ttl_ms > 0) && ((same == 0) || (idev->rx_carry_len <= 0))) idev->rx_carry_ns = time_mono_ns();
+  idev->rx_carry_len = len;
+}
+
+/* Copy into buf the packet start kept from the last read of a stream device (dropped if too old). Returns its length */
+static int rx_carry_restore(device *idev, uint8_t *buf) {
+  int len = idev->rx_carry_len;
+
+  if (len <= 0) return (0);
+  if ((idev->rx_carry_ttl_ms > 0) && (time_mono_ns() - idev->rx_carry_ns > idev->rx_carry_ttl_ms * 1000000ULL)) {
+    log_warn("Dropping %d bytes from %s: no more of its packet within %d ms", len, idev->id, idev->rx_carry_ttl_ms);
+    idev->rx_carry_len = 0;
+    return (0);
+  }
+  memcpy(buf, idev->rx_carry, len);
+  return (len);
+}
+
 /* Read device and return buffer pointer and length */
 /* Uses idev to determines how to parse, then extracts selector info and fill psel */
-uint8_t *read_input_dev_into_buffer(device *idev, int *buf_len) {
+uint8_t *read_input_dev_into_buffer(hal_ctx *ctx, device *idev, int *buf_len) {
   int                 fd;
   const char         *com_type, *com_model;
-  struct sockaddr_in  socaddr_in;
-  socklen_t           sock_len = sizeof(socaddr_in);
-  
-  static int          buf_index=0, buf_index_current;              /* Multiple buffers to keep data until read */
-  static uint8_t      buf[PACKET_BUFFERS_MAX][PACKET_MAX]  __attribute__((aligned(DATA_ALIGNMENT)));   /* Input Packet buffers */
+  int                 sel_verbose = ctx->sel_verbose;
+  int                 buf_index = ctx->buf_index;
+  uint8_t           **buf = ctx->buf_in;       /* Input Packet buffers (PACKET_MAX bytes, DATA_ALIGNMENT aligned) */
 
 //  assert((PACKET_MAX%DATA_ALIGNMENT) == 0); /*
 //  log_fatal("DATA_ALIGNMENT = %d, PACKET_MAX = %d, PACKET_MAX % DATA_ALIGNMENT = %d, b0=%p b1=%p", DATA_ALIGNMENT, PACKET_MAX, (PACKET_MAX % DATA_ALIGNMENT), (void *) buf[0], (void *) buf[1]);
@@ -96,25 +128,10 @@ uint8_t *read_input_dev_into_buffer(device *idev, int *buf_len) {
 //exit (21);
   if (sel_verbose) log_trace("HAL reading using comms type %s (model=%s)", com_type, com_model);
   if (   (strcmp(com_type, "ipc") == 0)
-      || (strcmp(com_type, "tty") == 0)
       || (strcmp(com_type, "ilp") == 0)
-      || (strcmp(com_type, "tcp") == 0)
       ) {
-      
-    // Temporary HACK (NOV 2020) to give ILIP buffer of right sizes for sdh_be_v2 and sdh_be_v3
-    if (strcmp(com_model, "sdh_be_v2") == 0) {
-//      log_fatal("Temporary HACK to give ILIP buffer of 256 on fd=%d: buf=%p len=%d max=%d->256 err=%d\n", fd, buf, *buf_len, PACKET_MAX, errno);
-      *buf_len = read(fd, buf[buf_index], 256);     /* HACK, max to exact size of of ILIP packet */
-    }
-    else if (strcmp(com_model, "sdh_be_v3") == 0) {
-      //      *buf_len = read(fd, buf[buf_index], 512);     /* HACK to packet (256) + data (?); but not too high (e.g., 1350 fails) */
-      *buf_len = read(fd, buf[buf_index], 2304);    /* v12  bigger packets (buffer big en */
-      *buf_len = 256;                    /* HACK to packet (256) - actually gets 512 */
-    }
-    // TODOz - read from ZMQ socket instread of file descriptor
-    else {
-      *buf_len = read(fd, buf[buf_index], PACKET_MAX);     /* read = recv for tcp with no flags */
-    }
+    /* Each read returns one or more complete packets (e.g., sdh_be_v3 descriptors, each followed by its payload) */
+    *buf_len = read(fd, buf[buf_index], idev->read_max);
           
     if (*buf_len < 0) {
       if (sel_verbose) log_trace("read error on fd=%d: rv=%d errno=%d", fd, *buf_len, errno);
@@ -126,12 +143,41 @@ uint8_t *read_input_dev_into_buffer(device *idev, int *buf_len) {
       exit(EXIT_FAILURE);
     }
   }
-  else if (strcmp(com_type, "udp") == 0) {
-    *buf_len = recvfrom(fd, buf[buf_index], PACKET_MAX, PACKET_MAX, (struct sockaddr *) &socaddr_in, &sock_len);
+  else if (strcmp(com_type, "tty") == 0) {      /* stream: first copy any packet (or HDLC frame) start left by the last read */
+    int carry = rx_carry_restore(idev, buf[buf_index]), part;
+    *buf_len = read(fd, buf[buf_index] + carry, (idev->read_max < PACKET_MAX - carry) ? idev->read_max : PACKET_MAX - carry);
     if (*buf_len < 0) {
-      log_fatal("recvfrom errno code: %d", errno);
+      if (errno == EAGAIN) return (NULL);
+      log_fatal("read error on fd=%d: rv=%d errno=%d", fd, *buf_len, errno);
       exit(EXIT_FAILURE);
     }
+    *buf_len += carry;
+    if (idev->tty_hdlc) {                          /* keep only the complete frames' packets */
+      *buf_len = hdlc_decode(idev, buf[buf_index], carry, *buf_len, &part);
+      rx_carry_save(idev, buf[buf_index] + *buf_len, part, (*buf_len == 0));
+    }
+  }
+  else if (strcmp(com_type, "tcp") == 0) {      /* stream: first copy any packet start left by the last read */
+    int carry = rx_carry_restore(idev, buf[buf_index]);
+    *buf_len = recv(fd, buf[buf_index] + carry, PACKET_MAX - carry, 0);
+    if (*buf_len <= 0) {
+      if ((*buf_len < 0) && (errno == EAGAIN)) return (NULL);
+      tcp_disconnect(ctx, idev, fd, (*buf_len == 0) ? "closed by peer" : strerror(errno));
+      *buf_len = 0;
+      return (NULL);
+    }
+    *buf_len += carry;
+  }
+  else if (strcmp(com_type, "udp") == 0) {      /* (with udp_gro, datagrams are pieces of packets, as for tcp) */
+    int carry = rx_carry_restore(idev, buf[buf_index]);
+    *buf_len = udp_read(idev, buf[buf_index] + carry, PACKET_MAX - carry);
+    if (*buf_len < 0) {
+      idev->rx_carry_len = 0;
+      *buf_len = 0;
+      return (NULL);
+    }
+    idev->udp_carry_len = carry;                 /* (datagram boundaries for the udp_gro checks) */
+    *buf_len += carry;
   }
   else if (strcmp(com_type, "zmq") == 0) {
     *buf_len = zmq_recv (idev->read_soc, buf[buf_index], PACKET_MAX, 0);
@@ -150,9 +196,8 @@ uint8_t *read_input_dev_into_buffer(device *idev, int *buf_len) {
   
 //log_trace("mux=%d", *((uint32_t *) buf[buf_index]));
 
-  buf_index_current = buf_index;
-  buf_index = (buf_index + 1) % PACKET_BUFFERS_MAX;
-  return(buf[buf_index_current]);
+  ctx->buf_index = (buf_index + 1) % PACKET_BUFFERS_MAX;
+  return(buf[buf_index]);
 }
 
 /* Read input buffer into internal PDU (and return packet length) */
@@ -161,33 +206,48 @@ pdu *read_pdu_from_buffer(device *idev, uint8_t *buf, int buf_len, int *pkt_len)
   
   pdu_ptr = malloc(sizeof(pdu));
   *pkt_len = pdu_from_packet(pdu_ptr, buf, buf_len, idev);
-  if  (*pkt_len <= 0) return(NULL);
+  if  (*pkt_len <= 0) {
+    free((char *) pdu_ptr->psel.dev);
+    free(pdu_ptr);
+    return(NULL);
+  }
 //  log_trace("HAL extracted packet of len=%d from Input buf (%p) of len=%d", *pkt_len, (void *) buf, buf_len);
   log_pdu_trace(pdu_ptr, __func__);
   return(pdu_ptr);
 }
 
 /* Write buffer to interface device based on interface comms type */
-void write_buf(device *odev, uint8_t *buf, int pkt_len) {
+void write_buf(hal_ctx *ctx, device *odev, uint8_t *buf, int pkt_len) {
   int             rv=-1;
   const char     *com_type = odev->comms;
 
   log_trace("HAL writing to %s using comms type %s (len=%d buf=%p)", odev->id, com_type, pkt_len, (void *)buf);
   if (   (strcmp(com_type, "ipc") == 0)
-      || (strcmp(com_type, "tty") == 0)
       || (strcmp(com_type, "ilp") == 0)
-      || (strcmp(com_type, "tcp") == 0)
      ) {
-    rv = write(odev->write_fd, buf, pkt_len);     /* write = send for tcp with no flags */
+    rv = write(odev->write_fd, buf, pkt_len);
+  }
+  else if (strcmp(com_type, "tty") == 0) {
+    rv = tty_write(odev, buf, pkt_len);
+  }
+  else if (strcmp(com_type, "tcp") == 0) {
+    rv = tcp_write(ctx, odev, buf, pkt_len);
   }
   else if (strcmp(com_type, "udp") == 0) {
 //    fprintf(stderr, "XXX: Write udp mode to %s interface\n", com_type);
-    rv = sendto(odev->write_fd, buf, pkt_len, MSG_CONFIRM, (const struct sockaddr *) &(odev->socaddr_out), sizeof(odev->socaddr_out));
+    rv = udp_write(odev, buf, pkt_len);
   }
   else if (strcmp(com_type, "zmq") == 0) {
     rv = zmq_send (odev->write_soc, buf, pkt_len, 0);
     if (rv <= 0) log_error("RCV ERROR on ZMQ socket %d: size=%d err=%s", odev->write_soc, rv, zmq_strerror(errno));
   }
+  else if (strcmp(com_type, "inproc") == 0) {
+    if (odev->inproc_fn == NULL) log_warn("No receiver set for inproc device %s (see hal_inproc_set)", odev->id);
+    else {
+      odev->inproc_fn(odev->inproc_arg, buf, pkt_len);
+      rv = pkt_len;
+    }
+  }
   else {
     log_fatal("Unknown comms type %s", com_type);
     exit(EXIT_FAILURE);
@@ -199,95 +259,173 @@ void write_buf(device *odev, uint8_t *buf, int pkt_len) {
 }
 
 // Split packet into multiple chunks
-void write_in_chunks(device *odev, uint8_t *buf, int pkt_len) {
+void write_in_chunks(hal_ctx *ctx, device *odev, uint8_t *buf, int pkt_len) {
   int i, n = 1;
   int split_len = pkt_len / n;
   int final_len = pkt_len - ((n-1) * split_len);
   
   log_warn(">>>> SPLIT packet (len=%d) into %d chunks (len=%d, %d)", pkt_len, n, split_len, final_len);
   for (i = 0; i<n; i++) {
-    if (i < (n-1)) write_buf(odev, buf, split_len);
-    else           write_buf(odev, buf, final_len);
+    if (i < (n-1)) write_buf(ctx, odev, buf, split_len);
+    else           write_buf(ctx, odev, buf, final_len);
     buf += pkt_len;
   }
 }
         
-/* Convert PDU into packet based on interface packet model, then send  */
-void write_pdu(device *odev, selector *selector_to, pdu *p) {
-  int             pkt_len=0;
-  static uint8_t  buf[PACKET_MAX];        /* Packet buffer when writing */
+/* Can odev send a packet of pkt_len bytes gathered from header and payload (sockets: one sendmsg)? */
+static int write_gathers(device *odev, int pkt_len) {
+  if (strcmp(odev->comms, "tcp") == 0) return (1);
+  if (strcmp(odev->comms, "udp") == 0) return ((odev->udp_gso_size <= 0) || (pkt_len <= odev->udp_gso_size));
+  return (0);
+}
+
+/* Write packet gathered from iov (see write_gathers) */
+void write_bufv(hal_ctx *ctx, device *odev, struct iovec *iov, int iovcnt, int pkt_len) {
+  int             rv=-1;
+
+  if (strcmp(odev->comms, "tcp") == 0) rv = tcp_writev(ctx, odev, iov, iovcnt, pkt_len);
+  else                                 rv = udp_writev(odev, iov, iovcnt, pkt_len);
+  (odev->count_w)++;
+  log_debug("HAL writes (comms=%s, format=%s) onto %s: len=%d (gathered)", odev->comms, odev->model, odev->id, rv);
+}
 
+/*
+ * Convert PDU into packet based on interface packet model, then send. Each output
+ * of a PDU gets its own header, but shares its payload: sockets gather header and
+ * payload, while other outputs write their header in front of one copy of the
+ * payload, made once per PDU (by the first such output) and freed in pdu_delete.
+ * Devices with coalesce_us copy short packets into their coalescing buffer
+ * instead (see coalesce.c). The in-HAL latency from rx_cycles is added to lat
+ * once the packet is written.
+ */
+void write_pdu(hal_ctx *ctx, device *odev, selector *selector_to, pdu *p, stats_hist *lat, uint64_t rx_cycles) {
+  int             pkt_len=0, off;
+  uint8_t        *buf = ctx->buf_out;     /* Packet header (or short packet) buffer when writing */
+  uint8_t        *pkt;
+  struct iovec    iov[2];
+
+  p->tstamp_out = (odev->tstamp_clock >= 0) ? time_clock_ns(odev->tstamp_clock) : 0;
 //  log_trace("HAL writing to %s (using buf=%p)", odev->id, (void *) buf);
 //  log_pdu_trace(p, __func__);
-//  log_buf_trace("Packet", buf, pkt_len);
-  pdu_into_packet(buf, p, &pkt_len, selector_to, odev->model);
+  pdu_into_header(buf, p, &pkt_len, selector_to, odev->model);
   if (pkt_len <= 0) return;      // do not write if bad length
-
-//  write_in_chunks(odev, buf, pkt_len);
-  write_buf(odev, buf, pkt_len);
-  
+  off = p->payload_off;
+  if ((off > PACKET_HEADER_MAX) || (pkt_len > PACKET_MAX)) {
+    log_warn("Dropping %s packet for %s: too long (header=%d len=%d)", odev->model, odev->id, off, pkt_len);
+    return;
+  }
+  if ((odev->coalesce_us > 0) && (coalesce_add(ctx, odev, buf, p, pkt_len, lat, rx_cycles))) return;
+  if (off < 0) {
+    write_buf(ctx, odev, buf, pkt_len);
+    stats_add(lat, (int64_t) cycles_to_ns(cycles_now() - rx_cycles));
+    return;
+  }
+  if (write_gathers(odev, pkt_len)) {
+    iov[0].iov_base = buf;     iov[0].iov_len = off;
+    iov[1].iov_base = p->data; iov[1].iov_len = p->data_len;
+    write_bufv(ctx, odev, iov, 2, pkt_len);
+    stats_add(lat, (int64_t) cycles_to_ns(cycles_now() - rx_cycles));
+    return;
+  }
+  if (p->payload == NULL) {      /* first output needing the packet in one buffer copies the payload */
+    p->payload = pool_get(ctx);
+    copy_payload(p->payload->buf + PACKET_HEADER_MAX, p->data, p->data_len);
+  }
+  pkt = p->payload->buf + PACKET_HEADER_MAX - off;
+  memcpy(pkt, buf, off);
+//  write_in_chunks(ctx, odev, pkt, pkt_len);
+  write_buf(ctx, odev, pkt, pkt_len);
+  stats_add(lat, (int64_t) cycles_to_ns(cycles_now() - rx_cycles));
 }
 
 /**********************************************************************/
 /* HAL Device Process Chain  */
 /**********************************************************************/
 /* Free memory allocated for PDU */
-void pdu_delete(pdu *pdu) {
+void pdu_delete(hal_ctx *ctx, pdu *pdu) {
+  if (pdu->payload != NULL) pbuf_put(ctx, pdu->payload);
   free((char *) pdu->psel.dev);  /* Device ID string (from strdup in 'pdu_from_packet')*/
   free(pdu);
 }
 
-/* Extract input packets from input buffer */
-int route_packets(uint8_t *buf, int buf_len, device *idev, halmap *map, device *devs) {
+/* Route each complete packet in the input buffer. Returns bytes used (the rest is an incomplete packet) */
+int route_packets(hal_ctx *ctx, uint8_t *buf, int buf_len, device *idev) {
   pdu     *ipdu;
   device  *odev;
   halmap  *h;
-  int      pkt_len=0;
+  mleaf   *leaf;
+  selector osel;
+  stats_flow *st;
+  int      pkt_len=0, used=0, oneway;
+  int64_t  oneway_ns = 0;
+  uint64_t rx_cycles = cycles_now();    /* in-HAL latency is from here (packets in one read arrive together) */
 
   if(buf_len <= 0) {
     log_trace("==================== No data from %s ====================\n", idev->id);
 //    if (sel_verbose==1) fprintf(stderr, "%s: Input PDU is NULL\n", __func__);
-    return (1);
+    return (0);
   }
   
   /* Process one or more packets: input buffer -> internal PDU -> output device */
-  while (buf_len > 0) {
+  for (; buf_len > 0; buf += pkt_len, buf_len -= pkt_len, used += pkt_len) {
     ipdu = read_pdu_from_buffer(idev, buf, buf_len, &pkt_len);
+    if((ipdu != NULL) && ((pkt_len > buf_len)      /* (a packet cannot end past the input, nor, with udp_gro, break datagram boundaries) */
+                       || ((idev->udp_seg_in > 0) && (udp_gro_packet_ok(idev, used, pkt_len, used + buf_len) == 0)))) {
+      pdu_delete(ctx, ipdu);
+      ipdu    = NULL;
+      pkt_len = PKT_INVALID;
+    }
+    if((ipdu == NULL) && (idev->udp_seg_in > 0) && ((pkt_len == PKT_INVALID) || (udp_gro_carry_ok(idev, used, used + buf_len) == 0))) {
+      pkt_len = udp_gro_skip(idev, used, used + buf_len);      /* resync at the next datagram */
+      log_warn("Dropping %d bytes from %s: not a packet sent in whole datagrams", pkt_len, idev->id);
+      continue;
+    }
+    if((ipdu == NULL) && (pkt_len == PKT_INVALID)) {
+      log_warn("==================== Invalid %s packet from %s: dropping %d bytes ====================\n", idev->model, idev->id, buf_len);
+      used += buf_len;                  /* (a stream device resyncs on its next read) */
+      break;
+    }
     if(ipdu == NULL) {
-      log_trace("==================== No packet in Input Buffer from %s ====================\n", idev->id);
-      pdu_delete(ipdu);
-      return (0);
+      log_trace("==================== No (complete) packet in Input Buffer from %s (len=%d) ====================\n", idev->id, buf_len);
+      break;
     }
     
-    h = halmap_find(ipdu, map);
-    if(h == NULL) {
+    leaf = map_tree_lookup(idev, ipdu);
+    if(leaf == NULL) {
+      if (ipdu->psel.ctag >= 0) log_warn("Could not find ctag 0x%06x from %s", ipdu->psel.ctag, idev->id);
+      else log_warn("Could not find tag <%d, %d, %d> from %s", ipdu->psel.tag.mux, ipdu->psel.tag.sec, ipdu->psel.tag.typ, idev->id);
       log_trace("==================== No matching HAL map entry from %s ====================\n", idev->id);
       log_pdu_trace(ipdu, __func__);
-      pdu_delete(ipdu);
-      return (0);
-    }
-    
-    odev = find_device_by_id(devs, h->to.dev);
-    if(odev == NULL) {
-      log_warn("==================== Device %s not found for output ====================\n", h->to.dev);
-      pdu_delete(ipdu);
-      return (0);
+      pdu_delete(ctx, ipdu);
+      continue;
     }
+    oneway = (idev->tstamp_clock >= 0) && (ipdu->tstamp_in != 0);
+    if (oneway) oneway_ns = (int64_t) (time_clock_ns(idev->tstamp_clock) - ipdu->tstamp_in);
+
+    /* Write to the output of each matching HAL map entry (more than one is a fan-out) */
+    for (int i = 0; i < leaf->n; i++) {
+      h    = leaf->h[i];
+      odev = leaf->odev[i];
+      if(odev == NULL) {
+        log_warn("==================== Device %s not found for output ====================\n", h->to.dev);
+        continue;
+      }
+
+      /* Avoid Application not being ready to receive (inproc receivers are always ready) */
+      if ((strcmp(idev->id, h->to.dev) == 0) && (strcmp(odev->comms, "inproc") != 0)) {
+        log_trace("%s: Loopback (%s -> %s) sleep = 50ms", __func__, idev->id, h->to.dev);
+        usleep(50000);
+      }
 
-    /* Avoid Application not being ready to receive */
-    if (strcmp(idev->id, h->to.dev) == 0) {
-      log_trace("%s: Loopback (%s -> %s) sleep = 50ms", __func__, idev->id, h->to.dev);
-      usleep(50000);
+      st = stats_flow_get(h);
+      if (oneway) stats_add(&(st->oneway), oneway_ns);
+      write_pdu(ctx, odev, halmap_to_selector(h, ipdu, &osel), ipdu, &(st->hal), rx_cycles);
     }
-    
-    write_pdu(odev, &(h->to), ipdu);
-    pdu_delete(ipdu);
-    buf      += pkt_len;
-    buf_len  -= pkt_len;
+    pdu_delete(ctx, ipdu);
 // log_trace("length remaining in buffer after one packet removed = %d bytes", buf_len);
   }
-  log_trace("==================== Successfully processed input from %s to %s =============\n", idev->id, odev->id);
-  return (0);
+  log_trace("==================== Processed %d bytes of input from %s =============\n", used, idev->id);
+  return (used);
 }
 
 #ifdef MTHREAD
@@ -295,20 +433,19 @@ int route_packets(uint8_t *buf, int buf_len, device *idev, halmap *map, device *
 void *route_packets_thread(void *vargp) {
 //  printf("********* Inside route_packets thread *********\n");
   thread_args *p=vargp;
-  route_packets(p->buf, p->buf_len, p->idev, p->map, p->devs);
+  route_packets(p->ctx, p->buf, p->buf_len, p->idev);
   pthread_exit(NULL);
 }
 
 /* Create thread to route packet(s) to output */
-void create_routing_thread(uint8_t *buf, int buf_len, device *idev, halmap *map, device *devs) {
+void create_routing_thread(hal_ctx *ctx, uint8_t *buf, int buf_len, device *idev) {
   thread_args  args;
   pthread_t    thread_id;             /* structure with thread ID */
   
   args.buf     = buf;
   args.buf_len = buf_len;
   args.idev    = idev;
-  args.map     = map;
-  args.devs    = devs;
+  args.ctx     = ctx;
   pthread_create(&thread_id, NULL, route_packets_thread, (void *) &args);
 }
 #endif
@@ -348,7 +485,7 @@ int select_init(device *dev_linked_list_root, fd_set *readfds) {
 }
 
 /* Wait for input from any read interface */
-void read_wait_loop2(device *devs, halmap *map, int hal_wait_us) {
+void read_wait_loop2(hal_ctx *ctx) {
   int       nunready, nready;
   int       maxrfd;                   /* Maximum file descriptor number for select */
   fd_set    readfds, readfds_saved;   /* File descriptor set for select */
@@ -356,6 +493,9 @@ void read_wait_loop2(device *devs, halmap *map, int hal_wait_us) {
   uint8_t  *buf;
   int       buf_len;
 
+  device   *devs = ctx->devs;
+  int       sel_verbose = ctx->sel_verbose, hal_wait_us = ctx->wait_us;
+
   maxrfd = select_init(devs,  &readfds_saved);
 
   while (1) {
@@ -379,8 +519,9 @@ void read_wait_loop2(device *devs, halmap *map, int hal_wait_us) {
         idev = find_device_by_read_fd(devs, i);
         if (idev == NULL)      log_warn("Device not found for input\n");
         else {
-          buf = read_input_dev_into_buffer(idev, &buf_len);
-          nunready += route_packets(buf, buf_len, idev, map, devs);
+          buf = read_input_dev_into_buffer(ctx, idev, &buf_len);
+          nunready += (buf_len <= 0);
+          route_packets(ctx, buf, buf_len, idev);
         }
         nready--;
       }
@@ -394,36 +535,6 @@ void read_wait_loop2(device *devs, halmap *map, int hal_wait_us) {
 }
 #endif
 
-/*
- * Connect a TCP client device to its remote TCP listener
- */
-void tcp_connect_now(device *d) {
-  struct sockaddr_in *serv_addr;
-  char   addr[88];
-  
-  serv_addr = &(d->socaddr_out);
-  if(inet_ntop(AF_INET, (const char *) &(serv_addr->sin_addr), addr, 88)<=0) {
-    log_fatal("Invalid address or Address not supported for %s", d->id);
-    exit(EXIT_FAILURE);
-  }
-  log_trace("Attempting to connect to a remote server (%s:%d) using local device %s (fd=%d, type=%s) ", addr, ntohs(serv_addr->sin_port), d->id, d->write_fd, d->comms);
-  while (connect(d->write_fd, (struct sockaddr *) serv_addr, sizeof(*serv_addr)) < 0) {
-//    log_trace("Connection failed for %s", d->id);
-    sleep(1);
-  }
-  log_trace("Successfully connected to remote server (%s:%d)", addr, ntohs(serv_addr->sin_port));
-}
-
-/* Connect all INET devices to see if they use TCP clients (and hence need to connect) */
-void tcp_connect_all(device *dev_linked_list_root) {
-  device *d;
-
-  for(d = dev_linked_list_root; d != NULL; d = d->next) {
-//    log_trace("%s listen fd = %d", d->id, d->listen_fd);
-    if ((d->listen_fd) != -1) tcp_connect_now(d);
-  }
-}
-  
 /*
  * Set the Array structure with the desired input ØMQ socket and standard socket fd
  * Set the desired event(s) on those sockets.
@@ -431,76 +542,164 @@ void tcp_connect_all(device *dev_linked_list_root) {
  *                 the a) 0MQ socket or b) the standrd socket fd
  *   ZMQ_POLLERR - an error exists on the standard socket fd (not on 0MQ)
  */
-int zmq_poll_init(device *dev_linked_list_root, zmq_pollitem_t items[], int *num_zmq_items) {
-  int      i=0;
-  char     s[256]="", str_new[64];
-  device  *d;                   /*  device pointer */
+int zmq_poll_init(hal_ctx *ctx) {
+  int              i=0;
+  char             s[256]="", str_new[64];
+  device          *d;                   /*  device pointer */
+  device          *dev_linked_list_root = ctx->devs;
+  zmq_pollitem_t  *items = ctx->items;
+  int             *num_zmq_items = &(ctx->num_zmq_items);
 
   /* First load ØMQ sockets into item */
   for(d = dev_linked_list_root; d != NULL; d = d->next) {
-    if ((d->enabled != 0) && (d->read_soc != NULL)) {
+    if ((d->enabled != 0) && (d->read_soc != NULL) && (i < MAX_POLL_ITEMS)) {
       sprintf(str_new, "%s(soc=%p) ", d->id, d->read_soc);
       strcat(s, str_new);
       items[i].socket = d->read_soc;
       items[i].events = ZMQ_POLLIN;
+      ctx->item_dev[i]  = d;
+      ctx->item_kind[i] = POLL_ITEM_READ;
       i++;
     }
   }
   *num_zmq_items = i;
-  /* Second get standard unix socket 'fd' into item*/
+  /* Second get standard unix socket 'fd' into item (and TCP sockets waiting to accept, connect or write) */
   for(d = dev_linked_list_root; d != NULL; d = d->next) {
-    if ((d->enabled != 0) && (d->read_fd >= 0)) {
-      sprintf(str_new, "%s(fd=%d) ", d->id, d->read_fd);
-      strcat(s, str_new);
+    if (d->enabled == 0) continue;
+    if ((d->read_fd >= 0) && (i < MAX_POLL_ITEMS)) {
+      if (strlen(s) < 192) {sprintf(str_new, "%s(fd=%d) ", d->id, d->read_fd); strcat(s, str_new);}
       items[i].socket = NULL;
       items[i].fd     = d->read_fd;
       items[i].events = ZMQ_POLLIN;
+      ctx->item_dev[i]  = d;
+      ctx->item_kind[i] = POLL_ITEM_READ;
+      i++;
+    }
+    if (strcmp(d->comms, "tcp") != 0) continue;
+    if ((d->listen_fd >= 0) && (i < MAX_POLL_ITEMS)) {
+      items[i].socket = NULL;
+      items[i].fd     = d->listen_fd;
+      items[i].events = ZMQ_POLLIN;
+      ctx->item_dev[i]  = d;
+      ctx->item_kind[i] = POLL_ITEM_ACCEPT;
+      i++;
+    }
+    if ((d->tcp_state == TCP_STATE_CONNECTING) && (i < MAX_POLL_ITEMS)) {
+      items[i].socket = NULL;
+      items[i].fd     = d->write_fd;
+      items[i].events = ZMQ_POLLOUT;
+      ctx->item_dev[i]  = d;
+      ctx->item_kind[i] = POLL_ITEM_CONNECT;
+      i++;
+    }
+    if ((d->tcp_state == TCP_STATE_CONNECTED) && (d->txq_len > 0) && (i < MAX_POLL_ITEMS)) {
+      items[i].socket = NULL;
+      items[i].fd     = d->write_fd;
+      items[i].events = ZMQ_POLLOUT;
+      ctx->item_dev[i]  = d;
+      ctx->item_kind[i] = POLL_ITEM_WRITE;
       i++;
     }
   }
-  log_debug("========== HAL Waiting for first input from %d ZMQ and %d Unix device(s): %s\n", *num_zmq_items, i-(*num_zmq_items), s);
+  log_debug("========== HAL Waiting for input from %d ZMQ and %d Unix socket(s): %s\n", *num_zmq_items, i-(*num_zmq_items), s);
+  ctx->num_items  = i;
+  ctx->poll_dirty = 0;
   return (i);
 }
 
-/* Wait for input from any read interface */
-void read_wait_loop(device *devs, halmap *map, int hal_wait_us) {
-#ifdef MSELECT
-  read_wait_loop2(devs, map, hal_wait_us);
+/* Start TCP connections, then route (up to TCP_ACCEPT_WAIT_MS) until all are connected */
+void read_wait_init(hal_ctx *ctx) {
+  uint64_t end = time_mono_ns() + TCP_ACCEPT_WAIT_MS * 1000000ULL;
+
+  for (device *d = ctx->devs; d != NULL; d = d->next) {
+    if ((d->enabled != 0) && (d->tcp_conn == 1) && (strcmp(d->comms, "tcp") == 0)) tcp_connect_start(ctx, d);
+  }
+  zmq_poll_init(ctx);
+  while ((tcp_all_connected(ctx) == 0) && (time_mono_ns() < end)) read_wait_once(ctx, 10);
+  if (tcp_all_connected(ctx) == 0) log_warn("Not all TCP devices connected after %d ms (will keep trying)", TCP_ACCEPT_WAIT_MS);
+}
+
+/* Read device and route its packet(s), keeping any incomplete packet of a stream device */
+static void read_and_route(hal_ctx *ctx, device *idev) {
+  uint8_t  *buf;
+  int       buf_len, used;
+
+  buf = read_input_dev_into_buffer(ctx, idev, &buf_len);
+#ifdef MTHREAD
+  create_routing_thread(ctx, buf, buf_len, idev);
+  (void) used;
+#else
+  used = route_packets(ctx, buf, buf_len, idev);
+  if ((buf_len > 0) && (idev->rx_stream) && (idev->read_fd != -1)) rx_carry_save(idev, buf + used, buf_len - used, (used == 0));
+  else if (used < buf_len) log_warn("Dropping %d bytes from %s: incomplete %s packet", buf_len - used, idev->id, idev->model);
 #endif
-  int             num_items, num_zmq_items;  /* number of items in the items array */
-  zmq_pollitem_t  items[MAX_POLL_ITEMS];
+}
+
+/* Wait (up to timeout_ms, -1 = indefinitely) for input, then route it. Returns devices read (-1 on error) */
+int read_wait_once(hal_ctx *ctx, int timeout_ms) {
+  zmq_pollitem_t *items = ctx->items;
   device         *idev;
-  uint8_t        *buf;
-  int             buf_len, i, rc;
-
-  tcp_connect_all(devs);
-  sleep(1);
-  num_items = zmq_poll_init(devs, items, &num_zmq_items);
-  while (1) {     /* Main HAL Loop */
-    rc = zmq_poll(items, num_items, -1);    /* Poll for events indefinitely (-1) */
+  uint64_t        now, next, due;
+  int             i, n, rc, nready;
+  short           ev;
+
+  /* TCP timers (coalesced writes and reconnects) and coalesced packets due may shorten the wait */
+  now  = time_mono_ns();
+  next = tcp_timers(ctx, now);
+  due  = coalesce_timers(ctx, now);
+  if ((due != 0) && ((next == 0) || (due < next))) next = due;
+  if (next != 0) {
+    int ms = (int) ((next - now + 999999) / 1000000);
+    if (ms < 1) ms = 1;
+    if ((timeout_ms < 0) || (ms < timeout_ms)) timeout_ms = ms;
+  }
+  if (ctx->poll_dirty) zmq_poll_init(ctx);
+
+  if (ctx->num_items == 0) {            /* e.g., only inproc devices (input comes from hal_inject) */
+    if (timeout_ms != 0) usleep((timeout_ms < 0) ? 1000000 : timeout_ms * 1000);
+    return (0);
+  }
+  rc = zmq_poll(items, ctx->num_items, timeout_ms);
 //    log_trace("Found %d (of %d) devices ready to be read", rc, num_items);
-    if (rc <= 0) {
-      log_error("Poll error rc=%d (0 is a timeout) errno=%d\n", rc, errno);
-      continue;
-    }
-    for (i = 0; i < num_items; i++) {
+  if (rc < 0) {
+    if (errno != EINTR) log_error("Poll error rc=%d errno=%d\n", rc, errno);
+    return (-1);
+  }
+  n = ctx->num_items;                   /* TCP events may change the items, so rebuild them after */
+  nready = rc;
+  for (i = 0; (i < n) && (rc > 0); i++) {
 //      log_trace("device %d - EVENTS=0x%x REVENTS=0x%d", i, items[i].events, items[i].revents);
-      if (items[i].revents & ZMQ_POLLIN) {   /* Data ready to be read */
-        if (i < num_zmq_items) idev = find_device_by_read_soc(devs, items[i].socket);
-        else                   idev = find_device_by_read_fd (devs, items[i].fd);
-        if (idev == NULL)      log_warn("Device %s not found for input\n", idev);
-        else {
+    if ((ev = items[i].revents) == 0) continue;
+    rc--;
+    idev = ctx->item_dev[i];
+    switch (ctx->item_kind[i]) {
+      case POLL_ITEM_ACCEPT:
+        tcp_accept(ctx, idev);
+        break;
+      case POLL_ITEM_CONNECT:
+        if ((idev->tcp_state == TCP_STATE_CONNECTING) && (idev->write_fd == items[i].fd)) tcp_connect_done(ctx, idev);
+        break;
+      case POLL_ITEM_WRITE:
+        if (idev->write_fd == items[i].fd) tcp_flush(ctx, idev);
+        break;
+      default:                          /* Data ready to be read (or an error, seen by reading a TCP socket) */
+        if ((i >= ctx->num_zmq_items) && (idev->read_fd != items[i].fd)) break;    /* closed since poll */
+        if ((ev & ZMQ_POLLIN) || ((ev & ZMQ_POLLERR) && (strcmp(idev->comms, "tcp") == 0))) {
 //          log_trace("%s ready to be read", idev->id);
-          buf = read_input_dev_into_buffer(idev, &buf_len);
-#ifdef MTHREAD
-          create_routing_thread(buf, buf_len, idev, map, devs);
-#else
-          route_packets(buf, buf_len, idev, map, devs);
-#endif
+          read_and_route(ctx, idev);
         }
-      }
-//       if (items[j].revents & ZMQ_POLLERR ) {  /* Error on standard fd */
     }
   }
+  if (ctx->poll_dirty) zmq_poll_init(ctx);
+  return (nready);
 }
 
+/* Wait for input from any read interface (until hal_stop) */
+void read_wait_loop(hal_ctx *ctx, int timeout_ms) {
+#ifdef MSELECT
+  read_wait_loop2(ctx);
+#endif
+  while (__atomic_load_n(&(ctx->running), __ATOMIC_ACQUIRE)) {     /* Main HAL Loop */
+    read_wait_once(ctx, timeout_ms);
+  }
+}
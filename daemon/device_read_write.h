@@ -1 +1,5 @@
-void read_wait_loop(device *, halmap *, int);
+void read_wait_init(hal_ctx *);
+int  read_wait_once(hal_ctx *, int);
+void read_wait_loop(hal_ctx *, int);
+int  route_packets(hal_ctx *, uint8_t *, int, device *);
+void write_buf(hal_ctx *, device *, uint8_t *, int);
@@ -15,78 +15,37 @@
 /**********************************************************************/
 
 #include "hal.h"
-#include "config.h"
+#include "hal_ctx.h"
 #include "device_open.h"
-#include "device_read_write.h"
-#include "map.h"
-#include "packetize.h"
 
-void child_kill(int pid) {
-  int rv=-1;
-  char cmd[64];
-  
-  if (pid > 0)  {
-    sprintf(cmd, "kill -9 %d", pid);
-    rv = system(cmd);
-    log_debug("killed child HAL-ZMQ-API process: pid=%d rv=%d", pid, rv);
-  }
-}
-
-void socket_kill(int fd) {
-  if (fd != -1) {
-//    fprintf(stderr, "closing fd=%d\n", fd);
-    close (fd);
-  }
-}
+static hal_ctx *hal_main_ctx;        /* the daemon's HAL instance */
+static char    *hal_stats_file;      /* per-flow latency statistics file (NULL = stderr) */
 
-/* Signal Handler for SIGINT - print statistics */
-device   *root_dev;
+/* Signal Handler for SIGINT - end the HAL loop (hal_exit then prints statistics) */
 void sigintHandler(int sig_num)
 {
+  hal_stop(hal_main_ctx);
+}
+
+/* Close devices (flushing any coalesced packets), then print statistics and free the HAL instance */
+static void hal_exit(void) {
   char   s[256]="", str_new[64];
+  FILE  *fp;
 
-  for(device *d = root_dev; d != NULL; d = d->next) {
+  devices_close(hal_main_ctx);
+  hal_main_ctx->opened = 0;
+  for(device *d = hal_main_ctx->devs; d != NULL; d = d->next) {
     if (d->enabled != 0) {
       sprintf(str_new, "%s[r=%d w=%d] ", d->id, d->count_r, d->count_w);
       strcat(s, str_new);
-      child_kill(d->pid_out);
-      child_kill(d->pid_in);
-      socket_kill (d->write_fd);
-      socket_kill (d->read_fd);
-//      socket_kill (d->listen_fd);
     }
   }
   fprintf(stderr, "\nDevice read-write summary: %s\n", s);
-  exit(0);
-}
-
-#define CTAG_MOD   256
-/* convert tag into compressed tag if not set */
-void convert_into_ctag(const char *id, selector *s) {
-  if ( (strcmp(id, s->dev) == 0) && (s->ctag == -1) ) {
-      s->ctag = (CTAG_MOD * (
-                    ( CTAG_MOD * ((s->tag.mux) % CTAG_MOD)) +
-                                 ((s->tag.sec) % CTAG_MOD)
-                             )
-                ) +              ((s->tag.typ) % CTAG_MOD);
-//    fprintf(stderr, "converted %s m=%d s=%d t=%d -> ctag=%d (0x%06x)\n", s->dev, s->tag.mux, s->tag.sec, s->tag.typ, s->ctag, s->ctag);
-  }
-}
-
-/* Find maps that shoud have compressed tags based on the device model */
-/* Converts those it finds in both the 'to' and 'from' maps */
-void map_check_ctags(device *devs, halmap *map) {
-  for(device *d = devs; d != NULL; d = d->next) {
-    if (d->enabled == 0) continue;
-//    fprintf(stderr, "device %s: %s %s\n", d->id, d->comms, d->model);
-    if (strcmp(d->model, "sdh_bw_v1") == 0) {
-      for (halmap *hm = map; hm != NULL; hm = hm->next) {
-        convert_into_ctag(d->id, &(hm->from));
-        convert_into_ctag(d->id, &(hm->to));
-      }
-//      log_log_halmap(LOG_FATAL, map, __func__);
-    }
-  }
+  if ((hal_stats_file == NULL) || ((fp = fopen(hal_stats_file, "w")) == NULL)) fp = stderr;
+  hal_stats_print(hal_main_ctx, fp);
+  if (fp != stderr) fclose(fp);
+  hal_ctx_free(hal_main_ctx);
+  hal_main_ctx = NULL;
 }
 
 /**********************************************************************/
@@ -94,9 +53,6 @@ void map_check_ctags(device *devs, halmap *map) {
 /*********t************************************************************/
 void hal_init(char *file_name_config, char *file_name_log, char *file_name_stats,
               int log_level, int hal_quiet, int hal_wait_us) {
-  config_t  cfg;           /* Configuration */
-  device   *devs;          /* Linked list of enabled devices */
-  halmap   *map;           /* Linked list of selector mappings */
   FILE     *fp=NULL;
   
   /* a) Logging */
@@ -110,29 +66,22 @@ void hal_init(char *file_name_config, char *file_name_log, char *file_name_stats
     log_set_fp(fp);
   }
   if (file_name_stats != NULL) {
-    log_trace("TODO: Openning Stats file: %s", file_name_stats);
+    log_trace("Stats file (written on exit): %s", file_name_stats);
+    hal_stats_file = file_name_stats;
   }
   
-  log_trace("CONFIG-FILE = %s", file_name_config);
   log_trace("LOG = [file=%s, lev=%d, limit=%d, quiet=%d]", file_name_log, log_level, LOG_LEVEL_MIN, hal_quiet);
   log_trace("wait_us=%d", hal_wait_us);
   /* b) Load coniguration */
-  cfg_read(&cfg, file_name_config);
-  devs = get_devices(&cfg);
-//  log_devs_debug(devs, __func__);
-  map  = get_mappings(&cfg);
-  log_halmap_debug(map, __func__);
-  config_destroy(&cfg);
-
-  map_check_ctags(devs, map);
+  hal_main_ctx = hal_ctx_config(file_name_config, hal_wait_us);
   
   /* c) Open devices */
-  devices_open(devs);
-  log_devs_debug(devs, __func__);
-  /* d) Initialize signal handler, then Wait for input */
+  hal_open(hal_main_ctx);
+  /* d) Initialize signal handler, then Wait for input (until SIGINT) */
   signal(SIGINT, sigintHandler);
-  root_dev = devs;
-  read_wait_loop(devs, map, hal_wait_us);
+  hal_loop(hal_main_ctx);
+  signal(SIGINT, SIG_DFL);           /* (a second SIGINT ends a stuck exit) */
+  hal_exit();
 }
 
 /**********************************************************************/
@@ -146,7 +95,7 @@ void opts_print(void) {
   printf(" -h : print this message\n");
   printf(" -l : log level: 0=TRACE, 1=DEBUG, 2=INFO, 3=WARN, 4=ERROR, 5=FATAL (default = 2)\n");
   printf(" -q : quiet: disable logging on stderr (default = enabled)\n");
-//  printf(" -s : statistics file name (default = no log file)\n");
+  printf(" -s : per-flow latency statistics file name, written on SIGINT (default = stderr)\n");
   printf(" -w : device not ready (EAGAIN) wait time in microseconds (default = 1000us): -1 exits if not ready\n");
   printf("CONFIG-FILE: path to HAL configuration file (e.g., test/sample.cfg)\n");
 }
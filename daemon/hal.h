@@ -21,11 +21,21 @@
 #include "../log/log.h"
 #include <zmq.h>
 
+#define MAX_POLL_ITEMS 16
+#define DATA_ALIGNMENT 32       /* Must be power of 2 */
+// PACKET MAX covers max data (ADU_SIZE_MAX_C) + max header (256), and it is multiple of DATA_ALIGNMENT
+#define PACKET_MAX ((ADU_SIZE_MAX_C + 255 + DATA_ALIGNMENT) - ((ADU_SIZE_MAX_C + 255) % DATA_ALIGNMENT))
+#define PACKET_HEADER_MAX 256   /* longest packet header (payloads shared by outputs start this far into a buffer) */
+#define PACKET_BUFFERS_MAX 2    /* increasing gives (payload mode) driver more time to read data */
+
 /**********************************************************************/
 /* HAL Daemon Linked List Device and Halmap Databases */
 /*********t************************************************************/
 // #define SN_LIST_WINDOW_SIZE 1000
 
+/* Receiver of packets HAL writes to an inproc device (arg is from hal_inproc_set) */
+typedef void hal_inproc_fn(void *arg, uint8_t *pkt, int pkt_len);
+
 /* HAL interface device (to the application or to the network) parameters */
 typedef struct _dev {
   /* A) external parameters for this device (from HAL config file) */
@@ -44,6 +54,19 @@ typedef struct _dev {
   int         port_in;     /* port HAL listens to on this device */
   int         port_out;    /* port HAL connects to from this device */
   int         from_mux;    /* tag mux value for ilip device */
+  int         tcp_nodelay;     /* TCP: disable Nagle (1 = default) or not (0) */
+  int         tcp_cork_us;     /* TCP: coalesce writes (TCP_CORK) for up to this long (0 = default, off) */
+  int         tcp_cork_bytes;  /* TCP: ... or until this many bytes are waiting */
+  int         udp_gso_size;    /* UDP: send packets as datagrams of this size (UDP_SEGMENT), 0 = default, off */
+  int         udp_gro;         /* UDP: reassemble packets from datagrams, batched with UDP_GRO (1), or not (0 = default) */
+  int         read_max;        /* most bytes per read (for ilp, ipc and tty devices), unset = default */
+  int         tty_baud;        /* TTY: line speed (e.g., 115200), unset = unchanged */
+  int         tty_vmin;        /* TTY: raw mode VMIN (1 = default) and ... */
+  int         tty_vtime;       /* ... VTIME in deciseconds (0 = default) */
+  int         tty_hdlc;        /* TTY: HDLC-like framing with crc16 FCS (1), or none (0 = default) */
+  const char *tstamp;          /* clock of packet linux_time stamps: "realtime", "mono_raw" or none (default) */
+  int         coalesce_us;     /* tcp, udp, tty: coalesce packets written for up to this long (0 = default, off) */
+  int         coalesce_bytes;  /* ... or until this many bytes are waiting */
   /* B) internal structures and parameters for this device */
   struct sockaddr_in socaddr_in;
   struct sockaddr_in socaddr_out;
@@ -57,6 +80,36 @@ typedef struct _dev {
   int         pid_in;      /* HAL-ZMQ-API process ids */
   int         pid_out;
   int         tcp_conn;    /* TCP device that connects to TCP listner */
+  int         tcp_state;   /* TCP connection state (TCP_STATE_* in tcp.h) */
+  int         tcp_backoff_ms;       /* TCP client: wait before next reconnect */
+  uint64_t    tcp_retry_ns;         /* TCP client: time of next reconnect */
+  uint64_t    cork_deadline_ns;     /* TCP: time to send coalesced writes (0 = none waiting) */
+  int         cork_len;             /* TCP: bytes coalesced */
+  uint8_t    *txq;                  /* TCP: send queue (TCP_TXQ_BYTES, allocated when first needed) ... */
+  int         txq_off;              /* ... offset of its first unsent byte ... */
+  int         txq_len;              /* ... and end of its bytes (0 = empty) */
+  int         udp_gso_off;          /* UDP: kernel refused UDP_SEGMENT, so HAL segments */
+  int         udp_seg_in;           /* UDP GRO: length of the datagrams last read (0 = no udp_gro read) */
+  int         udp_seg_carry;        /* UDP GRO: length of the datagrams in rx_carry ... */
+  int         udp_carry_len;        /* ... and bytes of them at the start of the last read's buffer */
+  int         hdlc_esc;             /* TTY: last byte read was an HDLC escape */
+  uint8_t    *tty_tx;               /* TTY: HDLC frame buffer for writes */
+  uint8_t    *co_buf;               /* packets coalesced for one write (coalesce_bytes) */
+  int         co_len;
+  int         co_pkts;
+  int         co_max;               /* entries in co_hist and co_rx */
+  struct _stats_hist **co_hist;     /* in-HAL latency histogram of each coalesced packet ... */
+  uint64_t   *co_rx;                /* ... and the cycles_now its input was read (sampled when written) */
+  uint64_t    co_deadline_ns;       /* time to write coalesced packets (0 = none waiting) */
+  int         rx_stream;   /* Packets may be split across reads (e.g., TCP), so keep rx_carry */
+  int         rx_carry_ttl_ms;      /* Drop rx_carry not completed within this time (0 = never) */
+  uint8_t    *rx_carry;    /* Stream device: start of a packet split across reads */
+  int         rx_carry_len;
+  uint64_t    rx_carry_ns;          /* time rx_carry was saved */
+  int         tstamp_clock;         /* clock id of tstamp (-1 = none) */
+  hal_inproc_fn *inproc_fn;   /* inproc device: called with each packet written to it */
+  void       *inproc_arg;
+  struct _mtree *map_tree; /* HAL map entries for packets from this device, compiled by map_tree_build */
   struct _dev *next;       /* Deices saved as a linked list */
 } device;
 
@@ -68,10 +121,18 @@ typedef struct _sel {
 } selector;
 
 /* HAL map entry (linked list) */
+#define MAP_FIELDS 3              /* tag fields (mux, sec, typ) a HAL map entry matches and rewrites */
 typedef struct _hal {
   selector    from;
   selector    to;
   const char  *codec;
+  int         from_ranges;              /* match tag field i from from_lo[i] to from_hi[i] (else from.tag exactly) */
+  uint32_t    from_lo[MAP_FIELDS];
+  uint32_t    from_hi[MAP_FIELDS];
+  int         to_rel[MAP_FIELDS];       /* to tag field i is the input's plus to_off[i] (else to.tag) */
+  int         to_off[MAP_FIELDS];
+  int         priority;                 /* of matching entries, HAL uses (all) those with the highest priority */
+  struct _stats_flow *stats;  /* latency statistics (allocated on first packet) */
   struct _hal *next;
 } halmap;
 
@@ -84,6 +145,45 @@ typedef struct _pdu {
   size_t    data_len;
 //  uint8_t   data[ADU_SIZE_MAX_C];   /* TODO_PDU_PTR */
   uint8_t   *data;                  /* TODO_PDU_PTR */
+  uint64_t  tstamp_in;              /* sender's linux_time (ns, 0 = none) read from packet */
+  uint64_t  tstamp_out;             /* linux_time (ns, 0 = none) to write into packet */
+  int       payload_off;            /* set by models: offset of a payload ending the packet, not copied (-1 = in packet) */
+  struct _pbuf *payload;            /* payload copy shared by outputs (NULL until one needs it, see pool.h) */
 } pdu;
 
+/* pdu_from_packet errors (else it returns the packet length) */
+#define PKT_INCOMPLETE  (-1)        /* buffer has only the start of a packet (stream devices read the rest) */
+#define PKT_INVALID     (-2)        /* packet has a bad length field (drop the rest of the buffer) */
+
+/**********************************************************************/
+/* HAL Instance (all state of one routing loop; see hal_ctx.h) */
+/*********t************************************************************/
+typedef struct _hal_ctx {
+  device          *devs;            /* Linked list of devices */
+  halmap          *map;             /* Linked list of selector mappings */
+  int              owns_config;     /* devs and map from hal_ctx_config (freed with the context) */
+  int              opened;          /* devices opened by hal_open (closed by hal_ctx_free) */
+  int              wait_us;         /* device not ready (EAGAIN) wait time (-1 exits if not ready) */
+  int              sel_verbose;     /* help debug of device saying it is ready when it is not */
+  int              running;         /* hal_loop runs until hal_stop clears this (atomic access) */
+  /* Poll items of the devices HAL reads (the first num_zmq_items are ZMQ sockets) */
+  zmq_pollitem_t   items[MAX_POLL_ITEMS];
+  device          *item_dev[MAX_POLL_ITEMS];     /* device of each item */
+  int              item_kind[MAX_POLL_ITEMS];    /* what each item waits for (POLL_ITEM_*) */
+  int              num_items;
+  int              num_zmq_items;
+  int              poll_dirty;      /* device handles changed (e.g., TCP reconnect): rebuild items */
+  /* Packet buffers */
+  uint8_t         *buf_in[PACKET_BUFFERS_MAX];   /* Multiple buffers to keep data until read */
+  int              buf_index;
+  uint8_t         *buf_out;        /* output packet header (PACKET_HEADER_MAX bytes), or whole packet if short */
+  struct _pbuf    *pool_free;      /* payload pool (see pool.h) */
+  int              pool_count;
+} hal_ctx;
+
+#define POLL_ITEM_READ    0       /* packet(s) to read */
+#define POLL_ITEM_ACCEPT  1       /* TCP listener has a connection to accept */
+#define POLL_ITEM_CONNECT 2       /* TCP client connect has completed (or failed) */
+#define POLL_ITEM_WRITE   3       /* TCP connection can take queued bytes */
+
 #endif
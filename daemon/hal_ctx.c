@@ -0,0 +1,166 @@
+/*
+ * HAL routing library (libhal): create, run and free HAL instances
+ *   October 2026, Peraton Labs
+ */
+
+#include "hal.h"
+#include "hal_ctx.h"
+#include "config.h"
+#include "device_open.h"
+#include "device_read_write.h"
+#include "map.h"
+#include "map_tree.h"
+#include "stats.h"
+#include "cycles.h"
+#include "pool.h"
+#include "copy.h"
+
+/**********************************************************************/
+/* A) Compressed tags */
+/*********t************************************************************/
+/* convert tag into compressed tag if not set */
+void convert_into_ctag(const char *id, selector *s) {
+  if ( (strcmp(id, s->dev) == 0) && (s->ctag == -1) ) {
+      s->ctag = tag_to_ctag(&(s->tag));
+//    fprintf(stderr, "converted %s m=%d s=%d t=%d -> ctag=%d (0x%06x)\n", s->dev, s->tag.mux, s->tag.sec, s->tag.typ, s->ctag, s->ctag);
+  }
+}
+
+/* Find maps that shoud have compressed tags based on the device model */
+/* Converts those it finds in both the 'to' and 'from' maps */
+void map_check_ctags(device *devs, halmap *map) {
+  for(device *d = devs; d != NULL; d = d->next) {
+    if (d->enabled == 0) continue;
+//    fprintf(stderr, "device %s: %s %s\n", d->id, d->comms, d->model);
+    if (strcmp(d->model, "sdh_bw_v1") == 0) {
+      for (halmap *hm = map; hm != NULL; hm = hm->next) {
+        convert_into_ctag(d->id, &(hm->from));
+        convert_into_ctag(d->id, &(hm->to));
+      }
+//      log_log_halmap(LOG_FATAL, map, __func__);
+    }
+  }
+}
+
+/**********************************************************************/
+/* B) Create and free a HAL instance */
+/*********t************************************************************/
+/* Create HAL instance routing between devs using map (the caller keeps ownership of both) */
+hal_ctx *hal_ctx_new(device *devs, halmap *map, int wait_us) {
+  hal_ctx *ctx = calloc(1, sizeof(hal_ctx));
+
+  if (ctx == NULL) {
+    log_fatal("Cannot allocate HAL context");
+    exit(EXIT_FAILURE);
+  }
+  cycles_init();           /* (once per process) */
+  copy_init(1);            /* (once per process) */
+  ctx->devs    = devs;
+  ctx->map     = map;
+  ctx->wait_us = wait_us;
+  for (int i = 0; i < PACKET_BUFFERS_MAX; i++) ctx->buf_in[i] = aligned_alloc(DATA_ALIGNMENT, PACKET_MAX);
+  ctx->buf_out = aligned_alloc(DATA_ALIGNMENT, PACKET_HEADER_MAX);     /* (payloads are shared from the pool) */
+  for (int i = 0; i < PACKET_BUFFERS_MAX; i++) {
+    if ((ctx->buf_in[i] == NULL) || (ctx->buf_out == NULL)) {
+      log_fatal("Cannot allocate HAL packet buffers (%d bytes each)", PACKET_MAX);
+      exit(EXIT_FAILURE);
+    }
+  }
+  map_check_ctags(devs, map);
+  map_tree_build(devs, map);
+  return (ctx);
+}
+
+/* Create HAL instance with the devices and HAL map from a configuration file */
+hal_ctx *hal_ctx_config(char *file_name_config, int wait_us) {
+  config_t  cfg;
+  hal_ctx  *ctx;
+  device   *devs;          /* Linked list of enabled devices */
+  halmap   *map;           /* Linked list of selector mappings */
+
+  log_trace("CONFIG-FILE = %s", file_name_config);
+  cfg_read(&cfg, file_name_config);
+  devs = get_devices(&cfg);
+//  log_devs_debug(devs, __func__);
+  map  = get_mappings(&cfg);
+  log_halmap_debug(map, __func__);
+  config_destroy(&cfg);
+
+  ctx = hal_ctx_new(devs, map, wait_us);
+  ctx->owns_config = 1;
+  return (ctx);
+}
+
+/* Close the instance's devices and free it (with its configuration if from hal_ctx_config) */
+void hal_ctx_free(hal_ctx *ctx) {
+  if (ctx == NULL) return;
+  hal_stop(ctx);
+  if (ctx->opened) devices_close(ctx);
+  stats_free(ctx->map);
+  map_tree_free(ctx->devs);
+  if (ctx->owns_config) {
+    free_devices(ctx->devs);
+    free_mappings(ctx->map);
+  }
+  for (int i = 0; i < PACKET_BUFFERS_MAX; i++) free(ctx->buf_in[i]);
+  free(ctx->buf_out);
+  pool_free(ctx);
+  free(ctx);
+}
+
+/**********************************************************************/
+/* C) Run a HAL instance */
+/*********t************************************************************/
+/* Set the receiver of packets HAL writes to inproc device dev_id (before hal_open). Returns 0, or -1 if no such device */
+int hal_inproc_set(hal_ctx *ctx, const char *dev_id, hal_inproc_fn *fn, void *arg) {
+  device *d = find_device_by_id(ctx->devs, dev_id);
+
+  if ((d == NULL) || (strcmp(d->comms, "inproc") != 0)) {
+    log_error("No enabled inproc device %s", dev_id);
+    return (-1);
+  }
+  d->inproc_fn  = fn;
+  d->inproc_arg = arg;
+  return (0);
+}
+
+/* Open the devices (connecting TCP clients and waiting for TCP servers' clients) */
+void hal_open(hal_ctx *ctx) {
+  devices_open(ctx);
+  ctx->opened = 1;
+  log_devs_debug(ctx->devs, __func__);
+  read_wait_init(ctx);
+  __atomic_store_n(&(ctx->running), 1, __ATOMIC_RELEASE);
+}
+
+/* Route packet(s) as if read from device dev_id (e.g., an inproc device). Returns 0, or -1 if no such device */
+int hal_inject(hal_ctx *ctx, const char *dev_id, uint8_t *pkt, int pkt_len) {
+  device *idev = find_device_by_id(ctx->devs, dev_id);
+
+  if (idev == NULL) {
+    log_error("Cannot inject packet: no enabled device %s", dev_id);
+    return (-1);
+  }
+  if (pkt_len > 0) (idev->count_r)++;
+  route_packets(ctx, pkt, pkt_len, idev);
+  return (0);
+}
+
+/* Wait (up to timeout_ms, -1 = indefinitely) for device input and route it. Returns devices read (-1 on error) */
+int hal_poll(hal_ctx *ctx, int timeout_ms) {
+  return (read_wait_once(ctx, timeout_ms));
+}
+
+/* Route device input until hal_stop (e.g., called from another thread or a signal handler) */
+void hal_loop(hal_ctx *ctx) {
+  read_wait_loop(ctx, HAL_LOOP_POLL_MS);
+}
+
+void hal_stop(hal_ctx *ctx) {
+  __atomic_store_n(&(ctx->running), 0, __ATOMIC_RELEASE);
+}
+
+/* Print the latency statistics of each HAL map entry with packets */
+void hal_stats_print(hal_ctx *ctx, FILE *fp) {
+  stats_print(ctx->map, fp);
+}
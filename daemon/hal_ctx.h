@@ -0,0 +1,29 @@
+/*
+ * HAL routing library (libhal): a HAL instance is a context holding its
+ * devices, HAL map, buffers and poll state, so an application or test can
+ * host one or more HAL instances in-process (the daemon runs one).
+ *
+ * Typical use (see README.md):
+ *   ctx = hal_ctx_config("test/sample.cfg", 1000);    (or hal_ctx_new(devs, map, 1000))
+ *   hal_inproc_set(ctx, "app0", my_receiver, my_arg);   (for each inproc device)
+ *   hal_open(ctx);
+ *   hal_inject(ctx, "app0", pkt, pkt_len);             (route a packet read from app0)
+ *   hal_loop(ctx);                                     (or call hal_poll; hal_stop ends the loop)
+ *   hal_ctx_free(ctx);
+ */
+
+#include "hal.h"
+
+#define HAL_LOOP_POLL_MS 100      /* hal_loop poll timeout (longest wait to see hal_stop) */
+
+extern hal_ctx *hal_ctx_new(device *devs, halmap *map, int wait_us);
+extern hal_ctx *hal_ctx_config(char *file_name_config, int wait_us);
+extern void     hal_ctx_free(hal_ctx *ctx);
+
+extern int      hal_inproc_set(hal_ctx *ctx, const char *dev_id, hal_inproc_fn *fn, void *arg);
+extern void     hal_open(hal_ctx *ctx);
+extern int      hal_inject(hal_ctx *ctx, const char *dev_id, uint8_t *pkt, int pkt_len);
+extern int      hal_poll(hal_ctx *ctx, int timeout_ms);
+extern void     hal_loop(hal_ctx *ctx);
+extern void     hal_stop(hal_ctx *ctx);
+extern void     hal_stats_print(hal_ctx *ctx, FILE *fp);
@@ -4,6 +4,7 @@
  */
 
 #include "hal.h"
+#include "map.h"
 
 /**********************************************************************/
 /* HAL Print (structure information) */
@@ -44,15 +45,45 @@ void log_log_pdu(int level, pdu *pdu, const char *fn) {
   }
 }
 
+static const char *map_field_names[MAP_FIELDS] = {"mux", "sec", "typ"};
+
+/* Print a HAL map entry's matched (input) tag fields: each a value, "lo-hi" or "*" */
+static void halmap_print_from(halmap *hm, FILE *fd) {
+  fprintf(fd, "%s[", hm->from.dev);
+  for (int f = 0; f < MAP_FIELDS; f++) {
+    fprintf(fd, "%s%s=", (f > 0) ? " " : "", map_field_names[f]);
+    if      ((hm->from_lo[f] == 0) && (hm->from_hi[f] == UINT32_MAX))  fprintf(fd, "*");
+    else if (hm->from_lo[f] == hm->from_hi[f])                         fprintf(fd, "%02u", hm->from_lo[f]);
+    else                                                               fprintf(fd, "%u-%u", hm->from_lo[f], hm->from_hi[f]);
+  }
+  fprintf(fd, "] ");
+}
+
+/* Print a HAL map entry's output tag fields: each a value or the input's ("$", "$+N" or "$-N") */
+static void halmap_print_to(halmap *hm, FILE *fd) {
+  uint32_t v[MAP_FIELDS] = {hm->to.tag.mux, hm->to.tag.sec, hm->to.tag.typ};
+
+  fprintf(fd, "%s[", hm->to.dev);
+  for (int f = 0; f < MAP_FIELDS; f++) {
+    fprintf(fd, "%s%s=", (f > 0) ? " " : "", map_field_names[f]);
+    if      (hm->to_rel[f] == 0)  fprintf(fd, "%02u", v[f]);
+    else if (hm->to_off[f] == 0)  fprintf(fd, "$");
+    else                          fprintf(fd, "$%+d", hm->to_off[f]);
+  }
+  fprintf(fd, "] ");
+}
+
 /* Print a single HAL map entry for debugging */
 void halmap_print_one(halmap *hm, FILE *fd) {
   if (fd == NULL) return;
   fprintf(fd, "   ");
-  selector_print(&(hm->from), fd);
+  if ((hm->from_ranges) && (hm->from.ctag < 0))         halmap_print_from(hm, fd);
+  else                                                  selector_print(&(hm->from), fd);
   fprintf(fd, "-> ");
-  selector_print(&(hm->to), fd);
+  if (hm->to_rel[0] | hm->to_rel[1] | hm->to_rel[2])    halmap_print_to(hm, fd);
+  else                                                  selector_print(&(hm->to), fd);
   if (strlen(hm->codec) > 0)  fprintf(fd, ", codec=%s", hm->codec);
-  fprintf(fd, "\n");
+  fprintf(fd, ", priority=%d\n", hm->priority);
 }
 
 /* Print list of HAL map entries for debugging */
@@ -74,33 +105,54 @@ void log_log_halmap(int level, halmap *map_root, const char *fn) {
 /* HAL MAP processing */
 /*********t************************************************************/
 
-/* Return halmap with from selector matching PDU selector from the halmap list */
+/* Compressed tag (ctag) of tag t: 8 bits of each field (mux, sec, typ) */
+int tag_to_ctag(gaps_tag *t) {
+  return ((int) (((t->mux % CTAG_MOD) * CTAG_MOD + (t->sec % CTAG_MOD)) * CTAG_MOD + (t->typ % CTAG_MOD)));
+}
+
+void ctag_to_tag(int ctag, gaps_tag *t) {
+  tag_write(t, (ctag / (CTAG_MOD * CTAG_MOD)) % CTAG_MOD, (ctag / CTAG_MOD) % CTAG_MOD, ctag % CTAG_MOD);
+}
+
+/* Return whether halmap entry hm's from selector matches PDU selector */
+static int halmap_matches(pdu *p, halmap *hm) {
+  selector *hsel = &(hm->from);
+  gaps_tag *tag  = &(p->psel.tag);
+  uint32_t  v[MAP_FIELDS] = {tag->mux, tag->sec, tag->typ};
+
+  if (strcmp(hsel->dev, p->psel.dev) != 0) return (0);
+  if (p->psel.ctag >= 0)                   return (hsel->ctag == p->psel.ctag);
+  if (hsel->ctag >= 0)                     return (0);
+  if (hm->from_ranges == 0) return ((hsel->tag.mux == tag->mux) && (hsel->tag.sec == tag->sec) && (hsel->tag.typ == tag->typ));
+  for (int f = 0; f < MAP_FIELDS; f++) {
+    if ((v[f] < hm->from_lo[f]) || (v[f] > hm->from_hi[f])) return (0);
+  }
+  return (1);
+}
+
+/* Return (first) halmap with the highest priority whose from selector matches PDU selector, or NULL */
+/* (a linear search: route_packets uses the decision tree in map_tree.c, which also finds fan-out entries) */
 halmap *halmap_find(pdu *p, halmap *map_root) {
-  selector *hsel;
-  selector *psel = &(p->psel);
-  gaps_tag *tag  = &(psel->tag);
-  int       ctag = psel->ctag;
-
-//  fprintf(stderr, "%s", __func__);
-  for(halmap *hm = map_root; hm != NULL; hm = hm->next) {
-    if (strcmp(hm->from.dev, p->psel.dev) == 0) {
-      hsel = &(hm->from);
-      if (ctag < 0) {
-         if ( (hsel->tag.mux == tag->mux)
-           && (hsel->tag.sec == tag->sec)
-           && (hsel->tag.typ == tag->typ)
-             ) {
-           return (hm);
-         }
-      }
-      else
-      {
-        if (hsel->ctag == ctag) {
-          return (hm);
-        }
-      }
-    }
+  halmap *h = NULL;
+
+  for (halmap *hm = map_root; hm != NULL; hm = hm->next) {
+    if ((halmap_matches(p, hm)) && ((h == NULL) || (hm->priority > h->priority))) h = hm;
   }
-  log_warn("Could not find tag <%d, %d, %d> from %s", tag->mux, tag->sec, tag->typ, p->psel.dev);
-  return (halmap *) NULL;
+  if (h == NULL) log_warn("Could not find tag <%d, %d, %d> from %s", p->psel.tag.mux, p->psel.tag.sec, p->psel.tag.typ, p->psel.dev);
+  return (h);
+}
+
+/* Return halmap entry h's output selector for PDU p: h->to, or (in buf) its tag rewritten from p's tag */
+selector *halmap_to_selector(halmap *h, pdu *p, selector *buf) {
+  gaps_tag  in;
+
+  if ((h->to_rel[0] | h->to_rel[1] | h->to_rel[2]) == 0) return (&(h->to));
+  if (p->psel.ctag >= 0) ctag_to_tag(p->psel.ctag, &in);
+  else                   in = p->psel.tag;
+  *buf = h->to;
+  if (h->to_rel[0]) buf->tag.mux = in.mux + h->to_off[0];
+  if (h->to_rel[1]) buf->tag.sec = in.sec + h->to_off[1];
+  if (h->to_rel[2]) buf->tag.typ = in.typ + h->to_off[2];
+  if (buf->ctag >= 0) buf->ctag = tag_to_ctag(&(buf->tag));
+  return (buf);
 }
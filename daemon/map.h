@@ -11,6 +11,11 @@
 #endif
 
 extern void data_print (const char *, uint8_t *, size_t);
+#define CTAG_MOD   256
+
 halmap *halmap_find(pdu *, halmap *);
+selector *halmap_to_selector(halmap *, pdu *, selector *);
+int  tag_to_ctag(gaps_tag *);
+void ctag_to_tag(int, gaps_tag *);
 void log_log_pdu(int level, pdu *pdu, const char *fn);
 void log_log_halmap(int level, halmap *map_root, const char *fn);
@@ -0,0 +1,208 @@
+/*
+ * HAL map decision tree
+ *   October 2026, Peraton Labs
+ *
+ * A HAL map entry matches each tag field (mux, sec and typ) of packets
+ * from its input device as one value, a range ("lo-hi") or any value
+ * ("*"); packets with a compressed tag (ctag) match entries with that
+ * ctag. map_tree_build compiles the entries from each input device into
+ * a decision tree: a node splits the values of one field into intervals
+ * at the entries' bounds, so every value in an interval matches the same
+ * entries (adjacent intervals with the same entries are merged). A lookup
+ * is then one binary search per field, whose cost grows with the log of
+ * the number of distinct bounds, not with the number of entries.
+ *
+ * Each leaf keeps the matching entries with the highest priority (by
+ * default the most specific, see config.c), in config order: a packet
+ * matching several entries with that priority goes to each (fan-out).
+ */
+
+#include "hal.h"
+#include "map.h"
+#include "map_tree.h"
+#include "device_open.h"
+
+#define MAP_CTAG_FIELDS 1          /* ctag trees match the ctag alone */
+
+/**********************************************************************/
+/* A) Build */
+/*********t************************************************************/
+/* Get the values of field f that entry h matches (field 0 of a ctag tree is the ctag) */
+static void map_bounds(halmap *h, int f, int is_ctag, uint32_t *lo, uint32_t *hi) {
+  if (is_ctag)             *lo = *hi = (uint32_t) h->from.ctag;
+  else if (h->from_ranges) {*lo = h->from_lo[f]; *hi = h->from_hi[f];}
+  else                     *lo = *hi = (f == 0) ? h->from.tag.mux : (f == 1) ? h->from.tag.sec : h->from.tag.typ;
+}
+
+static int map_cmp_u32(const void *a, const void *b) {
+  uint32_t x = *((const uint32_t *) a), y = *((const uint32_t *) b);
+  return ((x > y) - (x < y));
+}
+
+static void *map_alloc(size_t n) {
+  void *p = calloc(1, (n > 0) ? n : 1);
+
+  if (p == NULL) {
+    log_fatal("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  return (p);
+}
+
+/* Create leaf with the highest priority entries of r[0..nr) */
+static mleaf *mleaf_build(halmap **r, int nr, device *devs) {
+  mleaf *l = map_alloc(sizeof(mleaf));
+  int    top = r[0]->priority;
+
+  for (int i = 1; i < nr; i++) if (r[i]->priority > top) top = r[i]->priority;
+  l->h    = map_alloc(nr * sizeof(halmap *));
+  l->odev = map_alloc(nr * sizeof(device *));
+  for (int i = 0; i < nr; i++) {
+    if (r[i]->priority != top) continue;
+    l->h[l->n]    = r[i];
+    l->odev[l->n] = find_device_by_id(devs, r[i]->to.dev);
+    (l->n)++;
+  }
+  return (l);
+}
+
+/* Create node splitting field f (of nf) for the entries r[0..nr) in config order (NULL if none) */
+static void *mnode_build(halmap **r, int nr, int f, int nf, int is_ctag, device *devs) {
+  mnode     *m;
+  halmap   **sub, **prev, **swap;
+  uint32_t  *pts, lo, hi;
+  int        np = 0, nsub, nprev = -1;
+
+  if (nr == 0)  return (NULL);
+  if (f == nf)  return (mleaf_build(r, nr, devs));
+
+  /* Intervals start at 0 and at each entry's lo and hi + 1 */
+  pts = map_alloc((2 * nr + 1) * sizeof(uint32_t));
+  pts[np++] = 0;
+  for (int i = 0; i < nr; i++) {
+    map_bounds(r[i], f, is_ctag, &lo, &hi);
+    pts[np++] = lo;
+    if (hi < UINT32_MAX) pts[np++] = hi + 1;
+  }
+  qsort(pts, np, sizeof(uint32_t), map_cmp_u32);
+
+  m        = map_alloc(sizeof(mnode));
+  m->lo    = map_alloc(np * sizeof(uint32_t));
+  m->child = map_alloc(np * sizeof(void *));
+  sub      = map_alloc(nr * sizeof(halmap *));
+  prev     = map_alloc(nr * sizeof(halmap *));
+  for (int k = 0; k < np; k++) {
+    if ((k > 0) && (pts[k] == pts[k - 1])) continue;
+    nsub = 0;
+    for (int i = 0; i < nr; i++) {
+      map_bounds(r[i], f, is_ctag, &lo, &hi);
+      if ((lo <= pts[k]) && (pts[k] <= hi)) sub[nsub++] = r[i];
+    }
+    if ((nsub == nprev) && (memcmp(sub, prev, nsub * sizeof(halmap *)) == 0)) continue;   /* same entries as before */
+    m->lo[m->n]    = pts[k];
+    m->child[m->n] = mnode_build(sub, nsub, f + 1, nf, is_ctag, devs);
+    (m->n)++;
+    swap = prev; prev = sub; sub = swap;
+    nprev = nsub;
+  }
+  free(pts);
+  free(sub);
+  free(prev);
+  return (m);
+}
+
+/* Compile the HAL map entries from each enabled device into its decision tree */
+void map_tree_build(device *devs, halmap *map) {
+  halmap **tags, **ctags;
+  int      count = 0, nt, nc;
+
+  for (halmap *h = map; h != NULL; h = h->next) count++;
+  tags  = map_alloc(count * sizeof(halmap *));
+  ctags = map_alloc(count * sizeof(halmap *));
+  for (device *d = devs; d != NULL; d = d->next) {
+    if (d->enabled == 0) continue;
+    nt = nc = 0;
+    for (halmap *h = map; h != NULL; h = h->next) {
+      if (strcmp(h->from.dev, d->id) != 0) continue;
+      if (h->from.ctag < 0) {tags[nt++] = h; continue;}
+      for (int f = 0; (f < MAP_FIELDS) && (h->from_ranges); f++) {
+        if (h->from_lo[f] != h->from_hi[f]) {
+          log_fatal("HAL map entry from %s has a ctag, so cannot match a range of tags", d->id);
+          exit(EXIT_FAILURE);
+        }
+      }
+      ctags[nc++] = h;
+    }
+    d->map_tree = map_alloc(sizeof(mtree));
+    d->map_tree->tag  = mnode_build(tags,  nt, 0, MAP_FIELDS,      0, devs);
+    d->map_tree->ctag = mnode_build(ctags, nc, 0, MAP_CTAG_FIELDS, 1, devs);
+    log_trace("Device %s: compiled %d HAL map entries with tags and %d with ctags", d->id, nt, nc);
+  }
+  free(tags);
+  free(ctags);
+}
+
+/**********************************************************************/
+/* B) Lookup and free */
+/*********t************************************************************/
+/* Return the child of node m for the interval with value v */
+static inline void *mnode_child(mnode *m, uint32_t v) {
+  int a = 0, b = m->n - 1, c;
+
+  while (a < b) {
+    c = (a + b + 1) / 2;
+    if (m->lo[c] <= v) a = c;
+    else               b = c - 1;
+  }
+  return (m->child[a]);
+}
+
+/* Return the HAL map entries for PDU p from device idev, or NULL if none match */
+mleaf *map_tree_lookup(device *idev, pdu *p) {
+  void     *node;
+  uint32_t  key[MAP_FIELDS];
+  int       nf;
+
+  if (idev->map_tree == NULL) return (NULL);
+  if (p->psel.ctag >= 0) {
+    node   = idev->map_tree->ctag;
+    key[0] = (uint32_t) p->psel.ctag;
+    nf     = MAP_CTAG_FIELDS;
+  }
+  else {
+    node   = idev->map_tree->tag;
+    key[0] = p->psel.tag.mux;
+    key[1] = p->psel.tag.sec;
+    key[2] = p->psel.tag.typ;
+    nf     = MAP_FIELDS;
+  }
+  for (int f = 0; (f < nf) && (node != NULL); f++) node = mnode_child(node, key[f]);
+  return (node);
+}
+
+static void mnode_free(void *node, int f, int nf) {
+  mnode *m = node;
+  mleaf *l = node;
+
+  if (node == NULL) return;
+  if (f == nf) {
+    free(l->h);
+    free(l->odev);
+    free(l);
+    return;
+  }
+  for (int i = 0; i < m->n; i++) mnode_free(m->child[i], f + 1, nf);
+  free(m->lo);
+  free(m->child);
+  free(m);
+}
+
+void map_tree_free(device *devs) {
+  for (device *d = devs; d != NULL; d = d->next) {
+    if (d->map_tree == NULL) continue;
+    mnode_free(d->map_tree->tag,  0, MAP_FIELDS);
+    mnode_free(d->map_tree->ctag, 0, MAP_CTAG_FIELDS);
+    free(d->map_tree);
+    d->map_tree = NULL;
+  }
+}
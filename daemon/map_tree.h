@@ -0,0 +1,25 @@
+/* HAL map decision tree: per input device lookup of HAL map entries (see map_tree.c) */
+
+/* Node matching one tag field: value v is in interval i when lo[i] <= v < lo[i+1] (lo[0] = 0) */
+typedef struct _mnode {
+  int          n;
+  uint32_t    *lo;
+  void       **child;           /* of each interval: the next field's mnode, an mleaf (last field) or NULL (no entry) */
+} mnode;
+
+/* HAL map entries used for a packet (those matching it with the highest priority, in config order) */
+typedef struct _mleaf {
+  int          n;
+  halmap     **h;
+  device     **odev;            /* output device of each entry (NULL if not found) */
+} mleaf;
+
+/* HAL map entries from an input device, compiled into one tree for packets with tags and one with ctags */
+typedef struct _mtree {
+  mnode       *tag;
+  mnode       *ctag;
+} mtree;
+
+extern void   map_tree_build(device *, halmap *);
+extern void   map_tree_free(device *);
+extern mleaf *map_tree_lookup(device *, pdu *);
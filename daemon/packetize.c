@@ -5,6 +5,7 @@
 
 #include "hal.h"
 #include "packetize.h"
+#include "copy.h"
 
 /* Write packet into internal PDU */
 int pdu_from_packet(pdu *out, uint8_t *in, int len_in, device *idev) {
@@ -12,6 +13,9 @@ int pdu_from_packet(pdu *out, uint8_t *in, int len_in, device *idev) {
     
   out->psel.dev  = strdup(idev->id);
   out->psel.ctag = -1;
+  out->tstamp_in  = 0;          /* set by models with a linux_time field */
+  out->tstamp_out = 0;
+  out->payload    = NULL;
     log_trace("Packizer reads packet from %s of len=%d", idev->model, len_in);
 
     
@@ -25,8 +29,14 @@ int pdu_from_packet(pdu *out, uint8_t *in, int len_in, device *idev) {
   return (pdu_len);
 }
 
-/* Write packet from internal PDU into packet */
-void pdu_into_packet(uint8_t *out, pdu *in, int *pkt_len, selector *osel, const char *dev_model) {
+/* Payload ending an output packet (at dst): the model leaves it out, noting where it goes */
+void pdu_payload_tail(pdu *in, uint8_t *pkt, uint8_t *dst) {
+  in->payload_off = dst - pkt;
+}
+
+/* Write packet header from internal PDU (whole packet if in->payload_off < 0, else payload goes at payload_off) */
+void pdu_into_header(uint8_t *out, pdu *in, int *pkt_len, selector *osel, const char *dev_model) {
+  in->payload_off = -1;
   if      (strcmp(dev_model, "sdh_ha_v1") == 0)  *pkt_len = pdu_into_sdh_ha_v1 (out, in, &(osel->tag));
   else if (strcmp(dev_model, "sdh_socat_v1") == 0)  *pkt_len = pdu_into_sdh_ha_v1 (out, in, &(osel->tag));
   else if (strcmp(dev_model, "sdh_be_v1") == 0)  *pkt_len = pdu_into_sdh_be_v1 (out, in, &(osel->tag));
@@ -38,3 +48,9 @@ void pdu_into_packet(uint8_t *out, pdu *in, int *pkt_len, selector *osel, const
     exit(EXIT_FAILURE);
   }
 }
+
+/* Write packet from internal PDU into packet */
+void pdu_into_packet(uint8_t *out, pdu *in, int *pkt_len, selector *osel, const char *dev_model) {
+  pdu_into_header(out, in, pkt_len, osel, dev_model);
+  if ((*pkt_len > 0) && (in->payload_off >= 0)) copy_payload(out + in->payload_off, in->data, in->data_len);
+}
@@ -8,3 +8,5 @@
 
 extern int  pdu_from_packet(pdu *, uint8_t *, int, device *);
 extern void pdu_into_packet(uint8_t *, pdu *, int *, selector *, const char *);
+extern void pdu_into_header(uint8_t *, pdu *, int *, selector *, const char *);
+extern void pdu_payload_tail(pdu *, uint8_t *, uint8_t *);
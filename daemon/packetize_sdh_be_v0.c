@@ -6,6 +6,7 @@
  */
 
 #include "hal.h"
+#include "copy.h"
 #include "packetize_sdh_be_v0.h"
 //#include "../appgen/float.h"    /* no longer use uint64_t */
 
@@ -58,7 +59,7 @@ int pdu_into_sdh_be_v0 (uint8_t *out, pdu *in, gaps_tag *otag) {
     tlv = &(pkt->tlv[i]);
     tlv->data_tag = htonl(otag->typ);
     tlv->data_len = htonl(in->data_len);
-    memcpy((char *) tlv->data, (char *) in->data, in->data_len);
+    copy_payload(tlv->data, in->data, in->data_len);
   }
   /* XXX: Fix packet length to depend on message_tlv_count */
   return (sizeof(pkt->session_tag) + sizeof(pkt->message_tag) + sizeof(pkt->message_tlv_count) + sizeof(tlv->data_tag) + sizeof(tlv->data_len) + in->data_len);
@@ -7,8 +7,9 @@
  */
 
 #include "hal.h"
+#include "copy.h"
 #include "time.h"
-#include "packetize_sdh_be_v1.h"
+#include "packetize.h"       /* this model (and pdu_payload_tail) */
 #include "map.h"            /* get data_print */
 
 /* Print M1 Packet */
@@ -38,21 +39,22 @@ int get_packet_length_sdh_be_v1(pkt_sdh_be_v1 *pkt, int data_len) {
 }
 
 /* Put data from buf (using M1 model) into internal HAL PDU */
-int pdu_from_sdh_be_v1 (pdu *out, uint8_t *in, int len) {
+int pdu_from_sdh_be_v1 (pdu *out, uint8_t *in, int len_in) {
   pkt_sdh_be_v1  *pkt = (pkt_sdh_be_v1 *) in;
-  tlv_sdh_be_v1  *tlv;
+  tlv_sdh_be_v1  *tlv = &(pkt->tlv[0]);
     
   // fprintf(stderr, "HAL put packet (len = %d) into internal PDU: ", len); m1_print(pkt);
+  if (get_packet_length_sdh_be_v1(pkt, 0) > len_in)  return (PKT_INCOMPLETE);
+  if (ntohl(pkt->message_tlv_count) != 1)            return (PKT_INVALID);      /* (HAL sends one TLV) */
+  out->data_len = ntohl(tlv->data_len);
+  if (out->data_len > SDH_BE_V1_ADU_SIZE_MAX)        return (PKT_INVALID);
+  if (get_packet_length_sdh_be_v1(pkt, out->data_len) > len_in)  return (PKT_INCOMPLETE);
   out->psel.tag.mux = ntohl(pkt->session_tag);
   out->psel.tag.sec = ntohl(pkt->message_tag);
-//  fprintf(stderr, "YYYY: count=%d\n", ntohl(pkt->message_tlv_count));
-  for (int i=0; i < ntohl(pkt->message_tlv_count); i++) {
-    tlv = &(pkt->tlv[0]);
-    out->psel.tag.typ = ntohl(tlv->data_tag);
-    out->data_len = ntohl(tlv->data_len);
-//    memcpy (out->data, tlv->data, out->data_len);    /* TODO_PDU_PTR */
-    out->data = tlv->data;            /* TODO_PDU_PTR */
-  }
+  out->psel.tag.typ = ntohl(tlv->data_tag);
+//  memcpy (out->data, tlv->data, out->data_len);    /* TODO_PDU_PTR */
+  out->data = tlv->data;            /* TODO_PDU_PTR */
+  out->tstamp_in = linux_time_get(&(tlv->linux_time));
   return (get_packet_length_sdh_be_v1(pkt, out->data_len));
 }
 
@@ -72,9 +74,9 @@ int pdu_into_sdh_be_v1 (uint8_t *out, pdu *in, gaps_tag *otag) {
 //    tlv->gaps_time_us = htonl(0x89abcdef);  /* XXX: Just set for testing */
     tlv->gaps_time = 0;
     tlv->gaps_time_us = 0;
-    linux_time_set((uint64_t *) &(tlv->linux_time));
+    linux_time_put(&(tlv->linux_time), in->tstamp_out);     /* (0 unless output device sets tstamp) */
     tlv->data_len = htonl(in->data_len);
-    memcpy((char *) tlv->data, (char *) in->data, in->data_len);
+    pdu_payload_tail(in, out, tlv->data);
   }
 //  sdh_be_v1_print(pkt);
   return (get_packet_length_sdh_be_v1(pkt, in->data_len));
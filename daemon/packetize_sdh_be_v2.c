@@ -8,6 +8,7 @@
  */
 
 #include "hal.h"
+#include "copy.h"
 #include "time.h"
 #include "packetize_sdh_be_v2.h"
 #include "map.h"            /* get data_print */
@@ -47,14 +48,19 @@ int get_packet_length_sdh_be_v2(pkt_sdh_be_v2 *pkt, int data_len) {
 int pdu_from_sdh_be_v2 (pdu *out, uint8_t *in, int len_in) {
     pkt_sdh_be_v2  *pkt = (pkt_sdh_be_v2 *) in;
 
-    out->data_len     = check_len_sdh_be_v2(ntohl(pkt->imm_data_len));
-    if (get_packet_length_sdh_be_v2(pkt, 0) > len_in)  return (-1);
+    if (get_packet_length_sdh_be_v2(pkt, 0) > len_in)  return (PKT_INCOMPLETE);
+    out->data_len     = ntohl(pkt->imm_data_len);
+    if (out->data_len > SDH_BE_V2_ADU_SIZE_MAX) {
+      log_warn("Bad sdh_be_v2 packet: imm_data_len=%ld > %d", out->data_len, SDH_BE_V2_ADU_SIZE_MAX);
+      return (PKT_INVALID);
+    }
 //    fprintf(stderr, "%s: ", __func__); sdh_be_v2_print(pkt);
     out->psel.tag.mux = ntohl(pkt->session_tag);
     out->psel.tag.sec = ntohl(pkt->message_tag);
     out->psel.tag.typ = ntohl(pkt->data_tag);
 //    memcpy (out->data, pkt->imm_data, len);    /* TODO_PDU_PTR */
     out->data = pkt->imm_data;    /* TODO_PDU_PTR */
+    out->tstamp_in = linux_time_get(&(pkt->linux_time_lo));
 
     return (get_packet_length_sdh_be_v2(pkt, 0));
 }
@@ -75,15 +81,14 @@ int pdu_into_sdh_be_v2 (uint8_t *out, pdu *in, gaps_tag *otag) {
 //    log_error("HACK to test shd_be v2 with v1 ilip"); pkt->descriptor_type = htonl(1);
     
     pkt->imm_data_len = htonl(len);
-    memcpy((char *) pkt->imm_data, (char *) in->data, len);
+    copy_payload(pkt->imm_data, in->data, len);
     
     // Set by Driver or ILIP device - Reset just to recognize any changes
     pkt->gaps_time_lo       = 0;
     pkt->gaps_time_up       = 0;
     //    pkt->gaps_time = htonl(0x01234567);     /* XXX: Just set for testing */
     //    pkt->gaps_time_us = htonl(0x89abcdef);  /* XXX: Just set for testing */
-    pkt->linux_time_lo      = 0;
-    pkt->linux_time_up      = 0;
+    linux_time_put(&(pkt->linux_time_lo), in->tstamp_out);     /* (0 unless output device sets tstamp) */
     pkt->desc_sip_hash_lo   = 0;
     pkt->desc_sip_hash_up   = 0;
 //    sdh_be_v2_print(pkt);
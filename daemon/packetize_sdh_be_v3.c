@@ -7,7 +7,7 @@
 
 #include "hal.h"
 #include "time.h"
-#include "packetize_sdh_be_v3.h"
+#include "packetize.h"       /* this model (and pdu_payload_tail) */
 #include "map.h"            /* get data_print */
 
 /* Print external packet  */
@@ -41,8 +41,13 @@ int pdu_from_sdh_be_v3 (pdu *out, uint8_t *in, int len_in) {
     uint8_t        *data_in;
 
 //    fprintf(stderr, "%s: ", __func__); sdh_be_v3_print(pkt);
+    if (get_packet_length_sdh_be_v3(pkt, 0) > len_in)  return (PKT_INCOMPLETE);
     out->data_len     = ntohl(pkt->dma_data_len);
-    if (get_packet_length_sdh_be_v3(pkt, 0) > len_in)  return (-1);  /* incomplete packet */
+    if ((ntohl(pkt->imm_data_len) > SDH_BE_V3_ADU_SIZE_MAX) || (out->data_len > ADU_SIZE_MAX_C)) {
+      log_warn("Bad sdh_be_v3 packet: imm_data_len=%u (max %d) dma_data_len=%ld (max %d)", ntohl(pkt->imm_data_len), SDH_BE_V3_ADU_SIZE_MAX, out->data_len, ADU_SIZE_MAX_C);
+      return (PKT_INVALID);
+    }
+    if (get_packet_length_sdh_be_v3(pkt, out->data_len) > len_in)  return (PKT_INCOMPLETE);   /* descriptor, then its payload */
   
     out->psel.tag.mux = ntohl(pkt->session_tag);
     out->psel.tag.sec = ntohl(pkt->message_tag);
@@ -51,6 +56,7 @@ int pdu_from_sdh_be_v3 (pdu *out, uint8_t *in, int len_in) {
     data_in = (uint8_t *) pkt + sizeof(*pkt);
 //   memcpy (out->data, data_in, out->data_len);    /* TODO_PDU_PTR */
     out->data = data_in;    /* TODO_PDU_PTR */
+    out->tstamp_in = linux_time_get(&(pkt->linux_time_lo));
   return (get_packet_length_sdh_be_v3(pkt, out->data_len));
 }
 
@@ -77,8 +83,7 @@ int pdu_into_sdh_be_v3 (uint8_t *out, pdu *in, gaps_tag *otag) {
 //    pkt->gaps_time_up = htonl(0x89abcdef);  /* XXX: Just set for testing */
     pkt->gaps_time_lo       = 0;
     pkt->gaps_time_up       = 0;
-    pkt->linux_time_lo      = 0;
-    pkt->linux_time_up      = 0;
+    linux_time_put(&(pkt->linux_time_lo), in->tstamp_out);     /* (0 unless output device sets tstamp) */
     
 
     /* c1) Immediate data: can be copied into packet, but disable for now */
@@ -87,6 +92,7 @@ int pdu_into_sdh_be_v3 (uint8_t *out, pdu *in, gaps_tag *otag) {
     /* c2) Payload data: ILIP driver uses DMA to get data stored in PDU */
     pkt->dma_data_len       = htonl(in->data_len);
     pkt->dma_data_addr_lo   = (uint64_t) in->data;
+    pdu_payload_tail(in, out, out + sizeof(*pkt));      /* payload follows descriptor */
   
 //  log_buf_trace((char *) __func__, (char *) out, sizeof(*pkt) + in->data_len);
 //  data_print("Data",  (uint8_t *) pkt->dma_data_addr_lo, in->data_len);
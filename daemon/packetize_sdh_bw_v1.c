@@ -8,8 +8,9 @@
 /* Convert between Internal HAL PDU and sdh_bw_v1 packets */
 
 #include "hal.h"
+#include "copy.h"
 #include "crc.h"
-#include "packetize_sdh_bw_v1.h"
+#include "packetize.h"       /* this model (and pdu_payload_tail) */
 #include "map.h"            /* get data_print */
 
 /* Print Packet */
@@ -35,8 +36,9 @@ int get_packet_length_sdh_bw_v1(sdh_bw_v1 *pkt, size_t data_len) {
 int pdu_from_sdh_bw_v1 (pdu *out, uint8_t *in, int len_in) {
   sdh_bw_v1    *pkt = (sdh_bw_v1 *) in;
 
+  if (get_packet_length_sdh_bw_v1(pkt, 0) > len_in)  return (PKT_INCOMPLETE);
   out->data_len     = ntohs(pkt->data_len);
-  if (get_packet_length_sdh_bw_v1(pkt, out->data_len) > len_in)  return (-1);
+  if (get_packet_length_sdh_bw_v1(pkt, out->data_len) > len_in)  return (PKT_INCOMPLETE);
   
   out->psel.ctag = ntohl(pkt->message_tag_ID);
 // fprintf(stderr, "%s: ctag=%06x crc: in=%02x recalc=%02x\n", __func__, out->psel.ctag, ntohs(pkt->crc16), sdh_bw_v1_crc_calc(pkt));
@@ -54,6 +56,6 @@ int pdu_into_sdh_bw_v1 (uint8_t *out, pdu *in, uint32_t ctag) {
   pkt->message_tag_ID = htonl(ctag);
   pkt->data_len = htons(len);
   pkt->crc16 = htons(sdh_bw_v1_crc_calc(pkt));
-  memcpy((char *) pkt->data, (char *) in->data, in->data_len);
+  pdu_payload_tail(in, out, pkt->data);
   return (get_packet_length_sdh_bw_v1(pkt, in->data_len));
 }
@@ -4,7 +4,8 @@
  */
 
 #include "hal.h"
-#include "packetize_sdh_ha_v1.h"
+#include "copy.h"
+#include "packetize.h"       /* this model (and pdu_payload_tail) */
 #include "map.h"            /* get data_print */
 
 /* Print M1 Packet */
@@ -26,9 +27,11 @@ int get_packet_length_sdh_ha_v1(sdh_ha_v1  *pkt, size_t data_len) {
 int pdu_from_sdh_ha_v1 (pdu *out, uint8_t *in, int len_in) {
   sdh_ha_v1  *pkt = (sdh_ha_v1 *) in;
   
+  if (get_packet_length_sdh_ha_v1(pkt, 0) > len_in)  return (PKT_INCOMPLETE);
   tag_decode(&(out->psel.tag), &(pkt->tag));
   len_decode(&(out->data_len), pkt->data_len);
-  if (get_packet_length_sdh_ha_v1(pkt, out->data_len) > len_in)  return (-1);   /* incomplete packet */
+  if (out->data_len > ADU_SIZE_MAX_C) return (PKT_INVALID);
+  if (get_packet_length_sdh_ha_v1(pkt, out->data_len) > len_in)  return (PKT_INCOMPLETE);
   out->data = pkt->data;
   return (get_packet_length_sdh_ha_v1(pkt, out->data_len));
 }
@@ -39,6 +42,6 @@ int pdu_into_sdh_ha_v1 (uint8_t *out, pdu *in, gaps_tag *otag) {
 
   tag_encode(&(pkt->tag), otag);
   len_encode(&(pkt->data_len), in->data_len);
-  memcpy(pkt->data, in->data, in->data_len);
+  pdu_payload_tail(in, out, pkt->data);
   return (get_packet_length_sdh_ha_v1(pkt, in->data_len));
 }
@@ -0,0 +1,50 @@
+/*
+ * HAL payload pool
+ *   October 2026, Peraton Labs
+ *
+ * A PDU's payload points into its input buffer. Outputs that need the
+ * packet in one buffer (all but socket outputs, which gather header and
+ * payload) share one copy of the payload in a pool buffer: the first copies
+ * it after PACKET_HEADER_MAX bytes of headroom, then each output writes its
+ * own header just before it. Outputs write synchronously, so the PDU owns
+ * the buffer, which pdu_delete puts back in the pool. The pool is used by
+ * one thread (the instance's routing loop), so needs no locks.
+ */
+
+#include "hal.h"
+#include "pool.h"
+
+/* Get a buffer from the pool, allocating one if none is free */
+pbuf *pool_get(hal_ctx *ctx) {
+  pbuf *b = ctx->pool_free;
+
+  if (b != NULL) ctx->pool_free = b->next;
+  else {
+    if (((b = malloc(sizeof(pbuf))) == NULL) || ((b->buf = aligned_alloc(DATA_ALIGNMENT, PACKET_MAX)) == NULL)) {
+      log_fatal("Cannot allocate HAL payload buffer (%d bytes)", PACKET_MAX);
+      exit(EXIT_FAILURE);
+    }
+    ctx->pool_count++;
+    log_debug("HAL payload pool has %d buffer(s)", ctx->pool_count);
+  }
+  b->next = NULL;
+  return (b);
+}
+
+/* Return a buffer to the pool */
+void pbuf_put(hal_ctx *ctx, pbuf *b) {
+  b->next = ctx->pool_free;
+  ctx->pool_free = b;
+}
+
+/* Free the pool's buffers (all must have been put) */
+void pool_free(hal_ctx *ctx) {
+  pbuf *b;
+
+  while ((b = ctx->pool_free) != NULL) {
+    ctx->pool_free = b->next;
+    free(b->buf);
+    free(b);
+  }
+  ctx->pool_count = 0;
+}
@@ -0,0 +1,10 @@
+/* HAL payload pool: packet buffers reused across PDUs, so the outputs of a fan-out share one payload copy */
+
+typedef struct _pbuf {
+  uint8_t       *buf;           /* PACKET_MAX bytes (DATA_ALIGNMENT aligned): payload at PACKET_HEADER_MAX */
+  struct _pbuf  *next;          /* next free buffer */
+} pbuf;
+
+extern pbuf *pool_get(hal_ctx *ctx);
+extern void  pbuf_put(hal_ctx *ctx, pbuf *b);
+extern void  pool_free(hal_ctx *ctx);
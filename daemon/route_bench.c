@@ -0,0 +1,238 @@
+/*
+ * HAL routing microbenchmark: drives route_packets (and each of its
+ * stages: parse, halmap lookup and encode) with prebuilt input buffers
+ * for every packet model, from empty to maximum size payloads.
+ *   October 2026, Peraton Labs
+ *
+ * Usage: make bench; ./route_bench -h
+ *
+ * Output device writes go to /dev/null, so the 'route' column includes
+ * one write syscall per packet (unless -p routes to an inproc device,
+ * whose receiver is a function call).  sdh_be_v3 output packets carry the
+ * payload after the DMA descriptor, like the other models, so their GB/s
+ * includes writing (or copying) it.
+ * The 'find' column times the HAL map decision tree lookup, so it should
+ * not grow with the number of HAL map entries (-e).
+ */
+
+#include "hal.h"
+#include "hal_ctx.h"
+#include "map.h"
+#include "map_tree.h"
+#include "device_read_write.h"
+#include "packetize.h"
+#include "copy.h"
+#include <time.h>
+
+#define BENCH_BYTES_DEFAULT   0x10000000   /* payload bytes per test (256 MB) */
+#define BENCH_PKTS_MIN        1000
+#define BENCH_PKTS_MAX        1000000
+#define BENCH_MAP_EXTRA       16           /* non-matching halmap entries ahead of match */
+
+typedef struct _bench_model {
+  const char *model;
+  size_t      adu_max;                     /* largest payload the model can carry */
+} bench_model;
+
+static bench_model bench_models[] = {
+  {"sdh_ha_v1", ADU_SIZE_MAX_C},
+  {"sdh_bw_v1", PKT_G1_ADU_SIZE_MAX},
+  {"sdh_be_v1", SDH_BE_V1_ADU_SIZE_MAX},
+  {"sdh_be_v2", SDH_BE_V2_ADU_SIZE_MAX},
+  {"sdh_be_v3", ADU_SIZE_MAX_C},
+};
+static size_t bench_sizes[] = {0, 16, 64, 200, 1000, 4096, 65536, 262144, ADU_SIZE_MAX_C};
+
+#define ARRAY_LEN(a)  ((int) (sizeof(a) / sizeof(a[0])))
+
+/**********************************************************************/
+/* A) Synthetic devices and HAL map */
+/*********t************************************************************/
+/* Receiver (hal_inproc_fn) of packets written to the inproc output device: count their bytes */
+static void bench_inproc_recv(void *arg, uint8_t *pkt, int pkt_len) {
+  (void) pkt;                   /* contents not needed */
+  *((size_t *) arg) += pkt_len;
+}
+
+/* Initialize a device (as config.c does) with only what routing needs */
+static void bench_dev_init(device *d, const char *id, const char *model, const char *comms, int write_fd, device *next) {
+  memset(d, 0, sizeof(*d));
+  d->enabled   = 1;
+  d->id        = id;
+  d->model     = model;
+  d->comms     = comms;
+  d->listen_fd = -1;
+  d->read_fd   = -1;
+  d->write_fd  = write_fd;
+  d->pid_in    = -1;
+  d->pid_out   = -1;
+  d->tcp_conn  = -1;
+  d->tstamp_clock = -1;
+  d->next      = next;
+}
+
+static void bench_sel_init(selector *s, const char *dev, uint32_t mux, uint32_t sec, uint32_t typ, int use_ctag) {
+  s->dev = dev;
+  tag_write(&(s->tag), mux, sec, typ);
+  s->ctag = (use_ctag) ? tag_to_ctag(&(s->tag)) : -1;
+}
+
+/* Build map of 'extra' non-matching entries from bin, then bin <1,1,1> -> bout <2,2,1> */
+static halmap *bench_map_init(int extra, int use_ctag) {
+  halmap *map = calloc(extra + 1, sizeof(halmap));
+
+  for (int i = 0; i <= extra; i++) {
+    if (i < extra) bench_sel_init(&(map[i].from), "bin", 1, 2 + i / 100, 100 + i % 100, use_ctag);   /* (distinct ctags) */
+    else           bench_sel_init(&(map[i].from), "bin", 1, 1, 1,       use_ctag);
+    bench_sel_init(&(map[i].to), "bout", 2, 2, 1, use_ctag);
+    map[i].codec = "NULL";
+    map[i].next  = (i < extra) ? &(map[i+1]) : NULL;
+  }
+  return (map);
+}
+
+/**********************************************************************/
+/* B) Timed runs */
+/*********t************************************************************/
+static double bench_now_ns(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (t.tv_sec * 1e9 + t.tv_nsec);
+}
+
+/* Build one input packet of the device model, carrying 'len' payload bytes */
+static int bench_packet_build(uint8_t *buf, device *idev, halmap *h, uint8_t *adu, size_t len) {
+  pdu  p;
+  int  pkt_len = 0;
+
+  p.psel     = h->from;
+  p.data     = adu;
+  p.data_len = len;
+  p.tstamp_out = 0;
+  pdu_into_packet(buf, &p, &pkt_len, &(h->from), idev->model);    /* (v3 payload follows its descriptor) */
+  return (pkt_len);
+}
+
+/* Time each routing stage for one model and payload size, then print a result row */
+static void bench_run(bench_model *bm, size_t len, int npkts_fixed, int extra, uint8_t *in, uint8_t *out, uint8_t *adu, int fd_null, int inproc) {
+  device   idev, odev;
+  halmap  *map, *h = NULL;
+  mleaf   *leaf = NULL;
+  hal_ctx *ctx;
+  pdu      p;
+  int      pkt_len, out_len = 0, npkts;
+  size_t   inproc_bytes = 0;
+  double   t0, t_parse, t_find, t_encode, t_route;
+
+  bench_dev_init(&odev, "bout", bm->model, (inproc) ? "inproc" : "ipc", (inproc) ? -1 : fd_null, NULL);
+  bench_dev_init(&idev, "bin",  bm->model, "ipc", -1, &odev);
+  map = bench_map_init(extra, strcmp(bm->model, "sdh_bw_v1") == 0);
+  ctx = hal_ctx_new(&idev, map, 0);
+  if (inproc) hal_inproc_set(ctx, "bout", bench_inproc_recv, &inproc_bytes);
+  for (h = map; h->next != NULL; h = h->next) ;
+  pkt_len = bench_packet_build(in, &idev, h, adu, len);
+  if (pkt_len <= 0) {               /* e.g., sdh_be_v2 rejects empty payloads */
+    printf("%-10s %8lu (model cannot carry this payload)\n", bm->model, len);
+    hal_ctx_free(ctx);
+    free(map);
+    return;
+  }
+
+  npkts = npkts_fixed;
+  if (npkts <= 0) {
+    npkts = (len > 0) ? (BENCH_BYTES_DEFAULT / len) : BENCH_PKTS_MAX;
+    if (npkts < BENCH_PKTS_MIN) npkts = BENCH_PKTS_MIN;
+    if (npkts > BENCH_PKTS_MAX) npkts = BENCH_PKTS_MAX;
+  }
+
+  t0 = bench_now_ns();
+  for (int i = 0; i < npkts; i++) {
+    pdu_from_packet(&p, in, pkt_len, &idev);
+    free((char *) p.psel.dev);
+  }
+  t_parse = (bench_now_ns() - t0) / npkts;
+
+  pdu_from_packet(&p, in, pkt_len, &idev);
+  t0 = bench_now_ns();
+  for (int i = 0; i < npkts; i++) leaf = map_tree_lookup(&idev, &p);
+  t_find = (bench_now_ns() - t0) / npkts;
+  h = leaf->h[0];
+
+  t0 = bench_now_ns();
+  for (int i = 0; i < npkts; i++) pdu_into_packet(out, &p, &out_len, &(h->to), odev.model);
+  t_encode = (bench_now_ns() - t0) / npkts;
+  free((char *) p.psel.dev);
+
+  t0 = bench_now_ns();
+  for (int i = 0; i < npkts; i++) route_packets(ctx, in, pkt_len, &idev);
+  t_route = (bench_now_ns() - t0) / npkts;
+
+  printf("%-10s %8lu %8d %9.1f %9.1f %9.1f %9.1f %8.3f %8.3f\n", bm->model, len, npkts,
+         t_parse, t_find, t_encode, t_route, len / t_encode, len / t_route);
+  if (odev.count_w != npkts) log_warn("%s wrote %d of %d packets", bm->model, odev.count_w, npkts);
+  hal_ctx_free(ctx);
+  free(map);
+}
+
+/**********************************************************************/
+/* C) Options and main */
+/*********t************************************************************/
+static void opts_print(void) {
+  printf("Microbenchmark of HAL route_packets for each packet model and payload size\n");
+  printf("Usage: route_bench [OPTIONS]...\n");
+  printf("OPTIONS: are one of the following:\n");
+  printf(" -c : do not calibrate the payload copy engine (use glibc memcpy)\n");
+  printf(" -e : number of non-matching HAL map entries ahead of the match (default = %d)\n", BENCH_MAP_EXTRA);
+  printf(" -h : print this message\n");
+  printf(" -m : only run this packet model (e.g., sdh_ha_v1)\n");
+  printf(" -n : packets per test (default = enough for %d MB of payload, within [%d, %d])\n", BENCH_BYTES_DEFAULT >> 20, BENCH_PKTS_MIN, BENCH_PKTS_MAX);
+  printf(" -p : route to an in-process (inproc) device instead of writing to /dev/null\n");
+}
+
+int main(int argc, char **argv) {
+  int      opt, npkts = 0, extra = BENCH_MAP_EXTRA, calibrate = 1, inproc = 0, fd_null;
+  char    *model = NULL;
+  uint8_t *in, *out, *adu;
+  size_t   buf_len = ADU_SIZE_MAX_C + 1024;
+
+  while ((opt = getopt(argc, argv, "ce:hm:n:p")) != EOF) {
+    switch (opt) {
+      case 'c': calibrate = 0;             break;
+      case 'e': extra = atoi(optarg);      break;
+      case 'm': model = optarg;            break;
+      case 'n': npkts = atoi(optarg);      break;
+      case 'p': inproc = 1;                break;
+      case 'h': opts_print(); exit(0);
+      default:  opts_print(); exit(EXIT_FAILURE);
+    }
+  }
+
+  xdc_log_level(LOG_WARN);
+  copy_init(calibrate);
+  fd_null = open("/dev/null", O_WRONLY);
+  in  = aligned_alloc(64, buf_len);
+  out = aligned_alloc(64, buf_len);
+  adu = aligned_alloc(64, buf_len);
+  if ((fd_null < 0) || (in == NULL) || (out == NULL) || (adu == NULL)) {
+    log_fatal("%s: cannot open /dev/null or allocate buffers", __func__);
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < buf_len; i++) adu[i] = (uint8_t) i;
+  memset(in, 0, buf_len);
+  memset(out, 0, buf_len);
+
+  printf("%-10s %8s %8s %9s %9s %9s %9s %8s %8s\n", "model", "bytes", "packets",
+         "parse-ns", "find-ns", "encode-ns", "route-ns", "enc-GB/s", "rte-GB/s");
+  for (int m = 0; m < ARRAY_LEN(bench_models); m++) {
+    if ((model != NULL) && (strcmp(model, bench_models[m].model) != 0)) continue;
+    for (int s = 0; s < ARRAY_LEN(bench_sizes); s++) {
+      if (bench_sizes[s] > bench_models[m].adu_max) continue;
+      bench_run(&bench_models[m], bench_sizes[s], npkts, extra, in, out, adu, fd_null, inproc);
+    }
+  }
+  close(fd_null);
+  free(in);
+  free(out);
+  free(adu);
+  return (0);
+}
@@ -0,0 +1,94 @@
+/*
+ * HAL per-flow latency statistics
+ *   October 2026, Peraton Labs
+ *
+ * Each HAL map entry (flow) gets, on its first packet, two log-linear
+ * histograms: in-HAL latency (always) and one-way latency from the
+ * sender's packet timestamp (when its input device sets tstamp). Adding
+ * a sample is a few instructions, so statistics are always on.
+ */
+
+#include "hal.h"
+#include "stats.h"
+
+/**********************************************************************/
+/* A) Histograms */
+/*********t************************************************************/
+/* Bucket of value v: exact below 2^STATS_SUB_BITS, then 2^STATS_SUB_BITS buckets per power of 2 */
+static inline int stats_bucket(uint64_t v) {
+  int msb;
+
+  if (v < (1u << STATS_SUB_BITS)) return ((int) v);
+  msb = 63 - __builtin_clzll(v);
+  return (((msb - STATS_SUB_BITS + 1) << STATS_SUB_BITS) | ((v >> (msb - STATS_SUB_BITS)) & ((1u << STATS_SUB_BITS) - 1)));
+}
+
+/* Largest value in bucket b */
+static uint64_t stats_bucket_max(int b) {
+  int       msb;
+  uint64_t  lo;
+
+  if (b < (1 << STATS_SUB_BITS)) return ((uint64_t) b);
+  msb = (b >> STATS_SUB_BITS) + STATS_SUB_BITS - 1;
+  lo  = (1ULL << msb) | ((uint64_t) (b & ((1 << STATS_SUB_BITS) - 1)) << (msb - STATS_SUB_BITS));
+  return (lo + (1ULL << (msb - STATS_SUB_BITS)) - 1);
+}
+
+void stats_add(stats_hist *s, int64_t ns) {
+  uint64_t v = (ns < 0) ? 0 : (uint64_t) ns;     /* (e.g., unsynchronized clocks) */
+
+  s->count++;
+  s->sum_ns += v;
+  if (v > s->max_ns) s->max_ns = v;
+  s->bucket[stats_bucket(v)]++;
+}
+
+/* Value (ns) at quantile q (0-1): the top of its bucket (at most the maximum seen) */
+uint64_t stats_percentile(stats_hist *s, double q) {
+  uint64_t  need = (uint64_t) (q * s->count + 0.5), sum = 0, v;
+
+  if (need < 1) need = 1;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    if ((sum += s->bucket[b]) >= need) {
+      v = stats_bucket_max(b);
+      return ((v < s->max_ns) ? v : s->max_ns);
+    }
+  }
+  return (s->max_ns);
+}
+
+/**********************************************************************/
+/* B) Flows */
+/*********t************************************************************/
+/* Get the flow's statistics (allocated on first use) */
+stats_flow *stats_flow_get(halmap *h) {
+  if ((h->stats == NULL) && ((h->stats = calloc(1, sizeof(stats_flow))) == NULL)) {
+    log_fatal("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  return (h->stats);
+}
+
+static void stats_hist_print(FILE *fp, const char *name, stats_hist *s) {
+  if (s->count == 0) return;
+  fprintf(fp, "  %-7s n=%lu avg=%lu p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu ns\n", name, s->count, s->sum_ns / s->count,
+          stats_percentile(s, 0.5), stats_percentile(s, 0.9), stats_percentile(s, 0.99), stats_percentile(s, 0.999), s->max_ns);
+}
+
+/* Print latency of each flow with packets */
+void stats_print(halmap *map, FILE *fp) {
+  for (halmap *h = map; h != NULL; h = h->next) {
+    if ((h->stats == NULL) || (h->stats->hal.count == 0)) continue;
+    fprintf(fp, "Flow %s <%u,%u,%u> -> %s <%u,%u,%u> latency:\n", h->from.dev, h->from.tag.mux, h->from.tag.sec, h->from.tag.typ,
+            h->to.dev, h->to.tag.mux, h->to.tag.sec, h->to.tag.typ);
+    stats_hist_print(fp, "in-HAL",  &(h->stats->hal));
+    stats_hist_print(fp, "one-way", &(h->stats->oneway));
+  }
+}
+
+void stats_free(halmap *map) {
+  for (halmap *h = map; h != NULL; h = h->next) {
+    free(h->stats);
+    h->stats = NULL;
+  }
+}
@@ -0,0 +1,22 @@
+/* HAL per-flow (HAL map entry) latency histograms */
+
+#define STATS_SUB_BITS  2                       /* 4 buckets per power of 2 (each at most 25% wide) */
+#define STATS_BUCKETS   (64 << STATS_SUB_BITS)
+
+typedef struct _stats_hist {
+  uint64_t  count;
+  uint64_t  sum_ns;
+  uint64_t  max_ns;
+  uint32_t  bucket[STATS_BUCKETS];
+} stats_hist;
+
+typedef struct _stats_flow {
+  stats_hist  hal;        /* in-HAL latency: from routing input (just read) to output written */
+  stats_hist  oneway;     /* one-way latency: from sender's timestamp to routing input (if tstamp set on input device) */
+} stats_flow;
+
+extern stats_flow *stats_flow_get(halmap *h);
+extern void        stats_add(stats_hist *s, int64_t ns);
+extern uint64_t    stats_percentile(stats_hist *s, double q);
+extern void        stats_print(halmap *map, FILE *fp);
+extern void        stats_free(halmap *map);
@@ -0,0 +1,285 @@
+/*
+ * HAL TCP transport
+ *   October 2026, Peraton Labs
+ *
+ * A TCP device can have a server (addr_in/port_in) and/or a client
+ * (addr_out/port_out) side, all handled in the HAL poll loop (no threads):
+ *   - The listener stays open: a new connection replaces the current one
+ *     (e.g., after the peer restarts), and a closed one is re-accepted.
+ *   - The client connects without blocking, then reconnects after any
+ *     failure or disconnect, waiting TCP_RECONNECT_MIN_MS, doubling up to
+ *     TCP_RECONNECT_MAX_MS.
+ *   - Connections use TCP_NODELAY (unless tcp_nodelay = 0). With
+ *     tcp_cork_us > 0 they use TCP_CORK, so small packets written within
+ *     tcp_cork_us (or until tcp_cork_bytes are waiting) share segments.
+ *   - Connections are non-blocking, so a slow peer cannot stall the loop:
+ *     bytes the socket does not take (from EAGAIN or a partial write) wait
+ *     in a per-device queue (up to TCP_TXQ_BYTES), sent when poll finds the
+ *     socket writable. Packets that do not fit are dropped.
+ */
+
+#include "hal.h"
+#include "tcp.h"
+#include "time.h"
+#include <netinet/tcp.h>
+
+/**********************************************************************/
+/* A) Socket options */
+/*********t************************************************************/
+static void tcp_set_opt(device *d, int fd, int level, int opt, int val, const char *name) {
+  if (setsockopt(fd, level, opt, &val, sizeof(val)) < 0) {
+    log_warn("TCP device %s cannot set %s=%d (fd=%d): %s", d->id, name, val, fd, strerror(errno));
+  }
+}
+
+static void tcp_set_blocking(int fd, int blocking) {
+  int flags = fcntl(fd, F_GETFL);
+  fcntl(fd, F_SETFL, (blocking) ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK));
+}
+
+/* Set unset (-1) TCP options from the config file to their defaults */
+void tcp_config_defaults(device *d) {
+  if (d->tcp_nodelay    <  0) d->tcp_nodelay    = 1;
+  if (d->tcp_cork_us    <  0) d->tcp_cork_us    = 0;
+  if (d->tcp_cork_bytes <= 0) d->tcp_cork_bytes = TCP_CORK_BYTES_DEFAULT;
+  d->tcp_state      = TCP_STATE_CLOSED;
+  d->tcp_backoff_ms = TCP_RECONNECT_MIN_MS;
+  d->tcp_retry_ns   = 0;
+  d->rx_stream      = 1;
+}
+
+/* Configure a new connection: non-blocking (writes may queue), then the device's options */
+static void tcp_conn_init(device *d, int fd) {
+  tcp_set_blocking(fd, 0);
+  tcp_set_opt(d, fd, IPPROTO_TCP, TCP_NODELAY,  d->tcp_nodelay, "TCP_NODELAY");
+  tcp_set_opt(d, fd, SOL_SOCKET,  SO_KEEPALIVE, 1,              "SO_KEEPALIVE");
+  if (d->tcp_cork_us > 0) tcp_set_opt(d, fd, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK");
+}
+
+/* Send the coalesced (corked) writes now */
+static void tcp_uncork(device *d) {
+  tcp_set_opt(d, d->write_fd, IPPROTO_TCP, TCP_CORK, 0, "TCP_CORK");
+  tcp_set_opt(d, d->write_fd, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK");
+  d->cork_len         = 0;
+  d->cork_deadline_ns = 0;
+}
+
+/**********************************************************************/
+/* B) Server: listen and accept */
+/*********t************************************************************/
+void tcp_listen_start(device *d) {
+  if (listen(d->listen_fd, TCP_LISTEN_BACKLOG) < 0) {
+    log_fatal("TCP listen failed on %s (fd=%d): %s", d->id, d->listen_fd, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  tcp_set_blocking(d->listen_fd, 0);
+  log_trace("Device %s listening (fd=%d) for connection requests on TCP port %d", d->id, d->listen_fd, ntohs(d->socaddr_in.sin_port));
+}
+
+/* Accept a connection (replacing any current one, whose peer may have restarted) */
+void tcp_accept(hal_ctx *ctx, device *d) {
+  struct sockaddr_in  cli_addr;
+  socklen_t           len = sizeof(cli_addr);
+  int                 fd;
+
+  if ((fd = accept(d->listen_fd, (struct sockaddr *) &cli_addr, &len)) < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != ECONNABORTED)) {
+      log_warn("TCP accept failed on %s: %s", d->id, strerror(errno));
+    }
+    return;
+  }
+  if (d->read_fd != -1) tcp_disconnect(ctx, d, d->read_fd, "replaced by new connection");
+  tcp_conn_init(d, fd);
+  d->read_fd      = fd;
+  d->rx_carry_len = 0;
+  if (d->tcp_conn != 1) {           /* no client side, so also write to the accepted connection */
+    d->write_fd  = fd;
+    d->tcp_state = TCP_STATE_CONNECTED;
+  }
+  ctx->poll_dirty = 1;
+  log_info("TCP device %s accepted connection (fd=%d) from %s:%d", d->id, fd, inet_ntoa(cli_addr.sin_addr), ntohs(cli_addr.sin_port));
+}
+
+/**********************************************************************/
+/* C) Client: connect and reconnect */
+/*********t************************************************************/
+static void tcp_connected(hal_ctx *ctx, device *d) {
+  tcp_conn_init(d, d->write_fd);
+  d->tcp_state      = TCP_STATE_CONNECTED;
+  d->tcp_backoff_ms = TCP_RECONNECT_MIN_MS;
+  if (d->listen_fd == -1) {         /* no server side, so also read from the connection */
+    d->read_fd      = d->write_fd;
+    d->rx_carry_len = 0;
+  }
+  ctx->poll_dirty = 1;
+  log_info("TCP device %s connected (fd=%d) to %s:%d", d->id, d->write_fd, inet_ntoa(d->socaddr_out.sin_addr), ntohs(d->socaddr_out.sin_port));
+}
+
+/* Start a non-blocking connect (completed by tcp_connect_done when poll finds the socket writable) */
+void tcp_connect_start(hal_ctx *ctx, device *d) {
+  if (d->write_fd == -1) d->write_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (d->write_fd == -1) {
+    log_error("TCP socket creation failed for %s: %s", d->id, strerror(errno));
+    d->tcp_retry_ns = time_mono_ns() + d->tcp_backoff_ms * 1000000ULL;
+    return;
+  }
+  tcp_set_blocking(d->write_fd, 0);
+  d->tcp_state    = TCP_STATE_CONNECTING;
+  ctx->poll_dirty = 1;
+  if (connect(d->write_fd, (struct sockaddr *) &(d->socaddr_out), sizeof(d->socaddr_out)) == 0) tcp_connected(ctx, d);
+  else if (errno != EINPROGRESS) tcp_disconnect(ctx, d, d->write_fd, strerror(errno));
+}
+
+void tcp_connect_done(hal_ctx *ctx, device *d) {
+  int        err = 0;
+  socklen_t  len = sizeof(err);
+
+  if (getsockopt(d->write_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) err = errno;
+  if (err == 0) tcp_connected(ctx, d);
+  else          tcp_disconnect(ctx, d, d->write_fd, strerror(err));
+}
+
+/* Close one of the device's connections (fd); a client then reconnects after its backoff */
+void tcp_disconnect(hal_ctx *ctx, device *d, int fd, const char *why) {
+  if (d->tcp_state == TCP_STATE_CONNECTING) log_debug("TCP device %s connect failed (retry in %d ms): %s", d->id, d->tcp_backoff_ms, why);
+  else                                      log_warn("TCP device %s connection (fd=%d) closed: %s", d->id, fd, why);
+  close(fd);
+  if (fd == d->read_fd) {
+    d->read_fd      = -1;
+    d->rx_carry_len = 0;
+  }
+  if (fd == d->write_fd) {
+    d->write_fd         = -1;
+    d->tcp_state        = TCP_STATE_CLOSED;
+    d->cork_len         = 0;
+    d->cork_deadline_ns = 0;
+    d->txq_off          = 0;        /* a new connection starts at a packet boundary */
+    d->txq_len          = 0;
+    if (d->tcp_conn == 1) {
+      d->tcp_retry_ns   = time_mono_ns() + d->tcp_backoff_ms * 1000000ULL;
+      d->tcp_backoff_ms = (2 * d->tcp_backoff_ms > TCP_RECONNECT_MAX_MS) ? TCP_RECONNECT_MAX_MS : 2 * d->tcp_backoff_ms;
+    }
+  }
+  ctx->poll_dirty = 1;
+}
+
+/* Return 1 if every TCP client is connected and every TCP server has accepted a connection */
+int tcp_all_connected(hal_ctx *ctx) {
+  for (device *d = ctx->devs; d != NULL; d = d->next) {
+    if ((d->enabled == 0) || (strcmp(d->comms, "tcp") != 0)) continue;
+    if ((d->tcp_conn == 1) && (d->tcp_state != TCP_STATE_CONNECTED)) return (0);
+    if ((d->listen_fd != -1) && (d->read_fd == -1))                   return (0);
+  }
+  return (1);
+}
+
+/**********************************************************************/
+/* D) Write and timers */
+/*********t************************************************************/
+/* Append iov bytes from offset skip (of len) to the send queue. Returns 0, or -1 if they do not fit */
+static int tcp_txq_add(device *d, struct iovec *iov, int iovcnt, int skip, int len) {
+  uint8_t *q;
+
+  if ((d->txq == NULL) && ((d->txq = malloc(TCP_TXQ_BYTES)) == NULL)) {
+    log_fatal("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  if (d->txq_len - d->txq_off + len - skip > TCP_TXQ_BYTES) return (-1);
+  if (d->txq_len + len - skip > TCP_TXQ_BYTES) {      /* move unsent bytes to the front */
+    memmove(d->txq, d->txq + d->txq_off, d->txq_len - d->txq_off);
+    d->txq_len -= d->txq_off;
+    d->txq_off  = 0;
+  }
+  q = d->txq + d->txq_len;
+  for (int i = 0; i < iovcnt; i++) {
+    int n = iov[i].iov_len;
+    if (skip >= n) { skip -= n; continue; }
+    memcpy(q, (uint8_t *) iov[i].iov_base + skip, n - skip);
+    q    += n - skip;
+    skip  = 0;
+  }
+  d->txq_len = q - d->txq;
+  return (0);
+}
+
+/* Send queued bytes (when poll finds the socket writable) */
+void tcp_flush(hal_ctx *ctx, device *d) {
+  int rv;
+
+  if ((d->tcp_state != TCP_STATE_CONNECTED) || (d->txq_len == 0)) return;
+  if ((rv = send(d->write_fd, d->txq + d->txq_off, d->txq_len - d->txq_off, MSG_NOSIGNAL)) < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) tcp_disconnect(ctx, d, d->write_fd, strerror(errno));
+    return;
+  }
+  d->txq_off += rv;
+  if (d->txq_off == d->txq_len) {
+    d->txq_off      = 0;
+    d->txq_len      = 0;
+    ctx->poll_dirty = 1;            /* stop polling for POLLOUT */
+  }
+}
+
+/* Write packet gathered from iov, queueing what the socket does not take (dropped if not connected or
+   the queue is full). Returns bytes written or queued, or -1 */
+int tcp_writev(hal_ctx *ctx, device *d, struct iovec *iov, int iovcnt, int len) {
+  struct msghdr msg;
+  int           rv;
+
+  if ((d->tcp_state != TCP_STATE_CONNECTED) || (d->write_fd == -1)) {
+    log_debug("TCP device %s not connected: dropping packet (len=%d)", d->id, len);
+    return (-1);
+  }
+  if (d->txq_len > 0) {             /* earlier bytes still queued, so queue behind them (keeping order) */
+    if (tcp_txq_add(d, iov, iovcnt, 0, len) < 0) {
+      log_warn("TCP device %s send queue full (%d bytes): dropping packet (len=%d)", d->id, d->txq_len - d->txq_off, len);
+      return (-1);
+    }
+  }
+  else {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = iovcnt;
+    if ((rv = sendmsg(d->write_fd, &msg, MSG_NOSIGNAL)) < 0) {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+        tcp_disconnect(ctx, d, d->write_fd, strerror(errno));
+        return (-1);
+      }
+      rv = 0;
+    }
+    if (rv < len) {                 /* partial write: queue the rest (fits, as the queue was empty) */
+      tcp_txq_add(d, iov, iovcnt, rv, len);
+      ctx->poll_dirty = 1;          /* poll for POLLOUT */
+    }
+  }
+  if (d->tcp_cork_us > 0) {
+    if (d->cork_len == 0) d->cork_deadline_ns = time_mono_ns() + d->tcp_cork_us * 1000ULL;
+    d->cork_len += len;
+    if (d->cork_len >= d->tcp_cork_bytes) tcp_uncork(d);
+  }
+  return (len);
+}
+
+/* Write packet (dropped if not connected or the queue is full). Returns bytes written or queued, or -1 */
+int tcp_write(hal_ctx *ctx, device *d, uint8_t *buf, int len) {
+  struct iovec iov = {.iov_base = buf, .iov_len = len};
+
+  return (tcp_writev(ctx, d, &iov, 1, len));
+}
+
+/* Send coalesced writes and start reconnects that are due. Returns time of the next one (0 = none) */
+uint64_t tcp_timers(hal_ctx *ctx, uint64_t now_ns) {
+  uint64_t next = 0;
+
+  for (device *d = ctx->devs; d != NULL; d = d->next) {
+    if ((d->enabled == 0) || (strcmp(d->comms, "tcp") != 0)) continue;
+    if (d->cork_deadline_ns != 0) {
+      if (d->cork_deadline_ns <= now_ns) tcp_uncork(d);
+      else if ((next == 0) || (d->cork_deadline_ns < next)) next = d->cork_deadline_ns;
+    }
+    if ((d->tcp_conn == 1) && (d->tcp_state == TCP_STATE_CLOSED)) {
+      if (d->tcp_retry_ns <= now_ns) tcp_connect_start(ctx, d);
+      if ((d->tcp_state == TCP_STATE_CLOSED) && ((next == 0) || (d->tcp_retry_ns < next))) next = d->tcp_retry_ns;
+    }
+  }
+  return (next);
+}
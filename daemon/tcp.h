@@ -0,0 +1,23 @@
+/* HAL TCP transport: persistent listener, reconnecting client and write coalescing */
+
+#define TCP_STATE_CLOSED      0     /* no connection (client waits to reconnect) */
+#define TCP_STATE_CONNECTING  1     /* client non-blocking connect in progress */
+#define TCP_STATE_CONNECTED   2
+
+#define TCP_LISTEN_BACKLOG    5
+#define TCP_RECONNECT_MIN_MS  100       /* first reconnect wait, doubled after each failure ... */
+#define TCP_RECONNECT_MAX_MS  5000      /* ... up to this */
+#define TCP_CORK_BYTES_DEFAULT 16384    /* coalesced bytes that trigger a send (if tcp_cork_bytes unset) */
+#define TCP_TXQ_BYTES         (4 * PACKET_MAX)  /* send queue for bytes the socket has not taken yet */
+
+extern void     tcp_config_defaults(device *d);
+extern void     tcp_listen_start(device *d);
+extern void     tcp_connect_start(hal_ctx *ctx, device *d);
+extern void     tcp_connect_done(hal_ctx *ctx, device *d);
+extern void     tcp_accept(hal_ctx *ctx, device *d);
+extern void     tcp_disconnect(hal_ctx *ctx, device *d, int fd, const char *why);
+extern int      tcp_write(hal_ctx *ctx, device *d, uint8_t *buf, int len);
+extern int      tcp_writev(hal_ctx *ctx, device *d, struct iovec *iov, int iovcnt, int len);
+extern void     tcp_flush(hal_ctx *ctx, device *d);
+extern uint64_t tcp_timers(hal_ctx *ctx, uint64_t now_ns);
+extern int      tcp_all_connected(hal_ctx *ctx);
@@ -1,19 +1,45 @@
 /*
- * Put unix time into packets in network byte order (only for testing)
+ * Put unix time into packets in network byte order, and read HAL's clocks
  *   December 2020, Perspecta Labs
  */
 
+#include <time.h>
 #include "hal.h"
 #include "time.h"
+#include "cycles.h"
 #include "../appgen/6month-demo/float754.h"          /* use htonll */
 
-void linux_time_set(uint64_t *t) {
-  struct timeval tv;
-  uint64_t ns;
-  
-  gettimeofday(&tv,NULL);
-  ns =  (tv.tv_usec * 1000) + (tv.tv_sec  * 1000000000);
-  *t = htonll(ns);          // Convert to BIG ENDIAN
-  log_trace("unix time = %lu = 0x%lx nsec\n", ns, ns);
-//  fprintf(stderr, "unix time=%lu.%lu sec = %lu = 0x%lx (net=0x%lx) nsec\n", tv.tv_sec, tv.tv_usec, ns, ns, *t);
+/* Write time t (ns) into a packet's 64-bit time field (e.g., two 32-bit words), in network byte order */
+void linux_time_put(void *field, uint64_t t) {
+  uint64_t n = htonll(t);
+  memcpy(field, &n, sizeof(n));          /* (field may not be 8-byte aligned) */
+}
+
+/* Read time (ns) from a packet's 64-bit time field */
+uint64_t linux_time_get(void *field) {
+  uint64_t n;
+  memcpy(&n, field, sizeof(n));
+  return (ntohll(n));
+}
+
+/* Monotonic time in nanoseconds (for timers), from the cycle counter */
+uint64_t time_mono_ns(void) {
+  return (cycles_ns());
+}
+
+/* Time in nanoseconds from clock (e.g., CLOCK_REALTIME for timestamps compared across hosts) */
+uint64_t time_clock_ns(int clock) {
+  struct timespec t;
+
+  clock_gettime((clockid_t) clock, &t);
+  return ((uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+/* Get a device's timestamp clock from its config name ("" or "none" = no timestamps, so -1) */
+int time_clock_by_name(const char *name, const char *dev_id) {
+  if ((strlen(name) == 0) || (strcmp(name, "none")     == 0)) return (-1);
+  if  (strcmp(name, "realtime") == 0)                        return (CLOCK_REALTIME);
+  if  (strcmp(name, "mono_raw") == 0)                        return (CLOCK_MONOTONIC_RAW);
+  log_fatal("Device %s has unknown tstamp clock '%s' (use realtime, mono_raw or none)", dev_id, name);
+  exit(EXIT_FAILURE);
 }
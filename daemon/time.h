@@ -1 +1,5 @@
-void linux_time_set(uint64_t *t);
+void     linux_time_put(void *field, uint64_t t);
+uint64_t linux_time_get(void *field);
+uint64_t time_mono_ns(void);
+uint64_t time_clock_ns(int clock);
+int      time_clock_by_name(const char *name, const char *dev_id);
@@ -0,0 +1,204 @@
+/*
+ * HAL serial (tty) transport
+ *   October 2026, Peraton Labs
+ *
+ * tty_open puts the line in raw mode with the device's VMIN/VTIME (and
+ * speed). A tty is a byte stream, so HAL reads whatever bytes are ready:
+ *   - Without framing (default), packets are delimited by their headers,
+ *     keeping a packet split across reads for the next one (as for tcp).
+ *   - With tty_hdlc = 1, each packet is sent as an HDLC-like frame
+ *     (RFC 1662 byte stuffing, with a crc16 FCS), so a receiver can
+ *     resynchronize after line errors: frames with a bad FCS are dropped.
+ *     hdlc_decode unstuffs a read in place, returning every complete
+ *     frame in it, and keeps the partial frame at the end for the next read.
+ */
+
+#include "hal.h"
+#include "tty.h"
+#include "crc.h"
+#include <termios.h>
+
+/**********************************************************************/
+/* A) Line settings */
+/*********t************************************************************/
+static speed_t tty_speed(device *d) {
+  static const struct {int baud; speed_t speed;} speeds[] = {
+    {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+    {230400, B230400}, {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600},
+    {1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+    {2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000},
+  };
+
+  for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+    if (speeds[i].baud == d->tty_baud) return (speeds[i].speed);
+  }
+  log_fatal("Device %s has unsupported tty_baud=%d", d->id, d->tty_baud);
+  exit(EXIT_FAILURE);
+}
+
+/* Set raw mode (with the device's VMIN, VTIME and speed) on an open tty device */
+void tty_open(device *d) {
+  struct termios  t;
+
+  if ((d->tty_vmin  < 0) || (d->tty_vmin  > 255)) d->tty_vmin  = 1;
+  if ((d->tty_vtime < 0) || (d->tty_vtime > 255)) d->tty_vtime = 0;
+  if (d->tty_hdlc < 0) d->tty_hdlc = 0;
+  d->rx_stream = (d->tty_hdlc == 0);       /* (HDLC frames delimit packets) */
+  d->hdlc_esc  = 0;
+
+  if (isatty(d->read_fd) == 0) {
+    log_trace("Device %s (%s) is not a terminal: no line settings", d->id, d->path);
+    return;
+  }
+  if (tcgetattr(d->read_fd, &t) < 0) {
+    log_fatal("Cannot get terminal settings for %s (%s): %s", d->id, d->path, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  cfmakeraw(&t);
+  t.c_cflag |= (CLOCAL | CREAD);
+  t.c_cc[VMIN]  = d->tty_vmin;
+  t.c_cc[VTIME] = d->tty_vtime;
+  if (d->tty_baud > 0) {
+    cfsetispeed(&t, tty_speed(d));
+    cfsetospeed(&t, tty_speed(d));
+  }
+  if (tcsetattr(d->read_fd, TCSANOW, &t) < 0) {
+    log_fatal("Cannot set terminal settings for %s (%s): %s", d->id, d->path, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  tcflush(d->read_fd, TCIFLUSH);           /* drop any bytes read before raw mode */
+  log_trace("Device %s raw mode: baud=%d vmin=%d vtime=%d hdlc=%d", d->id, d->tty_baud, d->tty_vmin, d->tty_vtime, d->tty_hdlc);
+}
+
+/**********************************************************************/
+/* B) HDLC-like framing */
+/*********t************************************************************/
+/* Copy len bytes from in to out, escaping flag and escape bytes. Returns bytes written */
+static int hdlc_stuff(uint8_t *out, uint8_t *in, int len) {
+  int w = 0;
+
+  for (int i = 0; i < len; i++) {
+    if ((in[i] == HDLC_FLAG) || (in[i] == HDLC_ESC)) {
+      out[w++] = HDLC_ESC;
+      out[w++] = in[i] ^ HDLC_XOR;
+    }
+    else out[w++] = in[i];
+  }
+  return (w);
+}
+
+/* Write packet (in) as a frame into out (which must have 2*len + 6 bytes). Returns frame length */
+int hdlc_encode(uint8_t *out, uint8_t *in, int len) {
+  uint16_t  fcs = crc16(in, len);
+  uint8_t   fcs_bytes[HDLC_FCS_LEN] = {fcs & 0xff, fcs >> 8};
+  int       w = 0;
+
+  out[w++] = HDLC_FLAG;
+  w += hdlc_stuff(out + w, in, len);
+  w += hdlc_stuff(out + w, fcs_bytes, HDLC_FCS_LEN);
+  out[w++] = HDLC_FLAG;
+  return (w);
+}
+
+/*
+ * Unstuff bytes read into buf[start..end), after the partial frame (already
+ * unstuffed) in buf[0..start). Returns the length of the packets in the
+ * complete frames (in buf, one after another), with the new partial frame
+ * (part_len bytes) after them.
+ */
+int hdlc_decode(device *d, uint8_t *buf, int start, int end, int *part_len) {
+  int       done = 0, w = start, esc = d->hdlc_esc, n;
+  uint8_t   c;
+
+  for (int r = start; r < end; r++) {
+    c = buf[r];
+    if (c == HDLC_FLAG) {
+      n = w - done;                   /* frame = packet + FCS */
+      if (n > HDLC_FCS_LEN) {
+        if (crc16(buf + done, n - HDLC_FCS_LEN) == (buf[w - 2] | (buf[w - 1] << 8))) done += n - HDLC_FCS_LEN;
+        else log_warn("Dropping frame from %s (len=%d): bad FCS", d->id, n);
+      }
+      else if (n > 0) log_warn("Dropping frame from %s (len=%d): too short", d->id, n);
+      w   = done;
+      esc = 0;
+    }
+    else if (c == HDLC_ESC) esc = 1;
+    else {
+      buf[w++] = (esc) ? c ^ HDLC_XOR : c;
+      esc = 0;
+    }
+  }
+  d->hdlc_esc = esc;
+  *part_len   = w - done;
+  return (done);
+}
+
+/**********************************************************************/
+/* C) Write */
+/*********t************************************************************/
+/* Write packet (as a frame, if tty_hdlc). Returns packet bytes written, or -1 */
+int tty_write(device *d, uint8_t *buf, int len) {
+  uint8_t  *out = buf;
+  int       n = len, w, rv;
+
+  if (d->tty_hdlc) {
+    if ((d->tty_tx == NULL) && ((d->tty_tx = malloc(2 * PACKET_MAX + 6)) == NULL)) {
+      log_fatal("Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+    n   = hdlc_encode(d->tty_tx, buf, len);
+    out = d->tty_tx;
+  }
+  for (w = 0; w < n; w += rv) {
+    if ((rv = write(d->write_fd, out + w, n - w)) < 0) {
+      if (errno == EINTR) {rv = 0; continue;}
+      log_error("Write error on %s (%s): %s", d->id, d->path, strerror(errno));
+      return (-1);
+    }
+  }
+  return (len);
+}
+
+/**********************************************************************/
+/* D) Test: frames written to one end of a pty are read from the other */
+/*    (make tty_test; ./tty_test)                                      */
+/*********t************************************************************/
+#ifdef TTY_TEST
+#include <pty.h>
+
+int main(void) {
+  device    dw, dr;
+  int       fd_m, fd_s, got = 0, bad = 0, carry = 0, done, part, n, rv, sent = 0;
+  uint8_t   pkt[3000], *buf = malloc(PACKET_MAX);
+
+  if (openpty(&fd_m, &fd_s, NULL, NULL, NULL) < 0) {perror("openpty"); return (1);}
+  memset(&dw, 0, sizeof(dw));
+  dw.id = "ttyw"; dw.path = "pty"; dw.read_fd = dw.write_fd = fd_s; dw.tty_hdlc = 1;
+  dw.tty_baud = dw.tty_vmin = dw.tty_vtime = -1;
+  dr = dw;
+  dr.id = "ttyr"; dr.read_fd = dr.write_fd = fd_m;
+  tty_open(&dw);
+  tty_open(&dr);
+
+  /* Packets of every length up to 300 bytes (all byte values, including flags and escapes) */
+  for (n = 1; n <= 300; n++) {
+    for (int i = 0; i < n; i++) pkt[i] = (uint8_t) (i * 13 + n);
+    if (n == 150) write(fd_s, "\x7e\x01\x02\x03\x04\x7e", 6);     /* a frame with a bad FCS */
+    tty_write(&dw, pkt, n);
+    sent++;
+    while ((got < sent) && ((rv = read(fd_m, buf + carry, 97)) > 0)) {   /* small reads split frames */
+      done = hdlc_decode(&dr, buf, carry, carry + rv, &part);
+      for (int off = 0; off < done; ) {
+        int len = got + 1;            /* the packet expected next */
+        for (int i = 0; i < len; i++) if (buf[off + i] != (uint8_t) (i * 13 + len)) {bad++; break;}
+        off += len;
+        got++;
+      }
+      memmove(buf, buf + done, part);
+      carry = part;
+    }
+  }
+  printf("tty_test: sent=%d received=%d bad=%d\n", sent, got, bad);
+  return ((got == sent) && (bad == 0)) ? 0 : 1;
+}
+#endif
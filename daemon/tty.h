@@ -0,0 +1,11 @@
+/* HAL serial (tty) transport: raw mode and optional HDLC-like framing */
+
+#define HDLC_FLAG      0x7e     /* frame delimiter (RFC 1662) */
+#define HDLC_ESC       0x7d     /* control escape: next byte is XORed with HDLC_XOR */
+#define HDLC_XOR       0x20
+#define HDLC_FCS_LEN   2        /* crc16 FCS (least significant byte first) */
+
+extern void tty_open(device *d);
+extern int  tty_write(device *d, uint8_t *buf, int len);
+extern int  hdlc_encode(uint8_t *out, uint8_t *in, int len);
+extern int  hdlc_decode(device *d, uint8_t *buf, int start, int end, int *part_len);
@@ -0,0 +1,208 @@
+/*
+ * HAL UDP transport
+ *   October 2026, Peraton Labs
+ *
+ * Optional per-device offloads for large packets:
+ *   - udp_gso_size = N: a packet longer than N bytes is sent as N-byte
+ *     datagrams, up to UDP_GSO_SEGMENTS_MAX of them per sendmsg, using
+ *     UDP_SEGMENT (if the kernel refuses, HAL sends each datagram itself,
+ *     so the peer sees the same datagrams).
+ *   - udp_gro = 1: received datagrams are packet pieces (e.g., from a
+ *     peer using udp_gso_size), reassembled as for TCP; UDP_GRO lets one
+ *     read return a batch of them.
+ * UDP can lose datagrams, so reassembly uses the datagram boundaries (from
+ * the UDP_GRO segment size) to check each packet: a HAL sender starts every
+ * packet with a datagram, and all datagrams of a packet but its last have
+ * the same (udp_gso_size) length. A packet that breaks this (e.g., one
+ * completed with the start of the next, after a loss) is dropped, up to
+ * the next datagram, as is a partly reassembled packet not completed
+ * within UDP_REASSEMBLY_MS.
+ */
+
+#include "hal.h"
+#include "udp.h"
+#include <netinet/udp.h>
+
+/**********************************************************************/
+/* A) Socket options */
+/*********t************************************************************/
+/* Set the device's UDP options (once its sockets are open) */
+void udp_open(device *d) {
+  int on = 1;
+
+  if (d->udp_gso_size < 0) d->udp_gso_size = 0;
+  if (d->udp_gro      < 0) d->udp_gro      = 0;
+  if (d->udp_gso_size > UDP_GSO_BYTES_MAX) {
+    log_warn("UDP device %s udp_gso_size=%d too big: using %d", d->id, d->udp_gso_size, UDP_GSO_BYTES_MAX);
+    d->udp_gso_size = UDP_GSO_BYTES_MAX;
+  }
+  if ((d->udp_gro > 0) && (d->read_fd != -1)) {
+    d->rx_stream       = 1;
+    d->rx_carry_ttl_ms = UDP_REASSEMBLY_MS;
+    if (setsockopt(d->read_fd, IPPROTO_UDP, UDP_GRO, &on, sizeof(on)) < 0) {
+      log_warn("UDP device %s cannot set UDP_GRO (reading one datagram at a time): %s", d->id, strerror(errno));
+    }
+  }
+  if ((d->udp_gso_size > 0) || (d->udp_gro > 0)) log_trace("UDP device %s: gso_size=%d gro=%d", d->id, d->udp_gso_size, d->udp_gro);
+}
+
+/**********************************************************************/
+/* B) Write and read */
+/*********t************************************************************/
+/* Send iov as one datagram, or (if gso > 0 and len > gso) as gso-byte datagrams using UDP_SEGMENT */
+static int udp_sendv(device *d, struct iovec *iov, int iovcnt, int len, int gso) {
+  struct msghdr   msg;
+  struct cmsghdr *cm;
+  char            ctl[CMSG_SPACE(sizeof(uint16_t))];
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name    = &(d->socaddr_out);
+  msg.msg_namelen = sizeof(d->socaddr_out);
+  msg.msg_iov     = iov;
+  msg.msg_iovlen  = iovcnt;
+  if ((gso > 0) && (len > gso)) {
+    memset(ctl, 0, sizeof(ctl));
+    msg.msg_control    = ctl;
+    msg.msg_controllen = sizeof(ctl);
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type  = UDP_SEGMENT;
+    cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+    *((uint16_t *) CMSG_DATA(cm)) = (uint16_t) gso;
+  }
+  return (sendmsg(d->write_fd, &msg, MSG_CONFIRM));
+}
+
+static int udp_send(device *d, uint8_t *buf, int len, int gso) {
+  struct iovec iov = {.iov_base = buf, .iov_len = len};
+
+  return (udp_sendv(d, &iov, 1, len, gso));
+}
+
+/* Write packet gathered from iov as one datagram (so len must be at most any udp_gso_size). Returns bytes written, or -1 */
+int udp_writev(device *d, struct iovec *iov, int iovcnt, int len) {
+  int rv;
+
+  if ((rv = udp_sendv(d, iov, iovcnt, len, 0)) < 0) log_error("UDP send error on %s: %s", d->id, strerror(errno));
+  return (rv);
+}
+
+/* Write packet (in udp_gso_size datagrams, if set). Returns bytes written, or -1 */
+int udp_write(device *d, uint8_t *buf, int len) {
+  int gso = d->udp_gso_size, burst, n, sent;
+
+  if ((gso <= 0) || (len <= gso)) return (udp_send(d, buf, len, 0));
+  burst = (d->udp_gso_off) ? gso : gso * ((UDP_GSO_BYTES_MAX / gso < UDP_GSO_SEGMENTS_MAX) ? UDP_GSO_BYTES_MAX / gso : UDP_GSO_SEGMENTS_MAX);
+  for (sent = 0; sent < len; sent += n) {
+    n = (len - sent < burst) ? len - sent : burst;
+    if (udp_send(d, buf + sent, n, (d->udp_gso_off) ? 0 : gso) < 0) {
+      if ((d->udp_gso_off == 0) && ((errno == EIO) || (errno == EINVAL) || (errno == ENOPROTOOPT))) {
+        log_warn("UDP device %s cannot send with UDP_SEGMENT (HAL will segment): %s", d->id, strerror(errno));
+        d->udp_gso_off = 1;
+        burst = gso;
+        n     = 0;
+        continue;
+      }
+      log_error("UDP send error on %s: %s", d->id, strerror(errno));
+      return (-1);
+    }
+  }
+  return (sent);
+}
+
+/*
+ * Read a datagram (or, with UDP_GRO, a batch of them) into buf. Returns bytes
+ * read, or -1 if too big for buf. With udp_gro, sets udp_seg_in to the length
+ * of the datagrams read (all but the last, which may be shorter).
+ */
+int udp_read(device *d, uint8_t *buf, int len) {
+  struct iovec    iov = {.iov_base = buf, .iov_len = len};
+  struct msghdr   msg;
+  struct cmsghdr *cm;
+  char            ctl[CMSG_SPACE(sizeof(int))];
+  int             rv;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = ctl;
+  msg.msg_controllen = sizeof(ctl);
+  if ((rv = recvmsg(d->read_fd, &msg, 0)) < 0) {
+    log_fatal("recvfrom errno code: %d", errno);
+    exit(EXIT_FAILURE);
+  }
+  if (msg.msg_flags & MSG_TRUNC) {
+    log_warn("UDP device %s dropping datagram(s) longer than buffer (%d bytes)", d->id, len);
+    return (-1);
+  }
+  if (d->udp_gro > 0) {
+    d->udp_seg_in = rv;                           /* (one datagram, unless UDP_GRO says otherwise) */
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      if ((cm->cmsg_level == SOL_UDP) && (cm->cmsg_type == UDP_GRO)) d->udp_seg_in = *((int *) CMSG_DATA(cm));
+    }
+    if (d->udp_seg_in <= 0) d->udp_seg_in = rv;
+  }
+  return (rv);
+}
+
+/**********************************************************************/
+/* C) Reassembly checks (udp_gro) */
+/*********t************************************************************/
+/*
+ * A udp_gro read is udp_carry_len bytes kept from earlier reads (datagrams of
+ * udp_seg_carry bytes) followed by the datagrams read (of udp_seg_in bytes,
+ * but the last). Returns the end of the datagram with byte off of the len bytes.
+ */
+static int udp_dgram_end(device *d, int off, int len) {
+  int c = d->udp_carry_len, end;
+
+  if (off < c) end = (off / d->udp_seg_carry + 1) * d->udp_seg_carry;
+  else         end = c + ((off - c) / d->udp_seg_in + 1) * d->udp_seg_in;
+  return ((end < len) ? end : len);
+}
+
+static int udp_dgram_start(device *d, int off) {
+  int c = d->udp_carry_len;
+
+  if (off < c) return ((off / d->udp_seg_carry) * d->udp_seg_carry);
+  return (c + ((off - c) / d->udp_seg_in) * d->udp_seg_in);
+}
+
+/*
+ * Check the datagrams from off to end (of the len bytes) could hold one packet
+ * (or, if end = len, the start of one) from a HAL sender: it fits in the datagram
+ * with off, or it starts that datagram, and every datagram of it but the last
+ * has the first's length (the last no longer, and ending at end). Returns the
+ * length of the first datagram if so, else 0.
+ */
+static int udp_dgram_check(device *d, int off, int end, int len) {
+  int b = udp_dgram_start(d, off), e = udp_dgram_end(d, off, len), seg = e - b;
+
+  if (end <= e) return (seg);
+  if (b != off) return (0);
+  while (e < end) {
+    b = e;
+    e = udp_dgram_end(d, b, len);
+    if ((e - b > seg) || ((e < end) && (e - b != seg))) return (0);
+  }
+  return ((e == end) ? seg : 0);
+}
+
+/* Return 1 if a packet parsed from off (pkt_len of the len bytes read) could be from a HAL sender, else 0 */
+int udp_gro_packet_ok(device *d, int off, int pkt_len, int len) {
+  return (udp_dgram_check(d, off, off + pkt_len, len) > 0);
+}
+
+/* Return the bytes from off (of the len read) to the next datagram, to drop a bad packet */
+int udp_gro_skip(device *d, int off, int len) {
+  return (udp_dgram_end(d, off, len) - off);
+}
+
+/* Check the incomplete packet from off (to len) starts a datagram, all with its full length, to keep it. Returns 1 if so */
+int udp_gro_carry_ok(device *d, int off, int len) {
+  int seg = udp_dgram_check(d, off, len, len);
+
+  if ((seg <= 0) || (udp_dgram_start(d, off) != off) || ((len - off) % seg != 0)) return (0);
+  d->udp_seg_carry = seg;
+  return (1);
+}
@@ -0,0 +1,13 @@
+/* HAL UDP transport: segmentation offload (GSO) on send, receive offload (GRO) and reassembly on receive */
+
+#define UDP_GSO_BYTES_MAX     65000   /* most bytes sent in one UDP_SEGMENT sendmsg (kernel limit ~64 KB) */
+#define UDP_GSO_SEGMENTS_MAX  64      /* most segments in one UDP_SEGMENT sendmsg (kernel UDP_MAX_SEGMENTS) */
+#define UDP_REASSEMBLY_MS     100     /* drop a partly reassembled packet not completed within this time */
+
+extern void udp_open(device *d);
+extern int  udp_write(device *d, uint8_t *buf, int len);
+extern int  udp_writev(device *d, struct iovec *iov, int iovcnt, int len);
+extern int  udp_read(device *d, uint8_t *buf, int len);
+extern int  udp_gro_packet_ok(device *d, int off, int pkt_len, int len);
+extern int  udp_gro_skip(device *d, int off, int len);
+extern int  udp_gro_carry_ok(device *d, int off, int len);
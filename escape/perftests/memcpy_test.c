@@ -1,7 +1,10 @@
 // Memory Speed Tests varying memory type-pairs, copy sizes and copy algorithms.
 //    March 13, 2023
 // Usage:  ./memcpy_test -h
+//    October 2026: added concurrent copier threads (with CPU pinning), NUMA node
+//    binding, 4K vs huge page backing and small-copy latency (cycles per copy)
 
+#define _GNU_SOURCE       // pthread_setaffinity_np
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -10,6 +13,13 @@
 #include <unistd.h>       // close
 #include <errno.h>
 #include <sys/mman.h>     // mmap
+#include <sys/syscall.h>  // mbind (without needing libnuma)
+#include <pthread.h>
+#include <sched.h>
+#if defined(__x86_64__) || defined(__i386)
+#include <x86intrin.h>    // __rdtscp, _mm_clflush
+#define HAVE_TSC
+#endif
 #include "apex_memmove.h" // memcpyA
 
 // 1) experiment iteration parameters
@@ -34,6 +44,18 @@ static unsigned long  copy_size_list[MAX_NUM_PAYLOAD_LEN] = {0x10, 0x100, 0x400,
 #define BYTES_PER_WORD     (sizeof(unsigned long)/sizeof(char))
 #define MAX_MEM_PAIRS      6                // Number of memory type combos: 4,5 only on escape boxes
 #define MAX_NAME_LEN       32
+#define MAX_LABEL_LEN      96
+#define MAX_THREAD_COUNTS  16               // Number of thread counts (in -t list)
+#define MAX_CPUS           256              // Number of CPUs (in -c list)
+#define LAT_MAX_LEN        0x1000           // Only measure latency of copies up to 4 KB
+#define CACHE_LINE         64
+#ifndef MPOL_BIND
+#define MPOL_BIND          2                // from <numaif.h>
+#define MPOL_MF_MOVE       (1<<1)
+#endif
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB        0x40000
+#endif
 #define BILLION            1000000000
 #define FATAL do { fprintf(stderr, "Error at line %d, file %s (%d) [%s]\n", \
     __LINE__, __FILE__, errno, strerror(errno)); exit(1); } while(0)
@@ -41,6 +63,20 @@ static unsigned long  copy_size_list[MAX_NUM_PAYLOAD_LEN] = {0x10, 0x100, 0x400,
 //#define DEBUG
 //#define PRINT_DATA
 
+// 4) Multi-threaded, NUMA, page backing and latency test options
+enum { PAGES_DEFAULT, PAGES_4K, PAGES_THP, PAGES_HUGETLB };
+static const char *page_names[] = {"", "4K pages", "THP", "hugetlb"};
+typedef struct _mt_config {
+  int    thread_list[MAX_THREAD_COUNTS];  // Numbers of concurrent copier threads to test
+  int    num_thread_counts;               // 0 = original single (main) thread test
+  int    cpu_list[MAX_CPUS];              // Thread i is pinned to cpu_list[i % num_cpus]
+  int    num_cpus;                        // 0 = no pinning
+  int    numa_src, numa_dst;              // NUMA node for source and destination heap (-1 = any)
+  int    page_mode;                       // Page backing for heap memory
+  int    latency;                         // 1 = measure small-copy latency (not throughput)
+} mt_config;
+static mt_config mt = {.numa_src = -1, .numa_dst = -1};
+
 //**************************************************************************************
 // A) Timing Operations
 //**************************************************************************************
@@ -76,6 +112,10 @@ void write_header(FILE *fptr) {
   fprintf(fptr, "Experiment Description, Copy lenth (Bytes), Copy Type, Throughput (Gbps), Number of Runs\n");
 }
 
+void write_latency_header(FILE *fptr) {
+  fprintf(fptr, "Experiment Description, Copy lenth (Bytes), Copy Type, Latency (Cycles per copy), Number of Runs\n");
+}
+
 //**************************************************************************************
 // B) Payload data operations
 //**************************************************************************************
@@ -144,7 +184,153 @@ void batch_tests_for_given_length(char *destin, char *source, unsigned long payl
   clock_gettime(CLOCK_MONOTONIC_RAW, &te);
   process_results(payload_len, fptr, mem_pair_label, ts, te, " apex_memcpy", destin, num_test_runs);
 }
-          
+
+// The same memcpy methods, callable through a function pointer (by copier threads and latency tests)
+typedef void *(*copy_fn)(void *, const void *, size_t);
+void *naive_copy(void *d, const void *s, size_t len) { naive_memcpy(d, s, len/BYTES_PER_WORD); return (d); }
+void *apex_copy(void *d, const void *s, size_t len)  { return (apex_memcpy(d, s, len)); }
+static struct { char *name; copy_fn fn; } copy_methods[] = {
+  {"glibc_memcpy", memcpy}, {"naive_memcpy", naive_copy}, {" apex_memcpy", apex_copy}
+};
+#define NUM_COPY_METHODS   (sizeof(copy_methods)/sizeof(copy_methods[0]))
+
+// Copier threads: each copies its own disjoint slice of the source to the destination
+typedef struct _copier {
+  pthread_t        thread;
+  int              id;
+  struct timespec  ts, te;
+} copier;
+
+static struct {                         // Current job for all copier threads
+  copy_fn            fn;                // NULL = threads exit
+  char              *destin, *source;
+  unsigned long      payload_len;
+  int                num_test_runs;
+  pthread_barrier_t  start, done;
+} job;
+
+void *copier_thread(void *arg) {
+  copier *c = (copier *) arg;
+  char   *d, *s;
+
+  while (1) {
+    pthread_barrier_wait(&job.start);   // All threads start copying together
+    if (job.fn == NULL) break;
+    d = job.destin + c->id * job.payload_len;
+    s = job.source + c->id * job.payload_len;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &(c->ts));
+    for (int j=0; j < job.num_test_runs; j++) job.fn(d, s, job.payload_len);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &(c->te));
+    pthread_barrier_wait(&job.done);
+  }
+  return (NULL);
+}
+
+// Start copier threads, pinning thread i to the i'th CPU in the (-c) CPU list
+void copiers_start(copier *copiers, int num_threads) {
+  pthread_attr_t  attr;
+  cpu_set_t       cpus;
+
+  if (pthread_barrier_init(&job.start, NULL, num_threads + 1) != 0) FATAL;
+  if (pthread_barrier_init(&job.done,  NULL, num_threads + 1) != 0) FATAL;
+  for (int i=0; i < num_threads; i++) {
+    pthread_attr_init(&attr);
+    if (mt.num_cpus > 0) {
+      CPU_ZERO(&cpus);
+      CPU_SET(mt.cpu_list[i % mt.num_cpus], &cpus);
+      pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    copiers[i].id = i;
+    if ((errno = pthread_create(&(copiers[i].thread), &attr, copier_thread, &(copiers[i]))) != 0) FATAL;
+    pthread_attr_destroy(&attr);
+  }
+}
+
+void copiers_stop(copier *copiers, int num_threads) {
+  job.fn = NULL;
+  pthread_barrier_wait(&job.start);
+  for (int i=0; i < num_threads; i++) pthread_join(copiers[i].thread, NULL);
+  pthread_barrier_destroy(&job.start);
+  pthread_barrier_destroy(&job.done);
+}
+
+// Aggregate throughput is all bytes copied by all threads, from first start to last finish
+void process_threaded_results(unsigned long payload_len, FILE *fptr, char *mem_pair_label, copier *copiers, int num_threads, char *cpy_type, int num_test_runs) {
+  struct timespec  ts = copiers[0].ts, te = copiers[0].te;
+  unsigned long    delta_nsec=0;
+
+  for (int i=1; i < num_threads; i++) {
+    if ((copiers[i].ts.tv_sec < ts.tv_sec) || ((copiers[i].ts.tv_sec == ts.tv_sec) && (copiers[i].ts.tv_nsec < ts.tv_nsec))) ts = copiers[i].ts;
+    if ((copiers[i].te.tv_sec > te.tv_sec) || ((copiers[i].te.tv_sec == te.tv_sec) && (copiers[i].te.tv_nsec > te.tv_nsec))) te = copiers[i].te;
+  }
+  get_delta(ts, te, &delta_nsec);
+  print_delta(cpy_type, delta_nsec, payload_len * num_threads, num_test_runs);
+  if (delta_nsec > 0) {
+    fprintf(fptr, "%s, %ld, %s, %.3f, %d\n", mem_pair_label, payload_len, cpy_type, get_rate(payload_len * num_threads, num_test_runs, delta_nsec), num_test_runs);
+  }
+}
+
+// Different memcpy methods, each run by all copier threads concurrently
+void threaded_tests_for_given_length(char *destin, char *source, unsigned long payload_len, FILE *fptr, char *mem_pair_label, int num_test_runs, copier *copiers, int num_threads) {
+  char  cpy_type[MAX_NAME_LEN];
+
+  for (int k=0; k < NUM_COPY_METHODS; k++) {
+    job.fn            = copy_methods[k].fn;
+    job.destin        = destin;
+    job.source        = source;
+    job.payload_len   = payload_len;
+    job.num_test_runs = num_test_runs;
+    pthread_barrier_wait(&job.start);
+    pthread_barrier_wait(&job.done);
+    snprintf(cpy_type, MAX_NAME_LEN, "%s x%d", copy_methods[k].name, num_threads);
+    process_threaded_results(payload_len, fptr, mem_pair_label, copiers, num_threads, cpy_type, num_test_runs);
+  }
+}
+
+#ifdef HAVE_TSC
+// Average cycles per copy, with source and destination flushed from all caches before each copy if 'cold'
+double copy_cycles(copy_fn fn, char *destin, char *source, unsigned long payload_len, int num_test_runs, int cold) {
+  unsigned int        aux;
+  unsigned long long  t0, t1, overhead = ~0ULL, total = 0;
+
+  for (int j=0; j < 16; j++) {          // Cost of reading the TSC itself
+    t0 = __rdtscp(&aux);
+    t1 = __rdtscp(&aux);
+    if ((t1 - t0) < overhead) overhead = t1 - t0;
+  }
+  fn(destin, source, payload_len);      // Warm up code, TLB and cache
+  for (int j=0; j < num_test_runs; j++) {
+    if (cold) {
+      for (unsigned long i=0; i < payload_len; i += CACHE_LINE) {
+        _mm_clflush(source + i);
+        _mm_clflush(destin + i);
+      }
+      _mm_clflush(source + payload_len - 1);
+      _mm_clflush(destin + payload_len - 1);
+      _mm_mfence();
+    }
+    t0 = __rdtscp(&aux);
+    fn(destin, source, payload_len);
+    t1 = __rdtscp(&aux);
+    if ((t1 - t0) > overhead) total += t1 - t0 - overhead;
+  }
+  return ((double) total / num_test_runs);
+}
+
+// Small copy latency of each memcpy method, with warm and cold caches
+void latency_tests_for_given_length(char *destin, char *source, unsigned long payload_len, FILE *fptr, char *mem_pair_label, int num_test_runs) {
+  static const char *cache_state[] = {"warm", "cold"};
+  double  cycles;
+
+  for (int cold=0; cold < 2; cold++) {
+    for (int k=0; k < NUM_COPY_METHODS; k++) {
+      cycles = copy_cycles(copy_methods[k].fn, destin, source, payload_len, num_test_runs, cold);
+      fprintf(stderr, "%8ld bytes using %s = %9.1f cycles per copy (%s cache, %d runs)\n", payload_len, copy_methods[k].name, cycles, cache_state[cold], num_test_runs);
+      fprintf(fptr, "%s (%s cache), %ld, %s, %.1f, %d\n", mem_pair_label, cache_state[cold], payload_len, copy_methods[k].name, cycles, num_test_runs);
+    }
+  }
+}
+#endif // HAVE_TSC
 
 // X axis payload: 16B, 256B, 1024B, 4KB, 64KB (video demo), 1MB, 4MB, 16MB  (>= 0x28UL to print data)
 void run_per_payload_length(char *source, char *destin, int data_offset, unsigned long pa_map_length, int payload_len_num, int num_test_runs, unsigned long  *copy_size_list, FILE *fptr, char *mem_pair_label) {
@@ -152,7 +338,30 @@ void run_per_payload_length(char *source, char *destin, int data_offset, unsigne
 #ifdef DEBUG
   fprintf(stderr, "%s\n", __func__);
 #endif // DEBUG
-  for (int indexL=0; indexL<payload_len_num; indexL++) {
+  if (mt.latency) {
+#ifdef HAVE_TSC
+    for (int indexL=0; (indexL<payload_len_num) && (copy_size_list[indexL] <= LAT_MAX_LEN); indexL++) {
+      latency_tests_for_given_length(destin, source, copy_size_list[indexL], fptr, mem_pair_label, num_test_runs);
+    }
+#endif // HAVE_TSC
+    return;
+  }
+  for (int t=0; t<mt.num_thread_counts; t++) {
+    int     num_threads = mt.thread_list[t];
+    copier  copiers[num_threads];
+
+    fprintf(stderr, "    %d copier threads (each copying its own slice)\n", num_threads);
+    copiers_start(copiers, num_threads);
+    for (int indexL=0; indexL<payload_len_num; indexL++) {
+      if (copy_size_list[indexL] * num_threads > pa_map_length) {
+        fprintf(stderr, "    Cannot run test with %d x payload length (0x%lx) > mapped length (0x%lx)\n", num_threads, copy_size_list[indexL], pa_map_length);
+        break;
+      }
+      threaded_tests_for_given_length(destin, source, copy_size_list[indexL], fptr, mem_pair_label, num_test_runs, copiers, num_threads);
+    }
+    copiers_stop(copiers, num_threads);
+  }
+  for (int indexL=0; (mt.num_thread_counts==0) && (indexL<payload_len_num); indexL++) {
     if (copy_size_list[indexL] > pa_map_length) {
       fprintf(stderr, "    Cannot run test with payload length (0x%lx) > mapped length (0x%lx)\n", copy_size_list[indexL], pa_map_length);
       break;
@@ -165,6 +374,36 @@ void run_per_payload_length(char *source, char *destin, int data_offset, unsigne
 //**************************************************************************************
 // D) Allocate (and deallocate) different memory types
 //**************************************************************************************
+// Allocate host heap memory: page aligned, so can choose its page size and NUMA node
+char *heap_alloc(unsigned long len) {
+  void  *p = MAP_FAILED;
+  int    flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+  if (mt.page_mode == PAGES_HUGETLB) {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) fprintf(stderr, "    No hugetlb pages (see /proc/sys/vm/nr_hugepages), so using THP\n");
+  }
+  if (p == MAP_FAILED) {
+    if ((p = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0)) == MAP_FAILED) FATAL;
+    if      (mt.page_mode == PAGES_4K)  madvise(p, len, MADV_NOHUGEPAGE);
+    else if (mt.page_mode >= PAGES_THP) madvise(p, len, MADV_HUGEPAGE);
+  }
+  return (p);
+}
+
+void heap_free(void *p, unsigned long len) {
+  if (munmap(p, len) != 0) FATAL;
+}
+
+// Bind host heap memory to a NUMA node (moving any pages already touched)
+void numa_bind(char *addr, unsigned long len, int node) {
+  unsigned long  nodemask[MAX_CPUS / (8 * sizeof(unsigned long))] = {0};
+
+  if ((node < 0) || (node >= MAX_CPUS)) return;
+  nodemask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+  if (syscall(SYS_mbind, addr, len, MPOL_BIND, nodemask, 8 * sizeof(nodemask) + 1, MPOL_MF_MOVE) != 0) FATAL;
+}
+
 // Close shared mmap memory
 void mmdealloc(int fd, void *pa_virt_addr, unsigned long pa_map_length) {
 #ifdef __TEST_USE_MLOCK__
@@ -218,7 +457,7 @@ void log_results(int indexM, char *mem_pair_label, int *fd, char *v_addr, unsign
 
 void mem_deallocate(int fd, void *pa_virt_addr, unsigned long pa_map_length) {
   if (fd > 0) mmdealloc(fd, pa_virt_addr, pa_map_length);
-  else        free(pa_virt_addr);
+  else        heap_free(pa_virt_addr, pa_map_length);
 }
 
 // Open shared memory for source (read) or destination (write)
@@ -234,14 +473,14 @@ void mem_allocate(int indexM, char *mem_pair_label, char *app_mem, char **source
       *pa_map_length = LEN_HOST_HEAP;
       *source        = app_mem;                               // Source of write is app memory
       set_data(*source, *pa_map_length, data_offset);
-      if ((*destin = malloc(*pa_map_length)) == NULL) FATAL;  // Destimation of write in host heap
+      *destin        = heap_alloc(*pa_map_length);            // Destimation of write in host heap
       log_results(indexM, mem_pair_label, fd, *destin, 0, *pa_map_length);
       *pa_virt_addr  = *destin;                               // for free()
       break;
     case 1:
       strcpy(mem_pair_label, "App reads from host-heap");
       *pa_map_length = LEN_HOST_HEAP;
-      if ((*source = malloc(*pa_map_length)) == NULL) FATAL;  // Source of read is host heap
+      *source        = heap_alloc(*pa_map_length);            // Source of read is host heap
       if (source_init==0) set_data(*source, *pa_map_length, data_offset);
       *destin = app_mem;                                      // Destimation of read is app memory
       log_results(indexM, mem_pair_label, fd, *source, 0, *pa_map_length);
@@ -283,6 +522,24 @@ void mem_allocate(int indexM, char *mem_pair_label, char *app_mem, char **source
       fprintf(stderr, "%s: Not implemented for index=%d\n", __func__, indexM);
       exit (1);
   }
+  if (mt.numa_src >= 0) {                                     // App memory and host heap are NUMA bindable
+    if ((indexM < 2) || ((indexM % 2) == 0)) numa_bind(*source, LEN_HOST_HEAP, mt.numa_src);
+  }
+  if (mt.numa_dst >= 0) {
+    if ((indexM < 2) || ((indexM % 2) == 1)) numa_bind(*destin, LEN_HOST_HEAP, mt.numa_dst);
+  }
+}
+
+// Add non-default page backing and NUMA nodes to label, so plots are for one configuration
+void label_config(char *mem_pair_label) {
+  char  node[2][12];
+
+  if (mt.page_mode != PAGES_DEFAULT) sprintf(mem_pair_label + strlen(mem_pair_label), " [%s]", page_names[mt.page_mode]);
+  if ((mt.numa_src >= 0) || (mt.numa_dst >= 0)) {
+    if (mt.numa_src >= 0) sprintf(node[0], "%d", mt.numa_src); else strcpy(node[0], "*");
+    if (mt.numa_dst >= 0) sprintf(node[1], "%d", mt.numa_dst); else strcpy(node[1], "*");
+    sprintf(mem_pair_label + strlen(mem_pair_label), " [node %s to %s]", node[0], node[1]);
+  }
 }
 
 // Test with application (on host heap) writing or reading to/from host heap, host mmap, or escape mmap
@@ -290,19 +547,21 @@ void run_per_mem_type_pair (int *mem_pair_list, int num_mem_pairs, int data_offs
   int            i, fd = -1;
   void          *pa_virt_addr;
   unsigned long  pa_map_length;
-  char          *app_mem, *source, *destin, mem_pair_label[32];
+  char          *app_mem, *source, *destin, mem_pair_label[MAX_LABEL_LEN];
 
-  if ((app_mem = malloc(LEN_HOST_HEAP)) == NULL) FATAL;
+  app_mem = heap_alloc(LEN_HOST_HEAP);
   fprintf(stderr, "App Memory uses host Heap [len=0x%lx Bytes] at virtual address %p\n", LEN_HOST_HEAP, app_mem);
   for (i=0; i<num_mem_pairs; i++) {
     fprintf(stderr, "--------------------------------------------------------------------------------------\n");
     mem_allocate(mem_pair_list[i], mem_pair_label, app_mem, &source, &destin, data_offset, source_init, anon, &fd, &pa_virt_addr, &pa_map_length, &payload_len_num);
+    label_config(mem_pair_label);
     run_per_payload_length(source, destin, data_offset, pa_map_length, payload_len_num, num_test_runs, copy_size_list, fptr, mem_pair_label);
 #ifdef DEBUG
     fprintf(stderr, "Deallocating memroy: fd=%d pa_virt_addr=%p pa_map_len=%ld mem_typ_pair_indexM=%d\n", fd, pa_virt_addr, pa_map_length, mem_pair_list[i]);
 #endif // DEBUG
     mem_deallocate(fd, pa_virt_addr, pa_map_length);
   }
+  heap_free(app_mem, LEN_HOST_HEAP);
 }
 
 //**************************************************************************************
@@ -319,14 +578,24 @@ void opts_print(void) {
   printf("Memory speed test for GAPS CLOSURE project\n");
   printf("Usage: ./escape_test [OPTIONS]... [Experiment ID List]\n");
   printf("OPTIONS: are one of the following:\n");
+  printf(" -c : CPU list for copier threads, e.g., 0,2,4,6 (default = no pinning)\n");
   printf(" -h : print this message\n");
   printf(" -i : which source data is initialized\n"
          "\t 0 = all sources (default)\n"
          "\t 1 = only if source is application - so can read on different node to write\n"
         );
+  printf(" -L : measure small copy (<= %d bytes) latency in cycles, with warm and cold caches (into latency.csv)\n", LAT_MAX_LEN);
   printf(" -n : number of length tests (default=%d, maximum = %d)\n", DEF_NUM_PAYLOAD_LEN, MAX_NUM_PAYLOAD_LEN);
+  printf(" -N : NUMA nodes for source and destination host heap, e.g., 0,1 (default = any)\n");
   printf(" -o : source data initialization offset value (before writing)\n");
+  printf(" -p : page backing for host heap\n"
+         "\t 0 = system default (default)\n"
+         "\t 1 = 4K pages\n"
+         "\t 2 = transparent huge pages\n"
+         "\t 3 = hugetlbfs huge pages (else transparent huge pages)\n"
+        );
   printf(" -r : number of test runs for each a) memory pair type, b) payload length and c) copy function\n");
+  printf(" -t : list of numbers of concurrent copier threads, e.g., 1,2,4,8 (default = single test thread)\n");
   printf("Experiment IDs (default = all) is for application data (on host heap) to:\n"
          "\t 0 = write to host heap\n"
          "\t 1 = read from host heap\n"
@@ -337,15 +606,55 @@ void opts_print(void) {
         );
 }
 
+/* Parse comma separated list of integers (e.g., "1,2,4,8"), returning number in list */
+int get_int_list(char *str, int *list, int max_len) {
+  int   len = 0;
+  char *tok;
+
+  for (tok = strtok(str, ","); (tok != NULL) && (len < max_len); tok = strtok(NULL, ",")) list[len++] = atoi(tok);
+  return (len);
+}
+
 /* Get script's command line options */
 void get_options(int argc, char *argv[], int *mem_pair_list, int *data_offset, int *source_init, int *payload_len_num, int *num_test_runs, int *num_mem_pairs, int *anon) {
-  int  opt;
+  int  opt, nodes[2];
   
-  while((opt = getopt(argc, argv, ":ahi:n:o:r:")) != EOF) {
+  while((opt = getopt(argc, argv, ":ac:hi:Ln:N:o:p:r:t:")) != EOF) {
     switch (opt) {
       case 'a':
         *anon = 1;
         break;
+      case 'c':
+        mt.num_cpus = get_int_list(optarg, mt.cpu_list, MAX_CPUS);
+        break;
+      case 'L':
+#ifndef HAVE_TSC
+        fprintf(stderr, "Latency test (-L) needs an x86 time stamp counter\n");
+        exit(EXIT_FAILURE);
+#endif // HAVE_TSC
+        mt.latency = 1;
+        break;
+      case 'N':
+        if (get_int_list(optarg, nodes, 2) != 2) {
+          fprintf(stderr, "Option -N needs source and destination nodes (e.g., 0,1)\n");
+          exit(EXIT_FAILURE);
+        }
+        mt.numa_src = nodes[0];
+        mt.numa_dst = nodes[1];
+        break;
+      case 'p':
+        mt.page_mode = atoi(optarg);
+        if ((mt.page_mode < PAGES_DEFAULT) || (mt.page_mode > PAGES_HUGETLB)) mt.page_mode = PAGES_DEFAULT;
+        break;
+      case 't':
+        mt.num_thread_counts = get_int_list(optarg, mt.thread_list, MAX_THREAD_COUNTS);
+        for (int i=0; i<mt.num_thread_counts; i++) {
+          if (mt.thread_list[i] < 1) {
+            fprintf(stderr, "Number of copier threads must be at least 1\n");
+            exit(EXIT_FAILURE);
+          }
+        }
+        break;
       case 'h':
         opts_print();
         exit(0);
@@ -386,6 +695,16 @@ void config_print(int data_offset, int source_init, int payload_len_num, int num
   fprintf(stderr, "PAGE_MASK=0x%08lx data_off=%d source_init=%d payload_len_num=%d runs=%d num_mem_pairs=%d [ ", PAGE_MASK, data_offset, source_init, payload_len_num, num_test_runs, num_mem_pairs);
   for (i=0; i<num_mem_pairs; i++) fprintf(stderr, "%d ", mem_pair_list[i]);
   fprintf(stderr, "]\n");
+  if (mt.num_thread_counts > 0) {
+    fprintf(stderr, "threads=[ ");
+    for (i=0; i<mt.num_thread_counts; i++) fprintf(stderr, "%d ", mt.thread_list[i]);
+    fprintf(stderr, "] cpus=[ ");
+    for (i=0; i<mt.num_cpus; i++) fprintf(stderr, "%d ", mt.cpu_list[i]);
+    fprintf(stderr, "]\n");
+  }
+  if ((mt.page_mode != PAGES_DEFAULT) || (mt.numa_src >= 0) || (mt.numa_dst >= 0) || mt.latency) {
+    fprintf(stderr, "pages=%d numa_src=%d numa_dst=%d latency=%d\n", mt.page_mode, mt.numa_src, mt.numa_dst, mt.latency);
+  }
 }
 
 /* Run Shared Memory Experiment */
@@ -401,8 +720,10 @@ int main(int argc, char *argv[]) {
   
   get_options(argc, argv, mem_pair_list, &data_offset, &source_init, &payload_len_num, &num_test_runs, &num_mem_pairs, &anon);
   config_print(data_offset, source_init, payload_len_num, num_test_runs, num_mem_pairs, mem_pair_list);
-  fptr = fopen("results.csv", "w");   // opening file in writing mode
-  write_header(fptr);
+  fptr = fopen((mt.latency) ? "latency.csv" : "results.csv", "w");   // opening file in writing mode
+  if (fptr == NULL) FATAL;
+  if (mt.latency) write_latency_header(fptr);
+  else            write_header(fptr);
   run_per_mem_type_pair(mem_pair_list, num_mem_pairs, data_offset, source_init, payload_len_num, num_test_runs, anon, fptr);
   fclose(fptr);
   return 0;
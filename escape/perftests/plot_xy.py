@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 import argparse
+import re
 import matplotlib.pyplot as plt
 import sys
 import csv
@@ -8,6 +9,9 @@ from pprint import pprint
 # Plot memory copy perormance: v1 (March 6, 2023)
 # Requires csv file input from ./memtest output. Example line:
 #   E.g., host-heap (app) > host-heap, 16, memcpy1, 0.762, 2
+# With copier threads (memcpy_test -t 1,2,4), each copy type has a thread count
+# suffix (e.g., 'glibc_memcpy x4'), so each thread count is a separate line.
+# Latency results (memcpy_test -L) plot using: python3 plot_xy.py -i latency.csv
 COL_E = 0   # Experiment Description column
 COL_L = 1   # Copy Length (Bytes) column
 COL_C = 2   # Copy Type Name column
@@ -28,8 +32,8 @@ def read_values(input_filename):
 # Load results (in rows and fields) into x and y arrays for given copy type
 def get_xy_arrays(cpy_type):
   if args.verbose: print('c =', cpy_type)
-  x_array = [  int(row[COL_L]) for row in plot_rows if cpy_type in row[COL_C]]    # Copy Length
-  y_array = [float(row[COL_T]) for row in plot_rows if cpy_type in row[COL_C]]    # Throughput
+  x_array = [  int(row[COL_L]) for row in plot_rows if cpy_type == row[COL_C]]    # Copy Length
+  y_array = [float(row[COL_T]) for row in plot_rows if cpy_type == row[COL_C]]    # Throughput (or Latency)
   return (x_array, y_array)
 
 def get_unique(index):
@@ -47,7 +51,7 @@ def plot_init(mem_type):
 
 def plot_display_and_save(mem_type):
   plt.legend()
-  plt.savefig('fig_' + mem_type.replace(" ", "_" ) + '.png')
+  plt.savefig('fig_' + re.sub(r'[^\w.-]+', '_', mem_type).strip('_') + '.png')
   if (args.display): plt.show()
 
 if __name__=='__main__':
@@ -60,10 +64,12 @@ if __name__=='__main__':
   fields, rows = read_values(args.input_filename)
   for mem_type in get_unique(COL_E):
     plot_init(mem_type)
-    plot_rows = [row for row in rows if mem_type in row[COL_E]]
+    plot_rows = [row for row in rows if mem_type == row[COL_E]]
     if args.verbose: pprint(plot_rows)
-    for cpy_type in get_unique(COL_C):
+    for cpy_type in sorted(get_unique(COL_C)):
       x_array, y_array = get_xy_arrays(cpy_type)
-      plt.plot(x_array, y_array, linestyle='-', marker='o', label=cpy_type)
-    plt.plot(x_array, [23.46] * len(x_array), linestyle='-', label="mem B/W limit")
+      if len(x_array): plt.plot(x_array, y_array, linestyle='-', marker='o', label=cpy_type)
+    if 'Throughput' in fields[COL_T]:
+      x_array = sorted({int(row[COL_L]) for row in plot_rows})
+      plt.plot(x_array, [23.46] * len(x_array), linestyle='-', label="mem B/W limit")
     plot_display_and_save(mem_type)
@@ -0,0 +1,57 @@
+/*
+ * Send and receive position ADUs through HAL using the C++ binding (api/xdcomms.hpp)
+ *   October 2026, Peraton Labs
+ *
+ * Usage: ./xdc_example IN_URI OUT_URI [COUNT]
+ *   e.g., with HAL running test/sample_zmq_loopback_green.cfg (routes <1,1,1> back to the app):
+ *     ./xdc_example ipc:///tmp/halsubgreen ipc:///tmp/halpubgreen 10
+ */
+
+#include <iostream>
+#include <string>
+#include "../../api/xdcomms.hpp"
+
+extern "C" {
+#include "../../appgen/6month-demo/gma.h"
+}
+
+template <> struct xdc::adu_traits<position_datatype> {
+  static constexpr uint32_t       typ     = DATA_TYP_POSITION;
+  static constexpr size_t         enc_max = sizeof(position_datatype);
+  static constexpr codec_func_ptr encode  = position_data_encode;
+  static constexpr codec_func_ptr decode  = position_data_decode;
+};
+
+int main(int argc, char **argv)
+{
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " IN_URI OUT_URI [COUNT]" << std::endl;
+    return 1;
+  }
+  int count = (argc > 3) ? std::stoi(argv[3]) : 10;
+
+  xdc_set_in(argv[1]);
+  xdc_set_out(argv[2]);
+  xdc::register_codec<position_datatype>();
+
+  // sockets are closed when they go out of scope
+  xdc::publisher  pub;
+  xdc::subscriber sub(xdc::make_tag(1, 1, DATA_TYP_POSITION), 1000);
+
+  for (int i = 0; i < count; i++) {
+    position_datatype pos = {1.0 * i, 2.0 * i, 3.0 * i, {(uint32_t) i, 0, 0, 0, 0}};
+    if (pub.send(1, 1, pos) < 0) std::cerr << "send failed" << std::endl;
+
+    // the received packet stays in its ZMQ message: no copy until it is decoded
+    std::optional<xdc::message> m = sub.recv();
+    if (!m) {
+      std::cerr << "timeout waiting for ADU " << i << std::endl;
+      continue;
+    }
+    std::optional<position_datatype> rx = m->decode<position_datatype>();
+    if (rx) std::cout << "recv <" << m->tag().mux << "," << m->tag().sec << "," << m->tag().typ << "> "
+                      << m->size() << " encoded bytes: x=" << rx->x << " y=" << rx->y << " z=" << rx->z
+                      << " seq=" << rx->trailer.seq << std::endl;
+  }
+  return 0;
+}
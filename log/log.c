@@ -100,9 +100,15 @@ void log_log(int level, const char *file, int line, const char *fmt, ...) {
   /* Acquire lock */
   lock();
 
-  /* Get current time */
+  /* Get current time (localtime only changes once a second, so reuse it until then) */
+  static time_t    lt_sec = -1;
+  static struct tm lt_cache;
   time_t t = time(NULL);
-  struct tm *lt = localtime(&t);
+  if (t != lt_sec) {
+    localtime_r(&t, &lt_cache);
+    lt_sec = t;
+  }
+  struct tm *lt = &lt_cache;
 
   /* Log to stderr */
   if (!L.quiet) {
@@ -0,0 +1,381 @@
+/*
+ * HALPERF.C
+ *   Native multi-threaded load generator for HAL (C version of halperf.py)
+ *
+ * October 2026, Peraton Labs
+ *   Same command line as halperf.py (-s MUX SEC TYP RATE, -r MUX SEC TYP,
+ *   -i, -o, --interval, -t, -v), but each flow runs in its own thread
+ *   calling libxdcomms directly, so it can drive HAL at high rates.
+ *
+ *   Senders pace on absolute CLOCK_MONOTONIC deadlines (sleeping, then
+ *   spinning for the last few microseconds) and embed in each ADU trailer:
+ *     seq       = per-flow sequence number (starting at 0)
+ *     rqr, oid  = upper and lower 32 bits of the send time (CLOCK_REALTIME ns)
+ *   Receivers report per flow: throughput, loss, reordering, duplicates and one-way
+ *   latency percentiles (sender and receiver clocks must be synchronized
+ *   when they run on different hosts).
+ *
+ * 1) Compilation (after building ../api and ../appgen/6month-demo):
+ *   cd hal/test; make halperf
+ *
+ * 2) Example (loopback HAL configuration):
+ *   hal/daemon/hal -l 3 sample_zmq_loopback_green.cfg &
+ *   ./halperf -s 1 1 1 10000 -r 1 1 1 -i ipc:///tmp/halsubgreen -o ipc:///tmp/halpubgreen -t 10 --interval 2
+ */
+
+#include "../api/xdcomms.h"
+#include "../appgen/6month-demo/gma.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#define FLOWS_MAX        64
+#define RECV_TIMEOUT_MS  100           /* threads check for shutdown this often */
+#define SPIN_NS          20000         /* spin (rather than sleep) this close to a deadline */
+#define SEQ_WINDOW       1024          /* received sequence numbers remembered, to tell late from duplicate */
+#define HIST_SUB_BITS    4             /* log-linear histogram: 16 buckets per power of 2 */
+#define HIST_SUB         (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS     ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+#define ADU_ENC_MAX      ((sizeof(position_output) > sizeof(distance_output)) ? sizeof(position_output) : sizeof(distance_output))
+
+/**********************************************************************/
+/* A) Flows and latency histograms */
+/*********t************************************************************/
+typedef struct _hist {
+  uint64_t count;
+  uint64_t max;
+  uint64_t bucket[HIST_BUCKETS];
+} hist;
+
+typedef struct _flow {
+  int              send;            /* 1 = send flow, 0 = receive flow */
+  gaps_tag         tag;
+  double           rate;            /* send rate (Hz) */
+  pthread_t        thread;
+  pthread_mutex_t  lock;            /* protects the counters below */
+  uint64_t         win_cnt;         /* messages this reporting interval */
+  uint64_t         tot_cnt;
+  uint32_t         seq_next;        /* next expected sequence number (receive) */
+  int              seq_started;
+  uint64_t         lost;            /* sequence gaps not (yet) filled by late arrivals */
+  uint64_t         reordered;       /* late arrivals (sequence number below expected, not seen before) */
+  uint64_t         duplicates;      /* sequence numbers already received (or too old to tell) */
+  uint64_t         seq_seen[SEQ_WINDOW / 64];   /* bitmap of received numbers in [seq_next - SEQ_WINDOW, seq_next) */
+  hist             win_lat;         /* one-way latency (ns) this interval */
+  hist             tot_lat;
+} flow;
+
+static flow          flows[FLOWS_MAX];
+static int           flow_count = 0;
+static volatile int  running = 1;
+static int           verbose = 0;
+
+static int hist_index(uint64_t v) {
+  int e;
+
+  if (v < HIST_SUB) return ((int) v);
+  e = 63 - __builtin_clzll(v);
+  return (((e - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + (int) ((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1)));
+}
+
+/* Lowest value that falls into bucket i */
+static uint64_t hist_value(int i) {
+  int e = (i >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+
+  if (i < HIST_SUB) return ((uint64_t) i);
+  return ((uint64_t) (HIST_SUB + (i & (HIST_SUB - 1))) << (e - HIST_SUB_BITS));
+}
+
+static void hist_add(hist *h, uint64_t v) {
+  h->bucket[hist_index(v)]++;
+  h->count++;
+  if (v > h->max) h->max = v;
+}
+
+/* Return value (ns) at percentile pct (0-100) */
+static uint64_t hist_pct(hist *h, double pct) {
+  uint64_t target, sum = 0;
+
+  if (h->count == 0) return (0);
+  target = (uint64_t) ((pct / 100.0) * h->count);
+  if (target >= h->count) return (h->max);
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    sum += h->bucket[i];
+    if (sum > target) return (hist_value(i));
+  }
+  return (h->max);
+}
+
+static uint64_t time_ns(clockid_t clk) {
+  struct timespec t;
+  clock_gettime(clk, &t);
+  return ((uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+/**********************************************************************/
+/* B) Send and receive threads */
+/*********t************************************************************/
+static void *send_thread(void *arg) {
+  flow              *f = (flow *) arg;
+  void              *sock = xdc_pub_socket();
+  position_datatype  adu = {-74.574489, 40.695545, 101.9, {0, 0, 0, 0, 0}};
+  uint64_t           period = (uint64_t) (1e9 / f->rate), next, now, wake, ts;
+  struct timespec    t;
+  uint32_t           seq = 0;
+
+  if (f->tag.typ == DATA_TYP_DISTANCE) { adu.x = -1.021; adu.y = 2.334; adu.z = 0.4; }
+  next = time_ns(CLOCK_MONOTONIC);
+  while (running) {
+    now = time_ns(CLOCK_MONOTONIC);
+    if (next > now + SPIN_NS) {         /* sleep in short steps, to notice shutdown */
+      wake = next - SPIN_NS;
+      if (wake > now + RECV_TIMEOUT_MS * 1000000ULL) wake = now + RECV_TIMEOUT_MS * 1000000ULL;
+      t.tv_sec  = wake / 1000000000ULL;
+      t.tv_nsec = wake % 1000000000ULL;
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+      continue;
+    }
+    while (time_ns(CLOCK_MONOTONIC) < next) ;
+    next += period;
+
+    ts = time_ns(CLOCK_REALTIME);
+    adu.z += 0.1;
+    adu.trailer.seq = seq++;
+    adu.trailer.rqr = (uint32_t) (ts >> 32);
+    adu.trailer.oid = (uint32_t) ts;
+    xdc_asyn_send_len(sock, &adu, ADU_ENC_MAX, &(f->tag));   /* encodes into the ZMQ message */
+    pthread_mutex_lock(&(f->lock));
+    f->win_cnt++;
+    pthread_mutex_unlock(&(f->lock));
+    if (verbose) fprintf(stderr, "%f sent_msg: [%u/%u/%u] -- (%f,%f,%f) seq=%u\n", ts / 1e9,
+                         f->tag.mux, f->tag.sec, f->tag.typ, adu.x, adu.y, adu.z, adu.trailer.seq);
+  }
+  zmq_close(sock);
+  return (NULL);
+}
+
+/* Update loss, reordering and duplicate counts with the sequence number of a received ADU */
+static void seq_check(flow *f, uint32_t seq) {
+  uint32_t  ahead = seq - f->seq_next, behind = f->seq_next - seq;
+  uint64_t *word  = &(f->seq_seen[(seq % SEQ_WINDOW) / 64]), bit = 1ULL << (seq % 64);
+
+  if (f->seq_started && ((int32_t) ahead < 0)) {
+    if ((behind > SEQ_WINDOW) || (*word & bit)) f->duplicates++;
+    else {                                /* late arrival fills an earlier gap */
+      *word |= bit;
+      f->reordered++;
+      if (f->lost > 0) f->lost--;
+    }
+    return;
+  }
+  if (!(f->seq_started)) f->seq_started = 1;
+  else {                                  /* numbers skipped are lost (until they arrive) */
+    f->lost += ahead;
+    if (ahead >= SEQ_WINDOW) memset(f->seq_seen, 0, sizeof(f->seq_seen));
+    else for (uint32_t s = f->seq_next; s != seq; s++) f->seq_seen[(s % SEQ_WINDOW) / 64] &= ~(1ULL << (s % 64));
+  }
+  f->seq_seen[(seq % SEQ_WINDOW) / 64] |= bit;
+  f->seq_next = seq + 1;
+}
+
+static void *recv_thread(void *arg) {
+  flow              *f = (flow *) arg;
+  void              *sock = xdc_sub_socket_non_blocking(f->tag, RECV_TIMEOUT_MS);
+  position_datatype  adu;
+  gaps_tag           tag;
+  xdc_msg            m;
+  uint64_t           ts, lat;
+
+  while (running) {
+    if (xdc_recv_msg(sock, &m) <= 0) continue;     /* decodes from the ZMQ message */
+    tag = m.tag;
+    if (xdc_msg_decode(&m, &adu) < 0) {
+      xdc_msg_release(&m);
+      continue;
+    }
+    xdc_msg_release(&m);
+    ts  = ((uint64_t) adu.trailer.rqr << 32) | adu.trailer.oid;
+    lat = time_ns(CLOCK_REALTIME) - ts;
+    if ((int64_t) lat < 0) lat = 0;
+    pthread_mutex_lock(&(f->lock));
+    f->win_cnt++;
+    seq_check(f, adu.trailer.seq);
+    hist_add(&(f->win_lat), lat);
+    hist_add(&(f->tot_lat), lat);
+    pthread_mutex_unlock(&(f->lock));
+    if (verbose) fprintf(stderr, "%f recv_msg: [%u/%u/%u] -- (%f,%f,%f) seq=%u lat=%.1fus\n", ts / 1e9,
+                         tag.mux, tag.sec, tag.typ, adu.x, adu.y, adu.z, adu.trailer.seq, lat / 1e3);
+  }
+  zmq_close(sock);
+  return (NULL);
+}
+
+/**********************************************************************/
+/* C) Reports */
+/*********t************************************************************/
+static void report_interval(double tot_sec, double interval) {
+  flow      *f;
+  uint64_t   win, tot, lost, reord, dup, p50, p99;
+  char       mst[40];
+
+  for (int i = 0; i < flow_count; i++) {
+    f = &(flows[i]);
+    pthread_mutex_lock(&(f->lock));
+    win   = f->win_cnt;
+    tot   = f->tot_cnt + win;
+    lost  = f->lost;
+    reord = f->reordered;
+    dup   = f->duplicates;
+    p50   = hist_pct(&(f->win_lat), 50);
+    p99   = hist_pct(&(f->win_lat), 99);
+    f->tot_cnt = tot;
+    f->win_cnt = 0;
+    memset(&(f->win_lat), 0, sizeof(hist));
+    pthread_mutex_unlock(&(f->lock));
+
+    sprintf(mst, "%u/%u/%u", f->tag.mux, f->tag.sec, f->tag.typ);
+    printf("%5.2fs | %s | %-8s | %5lu %9.2f Hz | %8lu %9.2f Hz", tot_sec, (f->send) ? "send" : "recv",
+           mst, win, win / interval, tot, tot / tot_sec);
+    if (f->send) printf("\n");
+    else         printf(" | lost %lu reord %lu dup %lu | lat p50 %.1f p99 %.1f us\n", lost, reord, dup, p50 / 1e3, p99 / 1e3);
+  }
+  fflush(stdout);
+}
+
+static void report_totals(double elapsed) {
+  flow     *f;
+  hist     *h;
+  double    exp_cnt;
+
+  printf("\n\nMESSAGE TOTALS\n------\n");
+  for (int i = 0; i < flow_count; i++) {
+    f = &(flows[i]);
+    h = &(f->tot_lat);
+    pthread_mutex_lock(&(f->lock));
+    f->tot_cnt += f->win_cnt;
+    f->win_cnt = 0;
+    printf("%u/%u/%u - %s %lu messages (%.2f Hz)", f->tag.mux, f->tag.sec, f->tag.typ,
+           (f->send) ? "sent" : "received", f->tot_cnt, f->tot_cnt / elapsed);
+    if (!(f->send)) {
+      exp_cnt = f->tot_cnt - f->duplicates + f->lost;
+      printf(", lost %lu (%.3f%%), reordered %lu, duplicates %lu\n", f->lost, (exp_cnt > 0) ? (100.0 * f->lost / exp_cnt) : 0,
+             f->reordered, f->duplicates);
+      printf("    latency (us): min %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+             hist_pct(h, 0) / 1e3, hist_pct(h, 50) / 1e3, hist_pct(h, 90) / 1e3,
+             hist_pct(h, 99) / 1e3, hist_pct(h, 99.9) / 1e3, h->max / 1e3);
+    }
+    else printf("\n");
+    pthread_mutex_unlock(&(f->lock));
+  }
+  printf("elapsed time: %.2fs\n", elapsed);
+}
+
+/**********************************************************************/
+/* D) Options and main */
+/*********t************************************************************/
+static void opts_print(void) {
+  printf("usage: halperf [-h] [-s MUX SEC TYP RATE] [-r MUX SEC TYP] [-i URI] [-o URI]\n");
+  printf("               [--interval INTERVAL] [-t T] [-v]\n");
+  printf(" -s MUX SEC TYP RATE : send cross-domain flow using MUX/SEC/TYP at RATE (Hz)\n");
+  printf(" -r MUX SEC TYP      : recv cross-domain flow mapped to MUX/SEC/TYP\n");
+  printf(" -i URI              : in URI (default=%s)\n", IPC_ADDR_DEFAULT_HALPUB);
+  printf(" -o URI              : out URI (default=%s)\n", IPC_ADDR_DEFAULT_HALSUB);
+  printf(" --interval INTERVAL : reporting interval, default=10s\n");
+  printf(" -t T                : duration of test in seconds, if not specified, runs indefinitely\n");
+  printf(" -v                  : verbose mode, logs every message\n");
+}
+
+static void sigint_handler(int sig) {
+  running = 0;
+}
+
+/* Add flow from MUX SEC TYP [RATE] arguments starting at argv[optind-1] */
+static void flow_add(int send, int argc, char **argv) {
+  int   nargs = (send) ? 4 : 3;
+  flow *f;
+
+  if ((optind - 1 + nargs) > argc) {
+    fprintf(stderr, "-%c needs %d values\n", (send) ? 's' : 'r', nargs);
+    opts_print();
+    exit(EXIT_FAILURE);
+  }
+  if (flow_count >= FLOWS_MAX) {
+    fprintf(stderr, "Too many flows (max=%d)\n", FLOWS_MAX);
+    exit(EXIT_FAILURE);
+  }
+  f = &(flows[flow_count++]);
+  memset(f, 0, sizeof(*f));
+  f->send = send;
+  tag_write(&(f->tag), strtoul(argv[optind - 1], NULL, 0), strtoul(argv[optind], NULL, 0), strtoul(argv[optind + 1], NULL, 0));
+  if (send) f->rate = atof(argv[optind + 2]);
+  if (send && (f->rate <= 0)) {
+    fprintf(stderr, "RATE must be > 0\n");
+    exit(EXIT_FAILURE);
+  }
+  if ((f->tag.typ != DATA_TYP_POSITION) && (f->tag.typ != DATA_TYP_DISTANCE)
+   && (f->tag.typ != DATA_TYP_HB_ORANGE) && (f->tag.typ != DATA_TYP_HB_GREEN)) {
+    fprintf(stderr, "unsupported data typ: %u\n", f->tag.typ);
+    exit(EXIT_FAILURE);
+  }
+  pthread_mutex_init(&(f->lock), NULL);
+  optind += nargs - 1;
+}
+
+int main(int argc, char **argv) {
+  int     opt;
+  double  interval = 10, duration = 0, elapsed;
+  char   *uri_in = NULL, *uri_out = NULL;
+  uint64_t t_start, t_report;
+  struct option long_opts[] = {{"interval", required_argument, 0, 'I'}, {"send", required_argument, 0, 's'},
+                               {"recv", required_argument, 0, 'r'}, {0, 0, 0, 0}};
+
+  while ((opt = getopt_long(argc, argv, "+hs:r:i:o:t:v", long_opts, NULL)) != EOF) {
+    switch (opt) {
+      case 's': flow_add(1, argc, argv);    break;
+      case 'r': flow_add(0, argc, argv);    break;
+      case 'i': uri_in   = optarg;          break;
+      case 'o': uri_out  = optarg;          break;
+      case 'I': interval = atof(optarg);    break;
+      case 't': duration = atof(optarg);    break;
+      case 'v': verbose  = 1;               break;
+      case 'h': opts_print(); exit(0);
+      default:  opts_print(); exit(EXIT_FAILURE);
+    }
+  }
+  if (interval <= 0) interval = 10;
+
+  xdc_log_level(LOG_WARN);
+  xdc_ctx();
+  xdc_set_in(uri_in);
+  xdc_set_out(uri_out);
+  xdc_register(position_data_encode, position_data_decode, DATA_TYP_POSITION);
+  xdc_register(distance_data_encode, distance_data_decode, DATA_TYP_DISTANCE);
+  xdc_register(position_data_encode, position_data_decode, DATA_TYP_HB_ORANGE);
+  xdc_register(position_data_encode, position_data_decode, DATA_TYP_HB_GREEN);
+  signal(SIGINT, sigint_handler);
+
+  /* Start receivers first so they are subscribed before senders start */
+  for (int i = 0; i < flow_count; i++) {
+    if (flows[i].send) continue;
+    printf("Subscribed to [%u/%u/%u]\n", flows[i].tag.mux, flows[i].tag.sec, flows[i].tag.typ);
+    pthread_create(&(flows[i].thread), NULL, recv_thread, &(flows[i]));
+  }
+  for (int i = 0; i < flow_count; i++) {
+    if (flows[i].send) pthread_create(&(flows[i].thread), NULL, send_thread, &(flows[i]));
+  }
+
+  t_start = t_report = time_ns(CLOCK_MONOTONIC);
+  while (running) {
+    usleep(10000);
+    elapsed = (time_ns(CLOCK_MONOTONIC) - t_start) / 1e9;
+    if ((time_ns(CLOCK_MONOTONIC) - t_report) >= interval * 1e9) {
+      t_report += (uint64_t) (interval * 1e9);
+      report_interval((t_report - t_start) / 1e9, interval);
+    }
+    if ((duration > 0) && (elapsed >= duration)) running = 0;
+  }
+  for (int i = 0; i < flow_count; i++) pthread_join(flows[i].thread, NULL);
+  report_totals((time_ns(CLOCK_MONOTONIC) - t_start) / 1e9);
+  return (0);
+}